@@ -1,113 +1,253 @@
 #include "qpmu/defs.h"
-#include "qpmu/util.h"
-#include "app.h"
+#include "qpmu/clock.h"
 #include "data_processor.h"
-#include "src/settings_models.h"
+#include "settings_models.h"
+#include "qpmu/trace.h"
 
 #include <QDebug>
-#include <QAbstractSocket>
-#include <QTcpSocket>
-#include <QUdpSocket>
-#include <QProcess>
-#include <QFile>
-#include <QMutexLocker>
-#include <QLabel>
+#include <QCoreApplication>
+#include <QHostAddress>
+#include <QMetaObject>
 #include <QtGlobal>
 
-#include <utility>
-#include <cctype>
+#include <algorithm>
 #include <chrono>
-#include <c37118command.h>
-#include <fcntl.h>
-#include <qdir.h>
-#include <qstringliteral.h>
-#include <unistd.h>
+#include <string>
+#include <vector>
 
 using namespace qpmu;
 
-template <class T>
-T median(std::vector<T> vec)
+DataProcessor::DataProcessor(int station) : QThread(), m_station(station)
 {
-    assert(!vec.empty());
-    std::sort(vec.begin(), vec.end());
-    size_t n = vec.size();
-    if (n % 2 == 1) {
-        return vec[n / 2];
-    } else {
-        return (vec[n / 2 - 1] + vec[n / 2]) / 2;
+    qRegisterMetaType<ReportingInstant>();
+    qRegisterMetaType<Estimation>();
+
+    const auto arguments = QCoreApplication::arguments();
+    m_simulation = arguments.contains("--simulate");
+    if (m_simulation && station == 0) {
+        enableVirtualClock();
     }
-}
 
-const Estimation &DataProcessor::lastEstimation()
-{
-    QMutexLocker locker(&m_mutex);
-    return m_estimations.back();
-}
+    StationSettings stations;
+    stations.load();
+    if (!stations.validate().isEmpty()) {
+        qWarning() << "Invalid station settings:" << stations.validate() << "; using the defaults";
+        stations = StationSettings();
+    }
+    const auto config = stations.stations.value(station);
+    m_cpu = config.cpu;
 
-/// Get estimation after running median filters
-const Estimation DataProcessor::lastEstimationFiltered()
-{
-    std::vector<Float> filterableMagnitudes[CountSignals];
-    Estimation result;
-
-    {
-        QMutexLocker locker(&m_mutex);
-        result = m_estimations.back();
-        for (size_t i = 0; i < CountSignals; ++i) {
-            size_t medianWindowSize =
-                    std::min(TypeOfSignal[i] == VoltageSignal ? (size_t)100 : (size_t)32,
-                             m_estimations.size());
-            filterableMagnitudes[i].resize(medianWindowSize);
-            size_t offset = m_estimations.size() - medianWindowSize;
-            for (size_t j = 0; j < medianWindowSize; ++j) {
-                filterableMagnitudes[i][j] = std::abs(m_estimations[j + offset].phasors[i]);
-            }
+    { /// Pipeline
+        ReportingSettings settings;
+        settings.load();
+        if (!settings.validate().isEmpty()) {
+            qWarning() << "Invalid reporting settings:" << settings.validate()
+                       << "; using the defaults";
+            settings = ReportingSettings();
+        }
+
+        ArchiveSettings archiveSettings;
+        archiveSettings.load();
+        if (!archiveSettings.validate().isEmpty()) {
+            qWarning() << "Invalid archive settings:" << archiveSettings.validate()
+                       << "; archiving is disabled";
+            archiveSettings.directory.clear();
+        }
+
+        PipelineConfig pipelineConfig;
+        pipelineConfig.nominalFrequency = NominalFrequency;
+        pipelineConfig.samplingRate = SamplingRate;
+        pipelineConfig.reportingRates.assign(settings.rates.begin(), settings.rates.end());
+        pipelineConfig.filterClass = settings.filterClass;
+        pipelineConfig.station = std::to_string(station);
+        if (!archiveSettings.directory.isEmpty()) {
+            pipelineConfig.archiveRate = archiveSettings.rate;
+        }
+        m_pipeline = new Pipeline(pipelineConfig);
+
+        /// The first station's processor creates the archive, before the others are created
+        if (station == 0 && !archiveSettings.directory.isEmpty()) {
+            ArchiveConfig archiveConfig;
+            archiveConfig.directory = archiveSettings.directory.toStdString();
+            archiveConfig.chunkSeconds = archiveSettings.chunkSeconds;
+            archiveConfig.chunkRecords = archiveSettings.chunkSeconds * archiveSettings.rate;
+            archiveConfig.retentionDays = archiveSettings.retentionDays;
+            archiveConfig.blockWhenFull = m_simulation;
+            m_archive = new ArchiveWriter(archiveConfig, [](const std::string &error) {
+                qWarning() << "Archive:" << error.c_str();
+            });
+            qDebug() << "* Archiving to" << archiveSettings.directory;
+
+            /// Write the open chunks on a clean exit
+            auto archive = m_archive;
+            connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                    [archive] { archive->flush(); });
+        }
+
+        for (const auto &reporter : m_pipeline->reporters()) {
+            qDebug() << (reporter.report ? "* Reporting at" : "* Archiving at")
+                     << reporter.filter.reportingRate() << "fps with a"
+                     << reporter.filter.length() << "tap filter (delay"
+                     << reporter.filter.groupDelayUsec() << "us)";
         }
-    }
 
-    for (size_t i = 0; i < CountSignals; ++i) {
-        auto medianMagnitude = median(filterableMagnitudes[i]);
-        result.phasors[i] = std::polar(medianMagnitude, std::arg(result.phasors[i]));
+        m_pipeline->setReportCallback([this](const ReportingInstant &instant,
+                                             const Estimation &estimation) {
+            emit estimationReported(m_station, instant, estimation);
+        });
+        const auto idCode = (uint16_t)config.idCode;
+        m_pipeline->setArchiveCallback([this, idCode](const ReportingInstant &instant,
+                                                      const Estimation &estimation) {
+            if (m_archive) {
+                m_archive->push(idCode, instant.timeUsec, estimation);
+            }
+        });
+        m_pipeline->setErrorCallback(
+                [](const std::string &error) { qWarning() << error.c_str(); });
     }
-    return result;
-}
 
-const qpmu::Sample &DataProcessor::lastSample()
-{
-    QMutexLocker locker(&m_mutex);
-    return m_samples.back();
-}
+    { /// Flight recorder
+        RecorderSettings settings;
+        settings.load();
+        if (!settings.validate().isEmpty()) {
+            qWarning() << "Invalid recorder settings:" << settings.validate()
+                       << "; the flight recorder is disabled";
+            settings.directory.clear();
+        }
+        if (!settings.directory.isEmpty()) {
+            FlightRecorderConfig recorderConfig;
+            recorderConfig.directory = settings.directory.toStdString();
+            recorderConfig.stationName = config.name.toStdString();
+            recorderConfig.idCode = config.idCode;
+            recorderConfig.nominalFrequency = NominalFrequency;
+            recorderConfig.samplingRate = SamplingRate;
+            recorderConfig.windowCycles = m_pipeline->config().windowCycles;
+            recorderConfig.bufferSeconds = settings.bufferSeconds;
+            recorderConfig.preTriggerSeconds = settings.preTriggerSeconds;
+            recorderConfig.postTriggerSeconds = settings.postTriggerSeconds;
+            recorderConfig.magnitudeStep = settings.magnitudeStep;
+            recorderConfig.frequencyDeviation = settings.frequencyDeviation;
+            recorderConfig.writeOnRecordingThread = m_simulation;
+            m_recorder = new FlightRecorder(recorderConfig, [](const std::string &error) {
+                qWarning() << "Flight recorder:" << error.c_str();
+            });
+            qDebug() << "* Recording" << settings.bufferSeconds << "s of raw samples of station"
+                     << config.name << "to" << settings.directory;
+        }
+    }
 
-const SampleWindow &DataProcessor::sampleWindow()
-{
-    QMutexLocker locker(&m_mutex);
-    return m_samples;
-}
+    { /// Shared-memory publication and UDP feed of the estimations
+        NetworkSettings settings;
+        settings.load();
+        if (!settings.validate().isEmpty()) {
+            settings.estimationShm.clear();
+            settings.feedConfig.destination.clear();
+        }
+        if (!settings.estimationShm.isEmpty()) {
+            const auto name = QString("%1-%2").arg(settings.estimationShm).arg(config.idCode);
+            std::string error;
+            m_publisher = new EstimationPublisher();
+            if (m_publisher->create(name.toStdString(), config.idCode,
+                                    EstimationPublisher::DefaultCapacity, error)) {
+                qDebug() << "* Publishing the estimations of station" << config.name << "to"
+                         << name;
+            } else {
+                qWarning() << "Estimation ring:" << error.c_str();
+                delete m_publisher;
+                m_publisher = nullptr;
+            }
+        }
+        if (!settings.feedConfig.destination.isEmpty()) {
+            QHostAddress host;
+            quint16 port = 0;
+            parseHostPort(settings.feedConfig.destination, host, port);
+            EstimationFeedConfig feedConfig;
+            feedConfig.host = host.toString().toStdString();
+            feedConfig.port = port;
+            feedConfig.rate = settings.feedConfig.rate;
+            feedConfig.multicastTtl = settings.udpConfig.multicastTtl;
+            feedConfig.idCode = config.idCode;
+            std::string error;
+            m_feed = new EstimationFeed();
+            if (m_feed->open(feedConfig, error)) {
+                const auto rate = feedConfig.rate ? QString("%1 packets/s").arg(feedConfig.rate)
+                                                  : QString("every sample");
+                qDebug() << "* Feeding the estimations of station" << config.name << "to"
+                         << settings.feedConfig.destination << "at" << rate;
+            } else {
+                qWarning() << "Estimation feed:" << error.c_str();
+                delete m_feed;
+                m_feed = nullptr;
+            }
+        }
+    }
 
-DataProcessor::DataProcessor() : QThread()
-{
-    m_estimator = new PhasorEstimator(50, 1200);
+    if (m_recorder || m_publisher || m_feed) {
+        auto recorder = m_recorder;
+        auto publisher = m_publisher;
+        auto feed = m_feed;
+        m_pipeline->setEstimationCallback(
+                [recorder, publisher, feed](const Sample &sample, const Estimation &estimation) {
+                    if (recorder) {
+                        recorder->record(sample, estimation);
+                    }
+                    if (publisher) {
+                        publisher->publish(sample, estimation);
+                    }
+                    if (feed) {
+                        feed->publish(sample, estimation);
+                    }
+                });
+    }
 
-    if (APP->arguments().contains("--binary") || APP->arguments().contains("-b")) {
-        m_readBinary = true;
-        qDebug() << "Reading processed samples (in binary) from stdin";
+    if (arguments.contains("--binary") || arguments.contains("-b")) {
+        qDebug() << "Reading processed samples (in binary) for station" << config.name;
     } else {
         qFatal("Not implemented\n");
     }
 
-    auto adcStreamPath = qgetenv("ADC_STREAM");
+    auto adcStreamPath = config.input.toLocal8Bit();
+    if (adcStreamPath.isEmpty()) {
+        adcStreamPath = qgetenv("ADC_STREAM");
+    }
     if (!adcStreamPath.isEmpty()) {
         qDebug() << "Reading from the adc stream device: " << adcStreamPath;
-        inputFile = fopen(adcStreamPath.constData(), "rb");
-        if (!inputFile) {
-            qFatal("Failed to open ADC stream device");
+        m_source = openSampleSource(adcStreamPath.toStdString()).release();
+        if (!m_source->isOpen()) {
+            qFatal("Failed to open ADC stream device: %s", m_source->openError().c_str());
         }
+    } else {
+        m_source = new FileSampleSource(stdin);
+    }
+
+    if (station > 0) {
+        return;
+    }
+
+    /// The first station's processor owns the server and the other stations' processors
+    for (int i = 1; i < stations.stations.size(); ++i) {
+        auto processor = new DataProcessor(i);
+        processor->m_archive = m_archive;
+        m_otherStations.append(processor);
     }
 
     m_server = new PhasorServer();
     m_serverThread = new QThread();
     m_server->moveToThread(m_serverThread);
+    connectPhasorServer();
+    replaceMetricsServer();
     m_serverThread->start();
+    QMetaObject::invokeMethod(m_server, [] { QPMU_TRACE_THREAD_NAME("server"); });
+}
+
+void DataProcessor::triggerRecorders()
+{
+    if (m_recorder) {
+        m_recorder->trigger();
+    }
+    for (auto processor : m_otherStations) {
+        processor->triggerRecorders();
+    }
 }
 
 void DataProcessor::replacePhasorServer()
@@ -115,54 +255,119 @@ void DataProcessor::replacePhasorServer()
     m_server->deleteLater();
     m_server = new PhasorServer();
     m_server->moveToThread(m_serverThread);
+    connectPhasorServer();
+    replaceMetricsServer();
 }
 
-void DataProcessor::run()
+void DataProcessor::replaceMetricsServer()
 {
-    while (true) {
+    if (auto old = m_metricsServer) {
+        /// Stop listening before the new server binds, possibly to the same port
+        QMetaObject::invokeMethod(
+                old,
+                [old] {
+                    old->close();
+                    old->deleteLater();
+                },
+                Qt::BlockingQueuedConnection);
+        m_metricsServer = nullptr;
+    }
 
-        QString error;
-        auto nread = readSamples(error);
-        if (!error.isEmpty()) {
-            qWarning() << error;
-            continue;
-        }
+    NetworkSettings settings;
+    settings.load();
+    QHostAddress host;
+    quint16 port;
+    if (!settings.metricsEndpoint.isEmpty()
+        && parseHostPort(settings.metricsEndpoint, host, port)) {
+        m_metricsServer = new MetricsServer(host, port);
+        m_metricsServer->setTriggerCallback([this] { triggerRecorders(); });
+        m_metricsServer->moveToThread(m_serverThread);
+    }
+}
 
-        for (size_t i = 0; i < nread; ++i) {
-            const auto &sample = m_sampleReadBuffer[i];
+void DataProcessor::connectPhasorServer()
+{
+    /// A simulation waits for the server to send each instant, so that it cannot run ahead
+    const auto type = m_simulation ? Qt::BlockingQueuedConnection : Qt::AutoConnection;
+    connect(this, &DataProcessor::estimationReported, m_server, &PhasorServer::sendData, type);
+    for (auto processor : m_otherStations) {
+        connect(processor, &DataProcessor::estimationReported, m_server,
+                &PhasorServer::sendData, type);
+    }
+}
 
-            QMutexLocker locker(&m_mutex);
+void DataProcessor::run()
+{
+    QPMU_TRACE_THREAD_NAME("station " + std::to_string(m_station));
+    if (m_cpu >= 0 && !pinCurrentThread(m_cpu)) {
+        qWarning() << "Failed to pin station" << m_station << "to CPU" << m_cpu;
+    }
 
-            /// shift buffer and add new sample
-            for (size_t j = 1; j < m_samples.size(); ++j) {
-                m_samples[j - 1] = m_samples[j];
-            }
-            m_samples.back() = sample;
-            qDebug() << QString::fromStdString(toString(sample));
+    if (m_simulation) {
+        runSimulation();
+        return;
+    }
 
-            /// shift buffer and add new estimation
-            for (size_t j = 1; j < m_estimations.size(); ++j) {
-                m_estimations[j - 1] = m_estimations[j];
-            }
-            m_estimator->updateEstimation(sample);
-            m_estimations.back() = m_estimator->currentEstimation();
-        }
+    /// The other stations' pipelines run alongside this one
+    for (auto processor : m_otherStations) {
+        processor->start(QThread::TimeCriticalPriority);
     }
+
+    m_pipeline->run(*m_source);
 }
 
-uint64_t DataProcessor::readSamples(QString &error) const
+void DataProcessor::runSimulation()
 {
-    uint64_t nread = 0;
-    if (m_readBinary) {
-        nread = fread((void *)m_sampleReadBuffer.data(), sizeof(Sample),
-                      std::tuple_size<SampleReadBuffer>(), inputFile);
-        if (nread < std::tuple_size<SampleReadBuffer>()) {
-            if (feof(inputFile)) {
-                error = "End of input stream reached";
-            } else if (ferror(inputFile)) {
-                error = "Error reading from input stream";
+    QList<DataProcessor *> processors = { this };
+    processors.append(m_otherStations);
+
+    /// Next sample of each station, if its input has not ended
+    std::vector<Sample> next(processors.size());
+    std::vector<bool> pending(processors.size(), false);
+    std::string error;
+    auto readNext = [&](int i) {
+        error.clear();
+        pending[i] = processors[i]->m_source->read(&next[i], 1, error) == 1;
+        if (!pending[i]) {
+            qDebug() << "* Input of station" << processors[i]->m_station
+                     << "ended:" << error.c_str();
+        }
+    };
+    for (int i = 0; i < processors.size(); ++i) {
+        readNext(i);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    int64_t countSamples = 0;
+    int64_t firstUsec = 0;
+    int64_t lastUsec = 0;
+    while (!isInterruptionRequested()) {
+        int earliest = -1;
+        for (int i = 0; i < processors.size(); ++i) {
+            if (pending[i]
+                && (earliest < 0 || next[i].timestampUsec < next[earliest].timestampUsec)) {
+                earliest = i;
             }
         }
+        if (earliest < 0) {
+            break;
+        }
+        const auto &sample = next[earliest];
+        if (countSamples++ == 0) {
+            firstUsec = sample.timestampUsec;
+        }
+        lastUsec = std::max(lastUsec, sample.timestampUsec);
+        processors[earliest]->m_pipeline->process(sample);
+        readNext(earliest);
     }
-    return nread;
+
+    const auto seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto simulatedSeconds = (double)(lastUsec - firstUsec) / TimeDenom;
+    qInfo() << "Simulated" << countSamples << "samples, i.e.," << simulatedSeconds
+            << "s of input, in" << seconds << "s:" << (int64_t)(countSamples / std::max(seconds, 1e-9))
+            << "samples/s," << simulatedSeconds / std::max(seconds, 1e-9) << "times real time";
+
+    /// The archive is flushed on the way out
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [] { QCoreApplication::quit(); });
 }
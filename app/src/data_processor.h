@@ -2,51 +2,100 @@
 #define QPMU_APP_DATA_PROCESSOR_H
 
 #include "qpmu/defs.h"
-#include "qpmu/estimator.h"
-#include "app.h"
+#include "qpmu/archive_writer.h"
+#include "qpmu/estimation_feed.h"
+#include "qpmu/estimation_publisher.h"
+#include "qpmu/flight_recorder.h"
+#include "qpmu/pipeline.h"
+#include "qpmu/reporting.h"
+#include "qpmu/sample_source.h"
 #include "phasor_server.h"
+#include "metrics_server.h"
 
 #include <QThread>
-#include <QMutex>
-#include <QMutexLocker>
+#include <QList>
 
-#include <array>
-
-using SampleWindow = std::array<qpmu::Sample, 128>;
-using EstimationWindow = std::array<qpmu::Estimation, 128>;
-
-using SampleReadBuffer = std::array<qpmu::Sample, 1>;
+using SampleWindow = qpmu::Pipeline::SampleWindow;
+using EstimationWindow = qpmu::Pipeline::EstimationWindow;
 
+/// @brief Qt adapter of a station's `qpmu::Pipeline`: runs it on a `QThread`, configures it from
+/// the settings, and turns its reports into signals for the phasor server.
 class DataProcessor : public QThread
 {
     Q_OBJECT
 
 public:
-    DataProcessor();
+    /// Nominal frequency and sampling rate of the input samples (in Hz)
+    static constexpr size_t NominalFrequency = 50;
+    static constexpr size_t SamplingRate = 1200;
 
-    void run() override;
+    /// Processor of the station at the given index of `StationSettings::stations`; the first one
+    /// also creates the others and the phasor server
+    explicit DataProcessor(int station = 0);
 
-    uint64_t readSamples(QString &error) const;
+    void run() override;
 
-    const qpmu::Estimation &lastEstimation();
-    const qpmu::Estimation lastEstimationFiltered();
-    const qpmu::Sample &lastSample();
-    const SampleWindow &sampleWindow();
+    const qpmu::Estimation lastEstimation() const { return m_pipeline->lastEstimation(); }
+    const qpmu::Estimation lastEstimationFiltered() const
+    {
+        return m_pipeline->lastEstimationFiltered();
+    }
+    const qpmu::Sample lastSample() const { return m_pipeline->lastSample(); }
+    const SampleWindow sampleWindow() const { return m_pipeline->sampleWindow(); }
 
     void replacePhasorServer();
     PhasorServer *phasorServer() const { return m_server; }
 
+    int station() const { return m_station; }
+
+    /// Starts a flight recorder capture on every station that has a recorder; thread-safe
+    void triggerRecorders();
+
+signals:
+    /// Emitted from the processing thread, once per reporting instant of every configured rate,
+    /// as soon as the decimation filter's window is centered at or past the instant
+    void estimationReported(int station, const qpmu::ReportingInstant &instant,
+                            const qpmu::Estimation &estimation);
+
 private:
-    QMutex m_mutex;
-    qpmu::PhasorEstimator *m_estimator = nullptr;
-    EstimationWindow m_estimations = {};
-    SampleWindow m_samples = {};
-    SampleReadBuffer m_sampleReadBuffer = {};
-    bool m_readBinary = false;
-    FILE *inputFile = stdin;
+    void connectPhasorServer();
+    void replaceMetricsServer();
+
+    /// Processes the samples of all the stations on this thread, in the order of their
+    /// timestamps, until every input has ended; then quits the application
+    void runSimulation();
+
+    qpmu::Pipeline *m_pipeline = nullptr;
+    qpmu::SampleSource *m_source = nullptr;
+
+    /// Archive of the estimations of all stations, shared by their processors; null if disabled
+    qpmu::ArchiveWriter *m_archive = nullptr;
+
+    /// Flight recorder of the station's raw samples; null if disabled
+    qpmu::FlightRecorder *m_recorder = nullptr;
+
+    /// Shared-memory ring of every estimation of the station; null if disabled
+    qpmu::EstimationPublisher *m_publisher = nullptr;
+
+    /// Internal UDP feed of the station's estimations; null if disabled
+    qpmu::EstimationFeed *m_feed = nullptr;
+
+    int m_station = 0;
+    int m_cpu = -1;
+
+    /// Whether the process runs a simulation (`--simulate`): on the virtual clock, as fast as the
+    /// inputs can be processed, and with the same output on every run
+    bool m_simulation = false;
+
+    /// Processors of the other stations (owned by the first station's processor only)
+    QList<DataProcessor *> m_otherStations = {};
 
     PhasorServer *m_server = nullptr;
+    MetricsServer *m_metricsServer = nullptr;
     QThread *m_serverThread = nullptr;
 };
 
+Q_DECLARE_METATYPE(qpmu::ReportingInstant)
+Q_DECLARE_METATYPE(qpmu::Estimation)
+
 #endif // QPMU_APP_DATA_PROCESSOR_H
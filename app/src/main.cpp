@@ -1,5 +1,6 @@
 #include "app.h"
 #include "main_window.h"
+#include "qpmu/trace.h"
 
 int main(int argc, char *argv[])
 {
@@ -7,6 +8,7 @@ int main(int argc, char *argv[])
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 #endif
     App app(argc, argv);
+    QPMU_TRACE_THREAD_NAME("gui");
 
     app.mainWindow()->show();
     
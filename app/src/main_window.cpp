@@ -1,5 +1,6 @@
 #include "main_window.h"
 #include "main_page_interface.h"
+#include "metrics_page.h"
 #include "phasor_monitor.h"
 #include "settings_widget.h"
 #include "data_processor.h"
@@ -72,6 +73,20 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
                             createDataReportingIndicator(PhasorServer::DataSending) }) {
                 f();
             }
+
+            /// Delay between the reporting instant and the frame being written to the socket
+            auto latencyLabel = new QLabel(statusBar());
+            statusBar()->addPermanentWidget(latencyLabel);
+            connect(APP->timer(), &QTimer::timeout, [=] {
+                auto latency = APP->dataProcessor()->phasorServer()->dispatchLatency();
+                latencyLabel->setText(
+                        QStringLiteral("%1 ms").arg(latency.lastUsec / 1000.0, 0, 'f', 1));
+                latencyLabel->setToolTip(
+                        QStringLiteral("Dispatch latency (min/mean/max): %1/%2/%3 ms")
+                                .arg(latency.minUsec / 1000.0, 0, 'f', 1)
+                                .arg(latency.meanUsec() / 1000.0, 0, 'f', 1)
+                                .arg(latency.maxUsec / 1000.0, 0, 'f', 1));
+            });
         }
 
         statusBar()->addPermanentWidget(makeSeparator());
@@ -194,6 +209,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
         homeOptions.append(HomeOption{ "Monitor", ":/monitor.png", new PhasorMonitor() });
         homeOptions.append(HomeOption{ "Oscilloscope", ":/waves.png", new Oscilloscope() });
         homeOptions.append(HomeOption{ "Settings", ":/control-panel.png", new SettingsWidget() });
+        homeOptions.append(HomeOption{ "Metrics", ":/meter.png", new MetricsPage() });
 
         const int rowCount = 2;
         const int colCount = 2;
@@ -0,0 +1,37 @@
+#include "metrics_page.h"
+#include "app.h"
+#include "qpmu/metrics.h"
+
+#include <QFontDatabase>
+#include <QScrollBar>
+#include <QVBoxLayout>
+
+MetricsPage::MetricsPage(QWidget *parent) : QWidget(parent)
+{
+    hide();
+
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_text = new QPlainTextEdit(this);
+    m_text->setReadOnly(true);
+    m_text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    layout->addWidget(m_text);
+
+    connect(APP->timer(), &QTimer::timeout, this, &MetricsPage::updateView);
+}
+
+void MetricsPage::updateView()
+{
+    if (!isVisible()) {
+        return;
+    }
+
+    /// Keep the scroll position across updates
+    auto scroll = m_text->verticalScrollBar()->value();
+    const auto &registry = qpmu::MetricsRegistry::instance();
+    m_text->setPlainText(QString::fromStdString(registry.renderLatencyReport() + "\n"
+                                                + registry.renderPrometheus()));
+    m_text->verticalScrollBar()->setValue(scroll);
+}
@@ -0,0 +1,25 @@
+#ifndef QPMU_APP_METRICS_PAGE_H
+#define QPMU_APP_METRICS_PAGE_H
+
+#include "main_page_interface.h"
+
+#include <QWidget>
+#include <QPlainTextEdit>
+
+/// Page showing the process's metrics, as served by the metrics endpoint
+class MetricsPage : public QWidget, public MainPageInterface
+{
+    Q_OBJECT
+    Q_INTERFACES(MainPageInterface)
+
+public:
+    explicit MetricsPage(QWidget *parent = nullptr);
+
+private slots:
+    void updateView();
+
+private:
+    QPlainTextEdit *m_text = nullptr;
+};
+
+#endif // QPMU_APP_METRICS_PAGE_H
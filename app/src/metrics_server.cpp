@@ -0,0 +1,74 @@
+#include "metrics_server.h"
+#include "qpmu/metrics.h"
+#include "qpmu/trace.h"
+
+#include <QByteArray>
+#include <QDebug>
+
+MetricsServer::MetricsServer(const QHostAddress &host, quint16 port)
+{
+    connect(this, &QTcpServer::newConnection, this, &MetricsServer::handleConnection);
+    if (!listen(host, port)) {
+        qWarning() << "MetricsServer: Failed to listen on" << host.toString() << port << ":"
+                   << errorString();
+    } else {
+        qDebug() << "* Serving metrics on: "
+                 << QString("%1:%2/metrics").arg(host.toString()).arg(port);
+    }
+}
+
+void MetricsServer::handleConnection()
+{
+    while (auto socket = nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [=] { handleRequest(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket)
+{
+    /// Wait for the end of the request header
+    auto request = socket->peek(MaxRequestBytes);
+    if (!request.contains("\r\n\r\n") && request.size() < MaxRequestBytes) {
+        return;
+    }
+    socket->disconnect(this);
+
+    QByteArray status;
+    QByteArray contentType = "text/plain; version=0.0.4; charset=utf-8";
+    QByteArray body;
+    auto requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    if (requestLine.size() >= 2 && requestLine[0] == "POST" && requestLine[1] == "/trigger") {
+        if (m_onTrigger) {
+            m_onTrigger();
+            status = "202 Accepted";
+            body = "Triggered\n";
+        } else {
+            status = "404 Not Found";
+        }
+    } else if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        status = "405 Method Not Allowed";
+    } else if (requestLine[1] == "/metrics") {
+        status = "200 OK";
+        body = QByteArray::fromStdString(qpmu::MetricsRegistry::instance().renderPrometheus());
+    } else if (requestLine[1] == "/latency") {
+        status = "200 OK";
+        body = QByteArray::fromStdString(qpmu::MetricsRegistry::instance().renderLatencyReport());
+    } else if (requestLine[1] == "/trace") {
+        status = "200 OK";
+        contentType = "application/json";
+        body = QByteArray::fromStdString(qpmu::TraceRecorder::instance().renderChromeJson());
+    } else {
+        status = "404 Not Found";
+    }
+
+    QByteArray response;
+    response += "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
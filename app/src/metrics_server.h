@@ -0,0 +1,37 @@
+#ifndef QPMU_APP_METRICS_SERVER_H
+#define QPMU_APP_METRICS_SERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+
+#include <functional>
+
+/// @brief Minimal HTTP server answering `GET /metrics` with the process's metrics, in the
+/// Prometheus text format, `GET /latency` with a table of the latency percentiles, and
+/// `GET /trace` with the recorded trace events as Chrome trace-event JSON (empty unless built with
+/// `ENABLE_TRACING`). `POST /trigger` starts a flight recorder capture.
+///
+/// Every response closes the connection; requests are read up to `MaxRequestBytes`.
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 MaxRequestBytes = 8192;
+
+    MetricsServer(const QHostAddress &host, quint16 port);
+
+    /// Called on `POST /trigger`, on the server's thread
+    void setTriggerCallback(std::function<void()> callback) { m_onTrigger = std::move(callback); }
+
+private slots:
+    void handleConnection();
+
+private:
+    void handleRequest(QTcpSocket *socket);
+
+    std::function<void()> m_onTrigger = {};
+};
+
+#endif // QPMU_APP_METRICS_SERVER_H
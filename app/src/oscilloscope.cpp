@@ -1,5 +1,7 @@
 #include "oscilloscope.h"
+#include "app.h"
 #include "settings_models.h"
+#include "qpmu/trace.h"
 #include "src/data_processor.h"
 
 #include <QDateTime>
@@ -65,6 +67,7 @@ void Oscilloscope::updateView()
     if (!isVisible()) {
         return;
     }
+    QPMU_TRACE_SCOPE("oscilloscope update");
 
     auto settings = new VisualisationSettings();
     auto samples = APP->dataProcessor()->sampleWindow();
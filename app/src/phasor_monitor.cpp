@@ -1,4 +1,5 @@
 #include "qpmu/defs.h"
+#include "qpmu/trace.h"
 #include "app.h"
 #include "data_processor.h"
 #include "equally_scaled_axes_chart.h"
@@ -96,6 +97,7 @@ void PhasorMonitor::updateView()
     if (!isVisible()) {
         return;
     }
+    QPMU_TRACE_SCOPE("phasor monitor update");
 
     const auto estimation = APP->dataProcessor()->lastEstimationFiltered();
     const auto sample = APP->dataProcessor()->lastSample();
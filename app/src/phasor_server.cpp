@@ -1,34 +1,79 @@
 #include "phasor_server.h"
-#include "data_processor.h"
 #include "qpmu/defs.h"
-#include "qpmu/util.h"
+#include "qpmu/clock.h"
+#include "qpmu/trace.h"
 
 #include <QDateTime>
 #include <QTcpSocket>
 
 #include <c37118.h>
 
+#ifdef Q_OS_LINUX
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <sys/uio.h>
+#  include <cstring>
+#endif
+
 using namespace qpmu;
 
 PhasorServer::PhasorServer()
 {
     m_settings.load();
+    m_reportingSettings.load();
+    if (!m_reportingSettings.validate().isEmpty()) {
+        m_reportingSettings = ReportingSettings();
+    }
+    m_stationSettings.load();
+    if (!m_stationSettings.validate().isEmpty()) {
+        m_stationSettings = StationSettings();
+    }
     m_state = 0;
 
+    { /// Metrics, shared with the servers this one replaces
+        auto &registry = MetricsRegistry::instance();
+        m_metrics.clients = &registry.gauge("qpmu_clients", "Connected clients (TCP and UDP).");
+        m_metrics.framesSent = &registry.counter(
+                "qpmu_frames_sent_total",
+                "Data frames handed to a client's socket or send queue, or to a UDP receiver.");
+        m_metrics.bytesSent =
+                &registry.counter("qpmu_bytes_sent_total", "Bytes of the data frames sent.");
+        m_metrics.framesDropped = &registry.counter(
+                "qpmu_frames_dropped_total", "Data frames discarded by full send queues.");
+        m_metrics.queuedBytes = &registry.gauge("qpmu_send_queue_bytes",
+                                                "Bytes waiting in the send queues of all clients.");
+        m_metrics.queuedFrames = &registry.gauge(
+                "qpmu_send_queue_frames", "Frames waiting in the send queues of all clients.");
+        m_metrics.incompleteInstants = &registry.counter(
+                "qpmu_instants_incomplete_total",
+                "Reporting instants sent with some stations missing.");
+        m_metrics.dispatchLatency = &registry.histogram(
+                "qpmu_dispatch_latency_us",
+                "Delay from a reporting instant to its data frame being handed to the sockets.",
+                latencyBucketsUsec());
+
+        const std::string name = "qpmu_frame_age_us";
+        const std::string help = "Age of the newest sample of a data frame when the sample was "
+                                 "dequeued, estimated, packed and written to the sockets.";
+        m_metrics.ageAtDequeue = &registry.latency(name, help, "stage=\"dequeue\"");
+        m_metrics.ageAtEstimate = &registry.latency(name, help, "stage=\"estimate\"");
+        m_metrics.ageAtPack = &registry.latency(name, help, "stage=\"pack\"");
+        m_metrics.ageAtWrite = &registry.latency(name, help, "stage=\"write\"");
+    }
+
     {
         m_config2 = new CONFIG_Frame();
         m_config1 = new CONFIG_1_Frame();
         m_dataframe = new DATA_Frame(m_config2);
         m_header = new HEADER_Frame("PMU VERSAO 1.0 1");
-        m_cmd = new CMD_Frame();
-
-        constexpr uint16_t ID_CODE = 17;
-        m_config2->IDCODE_set(ID_CODE);
-        m_config1->IDCODE_set(ID_CODE);
-        m_dataframe->IDCODE_set(ID_CODE);
-        m_config2->DATA_RATE_set(50);
-        m_config1->DATA_RATE_set(50);
-        auto t = epochTime(SystemClock::now()).count();
+
+        const uint16_t streamIdCode = m_stationSettings.streamIdCode;
+        m_config2->IDCODE_set(streamIdCode);
+        m_config1->IDCODE_set(streamIdCode);
+        m_dataframe->IDCODE_set(streamIdCode);
+        m_config2->DATA_RATE_set(m_reportingSettings.primaryRate());
+        m_config1->DATA_RATE_set(m_reportingSettings.primaryRate());
+        auto t = currentTimeUsec();
         m_config1->SOC_set(t / TimeDenom);
         m_config2->SOC_set(t / TimeDenom);
         m_dataframe->SOC_set(t / TimeDenom);
@@ -38,204 +83,721 @@ PhasorServer::PhasorServer()
         m_config1->TIME_BASE_set(TimeDenom);
         m_config2->TIME_BASE_set(TimeDenom);
 
-        m_station = new PMU_Station("PMU 1", ID_CODE, true, true, true, false);
+        /// One station block per acquisition pipeline, in the order of the settings
+        for (const auto &config : m_stationSettings.stations) {
+            auto station = new PMU_Station(config.name.toStdString(), config.idCode, true, true,
+                                           true, false);
 
-        for (size_t i = 0; i < CountSignals; ++i) {
-            m_station->PHASOR_add(NameOfSignal[i], 1,
-                                  TypeOfSignal[i] == VoltageSignal ? PHUNIT_Bit::VOLTAGE
-                                                                   : PHUNIT_Bit::CURRENT);
-        }
+            for (size_t i = 0; i < CountSignals; ++i) {
+                station->PHASOR_add(NameOfSignal[i], 1,
+                                    TypeOfSignal[i] == VoltageSignal ? PHUNIT_Bit::VOLTAGE
+                                                                     : PHUNIT_Bit::CURRENT);
+            }
 
-        m_station->FNOM_set(FN_50HZ);
-        m_station->CFGCNT_set(1);
-        m_station->STAT_set(2048);
+            station->FNOM_set(FN_50HZ);
+            station->CFGCNT_set(1);
+            station->STAT_set(StationStat);
 
-        m_config2->PMUSTATION_ADD(m_station);
-        m_config1->PMUSTATION_ADD(m_station);
+            m_config2->PMUSTATION_ADD(station);
+            m_config1->PMUSTATION_ADD(station);
+            m_stations.append(station);
+        }
+        invalidateConfigFrames();
     }
 
-    /// Client
-    connect(this, &QTcpServer::newConnection, this, &PhasorServer::handleClientConnection);
-    setMaxPendingConnections(1); // Only one connection at a time
-    listen(QHostAddress(m_settings.socketConfig.host), m_settings.socketConfig.port);
+    { /// Data frame serializer; the constant fields come from a frame packed once by the library
+        StationLayout layout;
+        layout.countPhasors = CountSignals;
+        layout.polarPhasors = false;
+        layout.floatPhasors = true;
+        layout.floatAnalogs = true;
+        layout.floatFrequency = true;
+        layout.nominalFrequency = 50;
+        m_frameWriter = DataFrameWriter(std::vector<StationLayout>(m_stations.size(), layout));
+
+        uint8_t *buffer = nullptr;
+        auto size = m_dataframe->pack(&buffer);
+        if (!m_frameWriter.loadTemplate(buffer, size)) {
+            qWarning() << "PhasorServer: Unexpected data frame size" << size
+                       << "; falling back to packing every frame";
+        }
+        std::free(buffer);
+    }
 
+    const bool udpOutput = (m_settings.socketConfig.socketType == NetworkSettings::UdpSocket);
+    const auto host = QHostAddress(m_settings.socketConfig.host);
+    const auto port = m_settings.socketConfig.port;
     auto addrStr =
             QString("%1:%2").arg(m_settings.socketConfig.host).arg(m_settings.socketConfig.port);
-    if (!isListening()) {
-        qWarning() << "Failed to start listening on " << addrStr;
-        qWarning() << "Error: " << errorString();
-    } else {
-        qDebug() << "* PMU with ID: " << m_config1->IDCODE_get();
-        qDebug() << "* Listening on: " << addrStr;
-        qDebug() << "* At data rate: " << m_config1->DATA_RATE_get() << "Hz";
-        m_state |= Listening;
+
+    qDebug() << "* PMU with ID: " << m_config1->IDCODE_get() << "and" << m_stations.size()
+             << "station(s)";
+    qDebug() << "* At data rates: " << m_reportingSettings.rates << "Hz";
+
+    /// TCP clients; with UDP output, TCP is only the (optional) command channel
+    if (!udpOutput || m_settings.udpConfig.tcpCommandChannel) {
+        connect(this, &QTcpServer::newConnection, this, &PhasorServer::handleClientConnection);
+        setMaxPendingConnections(MaxClients);
+        listen(host, port);
+
+        if (!isListening()) {
+            qWarning() << "Failed to start listening on " << addrStr;
+            qWarning() << "Error: " << errorString();
+        } else {
+            qDebug() << "* Listening on: " << addrStr;
+            m_state |= Listening;
+        }
+    }
+
+    /// UDP output; the socket also receives commands from UDP clients
+    if (udpOutput) {
+        for (const auto &destination : m_settings.udpConfig.destinations) {
+            UdpDestination d;
+            if (parseHostPort(destination, d.address, d.port)
+                && m_udpDestinations.size() < MaxUdpDestinations) {
+                m_udpDestinations.append(d);
+            } else {
+                qWarning() << "PhasorServer: Ignoring UDP destination" << destination;
+            }
+        }
+        m_udpTargets.reserve(MaxUdpDestinations);
+
+        m_udpSocket = new QUdpSocket(this);
+        if (!m_udpSocket->bind(host, port)) {
+            qWarning() << "Failed to bind UDP socket on " << addrStr;
+            qWarning() << "Error: " << m_udpSocket->errorString();
+        } else {
+            m_udpSocket->setSocketOption(QAbstractSocket::MulticastTtlOption,
+                                         m_settings.udpConfig.multicastTtl);
+            m_udpSocket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+            connect(m_udpSocket, &QUdpSocket::readyRead, this, &PhasorServer::handleDatagrams);
+#ifdef Q_OS_LINUX
+            sockaddr_storage local;
+            socklen_t length = sizeof(local);
+            if (::getsockname((int)m_udpSocket->socketDescriptor(), (sockaddr *)&local, &length)
+                == 0) {
+                m_udpFamily = local.ss_family;
+            }
+#endif
+            qDebug() << "* Sending UDP data from: " << addrStr << "to"
+                     << m_settings.udpConfig.destinations;
+            m_state |= Listening;
+        }
     }
 
-    /// Timer
-    m_timer = new QTimer(this);
-    m_timer->setInterval(std::max(0, (int)(1000 / m_config2->DATA_RATE_get())));
-    connect(m_timer, &QTimer::timeout, this, &PhasorServer::sendData);
-    m_timer->start();
+    /// Data frames are sent when `DataProcessor` reports an estimation for a reporting instant
 }
 
 void PhasorServer::handleClientConnection()
 {
-    qDebug() << QDateTime::currentDateTime() << "PhasorServer: New connection";
+    while (auto socket = nextPendingConnection()) {
+        if (m_clients.size() >= MaxClients) {
+            qWarning() << QDateTime::currentDateTime() << "PhasorServer: Refusing connection from"
+                       << socket->peerAddress().toString() << "(too many clients)";
+            socket->close();
+            socket->deleteLater();
+            continue;
+        }
 
-    auto socket = nextPendingConnection();
-    if (!socket)
-        return;
+        auto client = new Client();
+        client->socket = socket;
+        client->reportingRate = m_reportingSettings.primaryRate();
+        client->queue = SendQueue(m_settings.sendQueueConfig.capacityFrames,
+                                  m_frameWriter.size(), m_settings.sendQueueConfig.policy);
+        m_clients.append(client);
+
+        qInfo() << QDateTime::currentDateTime() << "PhasorServer: New connection from"
+                << socket->peerAddress().toString();
+
+        connect(socket, &QTcpSocket::readyRead, this, [=] { handleCommand(client); });
+        connect(socket, &QTcpSocket::disconnected, this, [=] { disconnectClient(client); });
+        connect(socket, &QTcpSocket::bytesWritten, this, [=] { flushQueue(client); });
 
-    if (m_client) {
-        disconnectClient();
+        QMutexLocker locker(&m_mutex);
+        m_countClients = m_clients.size();
+        m_metrics.clients->set(m_countClients);
+        m_state |= Connected;
+    }
+}
+
+void PhasorServer::disconnectClient(Client *client)
+{
+    if (!m_clients.removeOne(client)) {
+        return;
     }
 
-    m_client = socket;
+    qInfo() << QDateTime::currentDateTime() << "PhasorServer: client disconnected";
 
-    qInfo() << QDateTime::currentDateTime() << "PhasorServer: New connection from"
-            << m_client->peerAddress().toString();
+    m_droppedFramesOfGone += client->queue.stats().droppedFrames;
 
-    connect(m_client, &QTcpSocket::readyRead, this, &PhasorServer::handleCommand);
+    if (client->socket) {
+        client->socket->disconnect(this);
+        client->socket->close();
+        client->socket->deleteLater();
+    }
+    delete client;
 
     QMutexLocker locker(&m_mutex);
-    m_state |= Connected;
+    m_countClients = m_clients.size();
+    m_metrics.clients->set(m_countClients);
+    if (m_clients.isEmpty()) {
+        m_state &= ~Connected;
+    }
 }
 
-void PhasorServer::disconnectClient()
+void PhasorServer::handleDatagrams()
 {
-    qInfo() << QDateTime::currentDateTime() << "PhasorServer: client disconnected";
+    uint8_t buffer[FrameAssembler::Capacity];
+    QHostAddress sender;
+    quint16 senderPort = 0;
+
+    while (m_udpSocket->hasPendingDatagrams()) {
+        auto nread =
+                m_udpSocket->readDatagram((char *)buffer, sizeof(buffer), &sender, &senderPort);
+        if (nread < 0) {
+            continue;
+        }
 
-    m_client->close();
-    delete m_client;
-    m_client = nullptr;
+        Client *client = nullptr;
+        for (auto c : m_clients) {
+            if (!c->socket && c->address == sender && c->port == senderPort) {
+                client = c;
+                break;
+            }
+        }
+        if (!client) {
+            if (m_clients.size() >= MaxClients) {
+                continue;
+            }
+            client = new Client();
+            client->address = sender;
+            client->port = senderPort;
+            client->reportingRate = m_reportingSettings.primaryRate();
+            m_clients.append(client);
+
+            qInfo() << QDateTime::currentDateTime() << "PhasorServer: New UDP client"
+                    << client->address.toString() << client->port;
+
+            QMutexLocker locker(&m_mutex);
+            m_countClients = m_clients.size();
+            m_metrics.clients->set(m_countClients);
+            m_state |= Connected;
+        }
 
-    QMutexLocker locker(&m_mutex);
-    m_state &= ~Connected;
+        client->lastHeardUsec = currentTimeUsec();
+        client->assembler.push(buffer, nread);
+        dispatchFrames(client);
+    }
 }
 
-void PhasorServer::handleCommand()
+bool PhasorServer::writeFrame(Client *client, const char *data, qint64 size)
 {
-    uint8_t buffer[1024];
-    auto nread = m_client->read((char *)buffer, sizeof(buffer));
+    if (client->socket) {
+        return enqueueFrame(client, data, size, true) != SendQueue::Refused;
+    }
+    if (m_udpSocket->writeDatagram(data, size, client->address, client->port) < 0) {
+        qWarning("ERROR writing to socket, but continuing to run.");
+    }
+    return true;
+}
+
+SendQueue::PushResult PhasorServer::enqueueFrame(Client *client, const char *data, qint64 size,
+                                                bool reply)
+{
+    auto now = currentTimeUsec();
+    const auto result = reply ? client->queue.pushReply((const uint8_t *)data, size, now)
+                              : client->queue.push((const uint8_t *)data, size, now);
+    if (result == SendQueue::Refused) {
+        qWarning() << QDateTime::currentDateTime()
+                   << "PhasorServer: Send queue full; disconnecting the client";
+        disconnectClient(client);
+        return result;
+    }
+    flushQueue(client);
+    return result;
+}
 
-    if (nread < 0) {
-        qWarning("ERROR reading from socket");
+void PhasorServer::flushQueue(Client *client)
+{
+    QPMU_TRACE_SCOPE("flush send queue");
+    auto socket = client->socket;
+    auto &queue = client->queue;
+    if (queue.empty()) {
         return;
     }
 
-    if (nread == 0) {
-        disconnectClient();
+    auto now = currentTimeUsec();
+    while (!queue.empty() && socket->bytesToWrite() < SocketWatermarkBytes) {
+        auto nwrite = socket->write((const char *)queue.frontData(), queue.frontSize());
+        if (nwrite < 0) {
+            qWarning("ERROR writing to socket");
+            break;
+        }
+        queue.pop(now);
+    }
+}
+
+void PhasorServer::updateSendQueueStats()
+{
+    SendQueue::Stats stats;
+    stats.droppedFrames = m_droppedFramesOfGone;
+    int64_t maxAgeUsec = 0;
+    for (auto client : m_clients) {
+        const auto &s = client->queue.stats();
+        stats.queuedBytes += s.queuedBytes;
+        stats.queuedFrames += s.queuedFrames;
+        stats.droppedFrames += s.droppedFrames;
+        maxAgeUsec = std::max(maxAgeUsec, s.maxAgeUsec);
+        client->queue.resetMaxAge();
+    }
+
+    m_metrics.framesDropped->add(stats.droppedFrames - m_sendQueueStats.droppedFrames);
+    m_metrics.queuedBytes->set(stats.queuedBytes);
+    m_metrics.queuedFrames->set(stats.queuedFrames);
+
+    /// The clients' maxima are folded in here until `sendQueueStats()` reads them
+    QMutexLocker locker(&m_mutex);
+    stats.maxAgeUsec = std::max(m_sendQueueStats.maxAgeUsec, maxAgeUsec);
+    m_sendQueueStats = stats;
+}
+
+void PhasorServer::expireUdpClients()
+{
+    const auto timeoutSec = m_settings.udpConfig.clientTimeoutSec;
+    if (timeoutSec <= 0) {
         return;
     }
+    const auto oldestUsec = currentTimeUsec() - (int64_t)timeoutSec * TimeDenom;
+    for (auto client : QList<Client *>(m_clients)) {
+        if (!client->socket && client->lastHeardUsec < oldestUsec) {
+            qInfo() << QDateTime::currentDateTime() << "PhasorServer: UDP client"
+                    << client->address.toString() << client->port << "timed out";
+            disconnectClient(client);
+        }
+    }
+}
 
-    if (buffer[0] == A_SYNC_AA) {
-        if (buffer[1] == A_SYNC_CMD) {
-            qInfo() << QDateTime::currentDateTime() << "PhasorServer: Command received";
-            m_cmd->unpack(buffer);
+bool PhasorServer::sendDatagrams(const char *data, qint64 size, uint16_t reportingRate)
+{
+    expireUdpClients();
+    m_udpTargets.clear();
+
+    bool anyTcpEnabled = false;
+    for (auto client : m_clients) {
+        if (client->socket) {
+            anyTcpEnabled |= client->dataEnabled;
+        } else if (client->dataEnabled && client->reportingRate == reportingRate
+                   && m_udpTargets.size() < MaxUdpDestinations) {
+            m_udpTargets.append({ client->address, client->port });
+        }
+    }
 
+    /// Configured destinations receive the primary rate, and are commanded by the TCP channel
+    /// when there is one
+    if (reportingRate == m_reportingSettings.primaryRate()
+        && (!m_settings.udpConfig.tcpCommandChannel || anyTcpEnabled)) {
+        for (const auto &d : m_udpDestinations) {
+            if (m_udpTargets.size() < MaxUdpDestinations) {
+                m_udpTargets.append(d);
+            }
+        }
+    }
+
+    if (m_udpTargets.isEmpty()) {
+        return false;
+    }
+
+    int countSent = 0;
+    bool batched[MaxUdpDestinations] = {};
+
+#ifdef Q_OS_LINUX
+    /// Batch every destination the socket can address natively into one system call: IPv4 ones
+    /// on an IPv4 socket, and both IPv6 and (as mapped addresses) IPv4 ones on an IPv6 or
+    /// dual-stack socket. Scoped IPv6 addresses are left to Qt.
+    if (m_udpTargets.size() > 1 && m_udpFamily != 0) {
+        sockaddr_storage addrs[MaxUdpDestinations];
+        mmsghdr msgs[MaxUdpDestinations];
+        iovec iov = { (void *)data, (size_t)size };
+        int countBatched = 0;
+
+        for (int i = 0; i < m_udpTargets.size(); ++i) {
+            const auto &target = m_udpTargets[i];
+            const bool ipv4 = target.address.protocol() == QAbstractSocket::IPv4Protocol;
+            auto &addr = addrs[countBatched];
+            std::memset(&addr, 0, sizeof(addr));
+            socklen_t length = 0;
+            if (m_udpFamily == AF_INET && ipv4) {
+                auto in = (sockaddr_in *)&addr;
+                in->sin_family = AF_INET;
+                in->sin_port = htons(target.port);
+                in->sin_addr.s_addr = htonl(target.address.toIPv4Address());
+                length = sizeof(sockaddr_in);
+            } else if (m_udpFamily == AF_INET6 && (ipv4 || target.address.scopeId().isEmpty())) {
+                /// An IPv4 address converts to its IPv4-mapped IPv6 address
+                const auto ipv6 = target.address.toIPv6Address();
+                auto in6 = (sockaddr_in6 *)&addr;
+                in6->sin6_family = AF_INET6;
+                in6->sin6_port = htons(target.port);
+                std::memcpy(&in6->sin6_addr, &ipv6, sizeof(in6->sin6_addr));
+                length = sizeof(sockaddr_in6);
+            } else {
+                continue;
+            }
+
+            auto &msg = msgs[countBatched];
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_hdr.msg_name = &addr;
+            msg.msg_hdr.msg_namelen = length;
+            msg.msg_hdr.msg_iov = &iov;
+            msg.msg_hdr.msg_iovlen = 1;
+            batched[i] = true;
+            ++countBatched;
+        }
+
+        if (countBatched > 0) {
+            int n = ::sendmmsg((int)m_udpSocket->socketDescriptor(), msgs, countBatched, 0);
+            if (n < 0) {
+                qWarning("ERROR sending datagrams");
+            } else {
+                countSent += n;
+            }
+        }
+    }
+#endif
+
+    for (int i = 0; i < m_udpTargets.size(); ++i) {
+        const auto &target = m_udpTargets[i];
+        if (batched[i]) {
+            continue; /// already sent in the batch
+        }
+        if (m_udpSocket->writeDatagram(data, size, target.address, target.port) == size) {
+            ++countSent;
         } else {
-            qInfo() << QDateTime::currentDateTime() << "PhasorServer: Unknown command received";
+            qWarning("ERROR writing datagram");
+        }
+    }
+
+    m_metrics.framesSent->add(countSent);
+    m_metrics.bytesSent->add(countSent * size);
+    return countSent == m_udpTargets.size();
+}
+
+void PhasorServer::invalidateConfigFrames()
+{
+    m_configFrames.clear();
+}
+
+void PhasorServer::reloadStationSettings()
+{
+    StationSettings settings;
+    settings.load();
+    if (!settings.validate().isEmpty()) {
+        qWarning() << "PhasorServer: Invalid station settings; keeping the current ones";
+        return;
+    }
+    if (settings.stations.size() != m_stations.size()
+        || settings.streamIdCode != m_stationSettings.streamIdCode) {
+        qWarning() << "PhasorServer: The number of stations and the stream ID code change only on"
+                   << "restart";
+    }
+
+    const auto count = std::min(settings.stations.size(), m_stations.size());
+    for (int s = 0; s < count; ++s) {
+        const auto &config = settings.stations[s];
+        auto &current = m_stationSettings.stations[s];
+        if (config.name == current.name && config.idCode == current.idCode) {
+            continue;
+        }
+        auto station = m_stations[s];
+        station->STN_set(config.name.toStdString());
+        station->IDCODE_set(config.idCode);
+        station->CFGCNT_set(station->CFGCNT_get() + 1);
+        current.name = config.name;
+        current.idCode = config.idCode;
+        qInfo() << "PhasorServer: Station" << s << "is now" << config.name << "with ID code"
+                << config.idCode;
+    }
+    invalidateConfigFrames();
+}
+
+const QByteArray &PhasorServer::configFrame(uint16_t command, uint16_t reportingRate)
+{
+    QVector<uint16_t> cfgCnts;
+    cfgCnts.reserve(m_stations.size());
+    for (auto station : m_stations) {
+        cfgCnts.append(station->CFGCNT_get());
+    }
+    if (m_configFramesCfgCnts != cfgCnts) {
+        m_configFrames.clear();
+        m_configFramesCfgCnts = cfgCnts;
+    }
+
+    auto it = m_configFrames.find(reportingRate);
+    if (it == m_configFrames.end()) {
+        auto pack = [](auto *frame) {
+            uint8_t *buffer = nullptr;
+            auto size = frame->pack(&buffer);
+            QByteArray packed((const char *)buffer, size);
+            std::free(buffer);
+            return packed;
+        };
+        /// The shared CONFIG frames keep their DATA_RATE; only the packed copy gets this rate, in
+        /// the word before CHK
+        auto withRate = [reportingRate](QByteArray frame) {
+            auto data = (uint8_t *)frame.data();
+            const auto size = (size_t)frame.size();
+            data[size - 4] = (uint8_t)(reportingRate >> 8);
+            data[size - 3] = (uint8_t)reportingRate;
+            const auto chk = crcCcitt(data, size - FrameChecksumSize);
+            data[size - 2] = (uint8_t)(chk >> 8);
+            data[size - 1] = (uint8_t)chk;
+            return frame;
+        };
+        ConfigFrames frames;
+        frames.header = pack(m_header);
+        frames.config1 = withRate(pack(m_config1));
+        frames.config2 = withRate(pack(m_config2));
+        it = m_configFrames.insert(reportingRate, frames);
+    }
+
+    switch (command) {
+    case 0x03:
+        return it->header;
+    case 0x04:
+        return it->config1;
+    default:
+        return it->config2;
+    }
+}
+
+void PhasorServer::handleCommand(Client *client)
+{
+    QPMU_TRACE_SCOPE("handle command");
+    auto socket = client->socket;
+
+    /// Read straight into the client's assembler, which may hold part of a previous frame
+    while (socket->bytesAvailable() > 0) {
+        size_t space;
+        auto dest = client->assembler.prepare(space);
+        auto nread = socket->read((char *)dest, space);
+
+        if (nread < 0) {
+            qWarning("ERROR reading from socket");
+            return;
+        }
+        if (nread == 0) {
             return;
         }
+
+        client->assembler.commit(nread);
+        if (!dispatchFrames(client)) {
+            return;
+        }
+    }
+}
+
+bool PhasorServer::dispatchFrames(Client *client)
+{
+    const uint8_t *frame = nullptr;
+    size_t size = 0;
+    while (client->assembler.next(frame, size)) {
+        if (!processCommand(client, frame, size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PhasorServer::processCommand(Client *client, const uint8_t *frame, size_t size)
+{
+    if (frameType(frame) != CommandFrameType || size < FrameHeaderSize + 2 + FrameChecksumSize) {
+        qInfo() << QDateTime::currentDateTime() << "PhasorServer: Unknown command received";
+        return true;
     }
+    qInfo() << QDateTime::currentDateTime() << "PhasorServer: Command received";
+
+    client->lastCommand = frameCommand(frame);
 
-    switch (m_cmd->CMD_get()) {
+    switch (client->lastCommand) {
     case 0x01: { // Disable Data Output
         qInfo() << QDateTime::currentDateTime() << "PhasorServer: Disable Data Output";
-        m_sendDataFlag = false;
-        // if (m_state & DataSending) {
-        //     disconnectClient();
-        // }
+        client->dataEnabled = false;
         break;
     }
     case 0x02: { // Enable Data Output
         qInfo() << QDateTime::currentDateTime() << "PhasorServer: Enable Data Output";
-        m_sendDataFlag = true;
+        client->dataEnabled = true;
         break;
     }
     case 0x03: { // Transmit Header Record Frame
         qInfo() << QDateTime::currentDateTime() << "PhasorServer: Transmit Header Record Frame";
-
-        uint8_t *buffer = nullptr;
-        auto size = m_header->pack(&buffer);
-
-        auto nwrite = m_client->write((char *)buffer, size);
-        std::free(buffer);
-
-        if (nwrite < 0) {
-            qWarning("ERROR writing to socket, but continuing to run.");
-        }
-        break;
+        const auto &frame = configFrame(client->lastCommand, client->reportingRate);
+        return writeFrame(client, frame.constData(), frame.size());
     }
     case 0x04: { // Transmit Configuration #1 Record Frame
         qInfo() << QDateTime::currentDateTime()
                 << "PhasorServer: Transmit Configuration #1 Record Frame";
-
-        uint8_t *buffer = nullptr;
-        auto size = m_config1->pack(&buffer);
-
-        auto nwrite = m_client->write((char *)buffer, size);
-        std::free(buffer);
-
-        if (nwrite < 0) {
-            qWarning("ERROR writing to socket, but continuing to run.");
-        }
-        break;
+        const auto &frame = configFrame(client->lastCommand, client->reportingRate);
+        return writeFrame(client, frame.constData(), frame.size());
     }
     case 0x05: { // Transmit Configuration #2 Record Frame
         qInfo() << QDateTime::currentDateTime()
                 << "PhasorServer: Transmit Configuration #2 Record Frame";
-
-        uint8_t *buffer = nullptr;
-        auto size = m_config2->pack(&buffer);
-
-        auto nwrite = m_client->write((char *)buffer, size);
-        std::free(buffer);
-
-        if (nwrite < 0) {
-            qWarning("ERROR writing to socket, but continuing to run.");
+        const auto &frame = configFrame(client->lastCommand, client->reportingRate);
+        return writeFrame(client, frame.constData(), frame.size());
+    }
+    case SelectRateCommand: { // Select Reporting Rate (extended frame)
+        uint16_t rate = 0;
+        if (size >= FrameHeaderSize + 4 + FrameChecksumSize) {
+            rate = readU16(frame + FrameHeaderSize + 2);
+        }
+        if (!m_reportingSettings.rates.contains(rate)) {
+            qWarning() << QDateTime::currentDateTime()
+                       << "PhasorServer: Unconfigured reporting rate requested:" << rate;
+            break;
         }
+        qInfo() << QDateTime::currentDateTime() << "PhasorServer: Reporting rate" << rate;
+        client->reportingRate = rate;
         break;
     }
     }
+    return true;
 }
 
-void PhasorServer::sendData()
+void PhasorServer::sendData(int station, const ReportingInstant &instant,
+                            const Estimation &estimation)
 {
-    if (!m_sendDataFlag || !m_client || !m_client->isOpen()) {
+    if (station < 0 || station >= m_stations.size()) {
+        return;
+    }
+
+    const auto rate = (uint16_t)instant.reportingRate;
+    auto aggregator = m_aggregators.find(rate);
+    if (aggregator == m_aggregators.end()) {
+        aggregator = m_aggregators.insert(rate, StationAggregator(m_stations.size()));
+    }
+
+    /// Sent once every station has reported the instant, or once a newer instant evicts it or
+    /// completes before it
+    for (auto aggregate : aggregator->add(station, instant, estimation)) {
+        sendAggregate(*aggregate);
+    }
+}
+
+void PhasorServer::sendAggregate(const StationAggregator::Aggregate &aggregate)
+{
+    QPMU_TRACE_SCOPE("send frame");
+    const auto &instant = aggregate.instant;
+    if (!aggregate.complete()) {
+        m_metrics.incompleteInstants->add();
+    }
+
+    const bool udpOutput = (m_udpSocket != nullptr);
+    const auto rate = (uint16_t)instant.reportingRate;
+    bool anyEnabled = udpOutput && !m_udpDestinations.isEmpty()
+            && !m_settings.udpConfig.tcpCommandChannel;
+    for (auto client : m_clients) {
+        anyEnabled |= client->dataEnabled;
+    }
+    if (!anyEnabled) {
         QMutexLocker locker(&m_mutex);
         m_state &= ~DataSending;
         return;
     }
 
-    { /// update data
-        auto sample = APP->dataProcessor()->lastSample();
-        auto estimation = APP->dataProcessor()->lastEstimationFiltered();
-
-        m_dataframe->SOC_set(sample.timestampUsec / TimeDenom);
-        m_dataframe->FRACSEC_set(sample.timestampUsec % TimeDenom);
+    /// Only the clients (or, with UDP, the destinations) on this instant's rate receive it
+    anyEnabled = udpOutput && rate == m_reportingSettings.primaryRate();
+    for (auto client : m_clients) {
+        anyEnabled |= client->dataEnabled && client->reportingRate == rate;
+    }
+    if (!anyEnabled) {
+        return;
+    }
 
-        for (size_t i = 0; i < CountSignals; ++i) {
-            m_station->PHASOR_VALUE_set(estimation.phasors[i], i);
+    const char *frame = nullptr;
+    int64_t size = 0;
+    uint8_t *packedBuffer = nullptr;
+
+    /// A station missing from the instant keeps its previous values, flagged as unusable
+    if (m_frameWriter.isLoaded()) { /// update only the changing fields, in place
+        m_frameWriter.setTime(instant.soc, instant.fracsec);
+        for (int s = 0; s < m_stations.size(); ++s) {
+            const auto &estimation = aggregate.estimations[s];
+            if (!aggregate.present[s]) {
+                m_frameWriter.setStat(s, StationStat | MissingStationStatBits);
+                continue;
+            }
+            m_frameWriter.setStat(s, stationStat(aggregate.inputFlags[s]));
+            for (size_t i = 0; i < CountSignals; ++i) {
+                m_frameWriter.setPhasor(s, i, estimation.phasors[i]);
+            }
+            m_frameWriter.setFrequency(s, estimation.frequencies[0]);
+            m_frameWriter.setRocof(s, estimation.rocofs[0]);
+        }
+        frame = (const char *)m_frameWriter.finish();
+        size = m_frameWriter.size();
+    } else { /// update data, and pack with the library
+        m_dataframe->SOC_set(instant.soc);
+        m_dataframe->FRACSEC_set(instant.fracsec);
+
+        for (int s = 0; s < m_stations.size(); ++s) {
+            const auto &estimation = aggregate.estimations[s];
+            auto station = m_stations[s];
+            if (!aggregate.present[s]) {
+                station->STAT_set(StationStat | MissingStationStatBits);
+                continue;
+            }
+            station->STAT_set(stationStat(aggregate.inputFlags[s]));
+            for (size_t i = 0; i < CountSignals; ++i) {
+                station->PHASOR_VALUE_set(estimation.phasors[i], i);
+            }
+            station->FREQ_set(estimation.frequencies[0]);
+            station->DFREQ_set(estimation.rocofs[0]);
         }
-        m_station->FREQ_set(estimation.frequencies[0]);
-        m_station->DFREQ_set(estimation.rocofs[0]);
+
+        size = m_dataframe->pack(&packedBuffer);
+        frame = (const char *)packedBuffer;
     }
+    const auto packedUsec = currentTimeUsec();
 
-    { /// send data
-        uint8_t *buffer = nullptr;
-        int64_t size = m_dataframe->pack(&buffer);
+    { /// send the same buffer to every enabled client
+        QPMU_TRACE_SCOPE("write frame");
+        bool anySent = false;
+        if (udpOutput) {
+            anySent = sendDatagrams(frame, size, rate);
+        } else {
+            /// Iterate over a copy, since a client may be disconnected when its queue is full
+            const auto clients = m_clients;
+            for (auto client : clients) {
+                if (!client->dataEnabled || client->reportingRate != rate
+                    || !client->socket->isOpen()) {
+                    continue;
+                }
+                /// Frames dropped by a full queue count in `framesDropped` instead
+                if (enqueueFrame(client, frame, size) == SendQueue::Queued) {
+                    m_metrics.framesSent->add();
+                    m_metrics.bytesSent->add(size);
+                    anySent = true;
+                }
+            }
+            updateSendQueueStats();
+        }
+        std::free(packedBuffer);
 
-        int64_t nwrite = m_client->write((char *)buffer, size);
-        std::free(buffer);
+        const auto writtenUsec = currentTimeUsec();
+        auto latencyUsec = writtenUsec - instant.timeUsec;
 
-        if (nwrite == size) {
-            // qInfo() << QDateTime::currentDateTime() << "PhasorServer: Data sent to client";
-        } else if (nwrite < 0) {
-            qWarning("ERROR writing to socket");
+        /// Age of the frame's newest sample at each stage of its way to the sockets
+        if (anySent && instant.sampleUsec != 0) {
+            m_metrics.ageAtDequeue->record(instant.dequeuedUsec - instant.sampleUsec);
+            m_metrics.ageAtEstimate->record(instant.estimatedUsec - instant.sampleUsec);
+            m_metrics.ageAtPack->record(packedUsec - instant.sampleUsec);
+            m_metrics.ageAtWrite->record(writtenUsec - instant.sampleUsec);
         }
 
         QMutexLocker locker(&m_mutex);
-        m_state |= ((DataSending | Connected) * bool(nwrite == size));
+        m_state = (m_state & ~DataSending) | (DataSending * anySent);
+        m_dispatchLatency.record(latencyUsec);
+        m_metrics.dispatchLatency->record(latencyUsec);
     }
-}
\ No newline at end of file
+}
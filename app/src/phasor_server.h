@@ -2,6 +2,13 @@
 #define QPMU_APP_PHASOR_SENDER_H
 
 #include "qpmu/defs.h"
+#include "qpmu/aggregation.h"
+#include "qpmu/frames.h"
+#include "qpmu/frame_assembler.h"
+#include "qpmu/input_monitor.h"
+#include "qpmu/metrics.h"
+#include "qpmu/reporting.h"
+#include "qpmu/send_queue.h"
 #include "settings_models.h"
 
 #include <c37118.h>
@@ -12,11 +19,15 @@
 #include <c37118command.h>
 
 #include <QObject>
-#include <QTimer>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QVector>
+#include <QByteArray>
+#include <QMap>
 
 class PhasorServer : public QTcpServer
 {
@@ -28,14 +39,64 @@ public:
         DataSending = 1 << 2,
     };
 
+    /// The "extended frame" command of C37.118.2-2011, used to select one of the configured
+    /// reporting rates for the client: EXTFRAME starts with the rate (frames per second) as a
+    /// 16-bit word, and the rest is ignored (see "Reporting rates" in the README)
+    static constexpr uint16_t SelectRateCommand = 0x08;
+
+    /// STAT word of a reported station, and the bits added to it when the station is missing from
+    /// an instant (bits 15-14: PMU error, values not to be used)
+    static constexpr uint16_t StationStat = 2048;
+    static constexpr uint16_t MissingStationStatBits = 0xC000;
+
+    /// Maximum number of simultaneously connected clients
+    static constexpr int MaxClients = 32;
+
+    /// Maximum number of UDP receivers of a data frame (configured destinations and UDP clients)
+    static constexpr int MaxUdpDestinations = 64;
+
+    /// Frames are handed to a TCP socket only while it has fewer unsent bytes than this; the rest
+    /// wait in the client's bounded send queue
+    static constexpr qint64 SocketWatermarkBytes = 4096;
+
+    /// Per-client command state
+    struct Client
+    {
+        /// Connection of a TCP client; null for a client that sends its commands over UDP
+        QTcpSocket *socket = nullptr;
+
+        /// Address of a UDP client
+        QHostAddress address = {};
+        quint16 port = 0;
+
+        /// Whether the client has enabled data output (command 0x02)
+        bool dataEnabled = false;
+
+        /// Last command received from the client
+        uint16_t lastCommand = 0;
+
+        /// When a UDP client last sent a datagram (in microseconds since epoch)
+        int64_t lastHeardUsec = 0;
+
+        /// Reporting rate of the data frames and CONFIG frames sent to the client
+        uint16_t reportingRate = 0;
+
+        /// Outbound frames of a TCP client that the socket has not taken yet
+        qpmu::SendQueue queue = {};
+
+        /// Inbound bytes, until they form complete command frames
+        qpmu::FrameAssembler assembler = {};
+    };
+
     PhasorServer();
 
     ~PhasorServer()
     {
-        if (m_client)
-            delete m_client;
-        if (m_station)
-            delete m_station;
+        for (auto client : m_clients) {
+            delete client->socket;
+            delete client;
+        }
+        qDeleteAll(m_stations);
         if (m_config2)
             delete m_config2;
         if (m_config1)
@@ -44,8 +105,6 @@ public:
             delete m_dataframe;
         if (m_header)
             delete m_header;
-        if (m_cmd)
-            std::free(m_cmd); // Because it is allocated with `malloc` in `CMD_Frame::unpack`
     }
 
     static QString stateFlagName(StateFlag flag)
@@ -79,27 +138,157 @@ public:
         return m_state;
     }
 
+    int countClients()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_countClients;
+    }
+
+    qpmu::DispatchLatency dispatchLatency()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_dispatchLatency;
+    }
+
+    /// Send queue counters, summed (or, for the age, maximized) over all clients. The age is the
+    /// largest since the previous call, which starts a new interval.
+    qpmu::SendQueue::Stats sendQueueStats()
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto stats = m_sendQueueStats;
+        m_sendQueueStats.maxAgeUsec = 0;
+        return stats;
+    }
+
+public slots:
+    /// Takes a station's estimation for a reporting instant; the data frame goes out once it holds
+    /// every station
+    void sendData(int station, const qpmu::ReportingInstant &instant,
+                  const qpmu::Estimation &estimation);
+
+    /// Re-reads the names and ID codes of the stations from the settings. A station that changed
+    /// gets a new CFGCNT, so that clients know to fetch the configuration again. The number of
+    /// stations and the stream ID code only change on restart.
+    void reloadStationSettings();
+
 private slots:
     void handleClientConnection();
-    void disconnectClient();
-    void handleCommand();
-    void sendData();
+    void handleDatagrams();
+
+private:
+    struct UdpDestination
+    {
+        QHostAddress address = {};
+        quint16 port = 0;
+    };
+
+    void sendAggregate(const qpmu::StationAggregator::Aggregate &aggregate);
+
+    /// STAT word of a station present in an instant, with the bits of the input health flags
+    /// selected by the reporting settings
+    uint16_t stationStat(uint32_t inputFlags) const
+    {
+        return StationStat
+                | qpmu::inputHealthStatBits(inputFlags & m_reportingSettings.statInputFlags);
+    }
+    void disconnectClient(Client *client);
+    void handleCommand(Client *client);
+
+    /// Handles every complete frame in the client's assembler. Returns false if the client was
+    /// disconnected meanwhile.
+    bool dispatchFrames(Client *client);
+    bool processCommand(Client *client, const uint8_t *frame, size_t size);
+    /// Sends a reply to a command. Returns false if the client was disconnected meanwhile.
+    bool writeFrame(Client *client, const char *data, qint64 size);
+
+    /// Queues a frame for a TCP client and sends what the socket can take. Returns `Refused` if
+    /// the client was disconnected because its queue was full, and `Dropped` if the frame was
+    /// discarded instead. A `reply` to a command goes ahead of the data frames, and is not
+    /// dropped for them (see `SendQueue::pushReply`).
+    qpmu::SendQueue::PushResult enqueueFrame(Client *client, const char *data, qint64 size,
+                                             bool reply = false);
+    void flushQueue(Client *client);
+    void updateSendQueueStats();
+
+    /// Marks the cached HEADER/CONFIG frames stale; call after changing the station, its
+    /// channels or its CFGCNT
+    void invalidateConfigFrames();
+
+    /// The packed frame for command 0x03 (header), 0x04 (CONFIG-1) or 0x05 (CONFIG-2) at a
+    /// reporting rate, repacked only if the configuration changed since it was last packed
+    const QByteArray &configFrame(uint16_t command, uint16_t reportingRate);
+
+    /// Sends the frame to every UDP receiver of the reporting rate; returns true if all of them
+    /// accepted it
+    bool sendDatagrams(const char *data, qint64 size, uint16_t reportingRate);
+
+    /// Forgets the UDP clients that sent nothing within the client timeout
+    void expireUdpClients();
 
 private:
     QMutex m_mutex;
 
     NetworkSettings m_settings = {};
-    QTcpSocket *m_client = nullptr;
-    QTimer *m_timer = nullptr;
-    bool m_sendDataFlag = false;
+    ReportingSettings m_reportingSettings = {};
+    StationSettings m_stationSettings = {};
+    QList<Client *> m_clients = {};
+    int m_countClients = 0;
+
+    /// UDP output (with `NetworkSettings::UdpSocket`)
+    QUdpSocket *m_udpSocket = nullptr;
+    QVector<UdpDestination> m_udpDestinations = {};
+    QVector<UdpDestination> m_udpTargets = {};
+
+    /// Address family of the bound UDP socket: `AF_INET`, or `AF_INET6` for an IPv6 or
+    /// dual-stack socket; 0 if unknown
+    int m_udpFamily = 0;
+
     int m_state = 0;
+    qpmu::DispatchLatency m_dispatchLatency = {};
+    qpmu::SendQueue::Stats m_sendQueueStats = {};
+
+    /// Dropped frames of clients that have since disconnected
+    uint64_t m_droppedFramesOfGone = 0;
+
+    struct
+    {
+        qpmu::Gauge *clients = nullptr;
+        qpmu::Counter *framesSent = nullptr;
+        qpmu::Counter *bytesSent = nullptr;
+        qpmu::Counter *framesDropped = nullptr;
+        qpmu::Gauge *queuedBytes = nullptr;
+        qpmu::Gauge *queuedFrames = nullptr;
+        qpmu::Counter *incompleteInstants = nullptr;
+        qpmu::Histogram *dispatchLatency = nullptr;
+        qpmu::LatencyHistogram *ageAtDequeue = nullptr;
+        qpmu::LatencyHistogram *ageAtEstimate = nullptr;
+        qpmu::LatencyHistogram *ageAtPack = nullptr;
+        qpmu::LatencyHistogram *ageAtWrite = nullptr;
+    } m_metrics = {};
+
+    QList<PMU_Station *> m_stations = {};
 
-    PMU_Station *m_station = nullptr;
+    /// Per reporting rate, the stations' estimations waiting for the rest of their instant
+    QMap<uint16_t, qpmu::StationAggregator> m_aggregators = {};
     CONFIG_Frame *m_config2 = nullptr;
     CONFIG_1_Frame *m_config1 = nullptr;
     DATA_Frame *m_dataframe = nullptr;
     HEADER_Frame *m_header = nullptr;
-    CMD_Frame *m_cmd = nullptr;
+
+    /// Serializes data frames in place into a preallocated buffer
+    qpmu::DataFrameWriter m_frameWriter = {};
+
+    /// Packed HEADER, CONFIG-1 and CONFIG-2 frames of one reporting rate
+    struct ConfigFrames
+    {
+        QByteArray header = {};
+        QByteArray config1 = {};
+        QByteArray config2 = {};
+    };
+
+    /// Packed frames by reporting rate, and the CFGCNT of each station they were packed with
+    QMap<uint16_t, ConfigFrames> m_configFrames = {};
+    QVector<uint16_t> m_configFramesCfgCnts = {};
 };
 
 #endif // QPMU_APP_PHASOR_SENDER_H
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <QFileInfo>
 #include <QHostAddress>
 
+#include <utility>
+
 #define QSL QStringLiteral
 
 using namespace qpmu;
@@ -35,6 +37,33 @@ QStringList parsePrcoessString(const QString &processString)
     return tokens;
 }
 
+bool parseHostPort(const QString &hostPort, QHostAddress &host, quint16 &port)
+{
+    auto separator = hostPort.lastIndexOf(':');
+    if (separator <= 0) {
+        return false;
+    }
+    host = QHostAddress(hostPort.left(separator).trimmed());
+    bool ok;
+    port = hostPort.mid(separator + 1).trimmed().toUShort(&ok);
+    return ok && !host.isNull();
+}
+
+QString sendQueuePolicyName(SendQueue::Policy policy)
+{
+    switch (policy) {
+    case SendQueue::DropNewest:
+        return QSL("drop-newest");
+    case SendQueue::Disconnect:
+        return QSL("disconnect");
+    case SendQueue::DropOldest:
+    default:
+        return QSL("drop-oldest");
+    }
+}
+
+// --------------------------------------------------------
+
 void NetworkSettings::load(QSettings settings)
 {
     settings.beginGroup(QSL("network"));
@@ -55,6 +84,30 @@ void NetworkSettings::load(QSettings settings)
         }
     }
 
+    udpConfig.destinations.clear();
+    for (const auto &destination : settings.value(QSL("udp_destinations")).toStringList()) {
+        if (!destination.trimmed().isEmpty()) {
+            udpConfig.destinations.append(destination.trimmed());
+        }
+    }
+    udpConfig.tcpCommandChannel = settings.value(QSL("udp_tcp_commands"), true).toBool();
+    udpConfig.multicastTtl = settings.value(QSL("udp_multicast_ttl"), 1).toInt();
+    udpConfig.clientTimeoutSec = settings.value(QSL("udp_client_timeout"), 60).toInt();
+
+    sendQueueConfig.capacityFrames = settings.value(QSL("send_queue_frames"), 25).toInt();
+    auto policyString = settings.value(QSL("send_queue_policy")).toString();
+    sendQueueConfig.policy = SendQueue::DropOldest;
+    for (auto policy : { SendQueue::DropOldest, SendQueue::DropNewest, SendQueue::Disconnect }) {
+        if (policyString == sendQueuePolicyName(policy)) {
+            sendQueueConfig.policy = policy;
+        }
+    }
+
+    metricsEndpoint = settings.value(QSL("metrics_endpoint"), QSL("127.0.0.1:9712")).toString();
+    estimationShm = settings.value(QSL("estimation_shm"), QString()).toString();
+    feedConfig.destination = settings.value(QSL("feed_destination"), QString()).toString();
+    feedConfig.rate = settings.value(QSL("feed_rate"), 0).toInt();
+
     settings.endGroup();
 }
 
@@ -71,6 +124,16 @@ bool NetworkSettings::save() const
                               .arg((socketConfig.socketType == TcpSocket) ? QSL("tcp") : QSL("udp"))
                               .arg(socketConfig.host)
                               .arg(socketConfig.port));
+    settings.setValue(QSL("udp_destinations"), udpConfig.destinations);
+    settings.setValue(QSL("udp_tcp_commands"), udpConfig.tcpCommandChannel);
+    settings.setValue(QSL("udp_multicast_ttl"), udpConfig.multicastTtl);
+    settings.setValue(QSL("udp_client_timeout"), udpConfig.clientTimeoutSec);
+    settings.setValue(QSL("send_queue_frames"), sendQueueConfig.capacityFrames);
+    settings.setValue(QSL("send_queue_policy"), sendQueuePolicyName(sendQueueConfig.policy));
+    settings.setValue(QSL("metrics_endpoint"), metricsEndpoint);
+    settings.setValue(QSL("estimation_shm"), estimationShm);
+    settings.setValue(QSL("feed_destination"), feedConfig.destination);
+    settings.setValue(QSL("feed_rate"), feedConfig.rate);
 
     settings.endGroup();
     return true;
@@ -81,6 +144,298 @@ QString NetworkSettings::validate() const
     if (QHostAddress(socketConfig.host).isNull()) {
         return "Invalid host address";
     }
+    for (const auto &destination : udpConfig.destinations) {
+        QHostAddress host;
+        quint16 port;
+        if (!parseHostPort(destination, host, port)) {
+            return QSL("Invalid UDP destination: %1").arg(destination);
+        }
+    }
+    if (udpConfig.multicastTtl < 0 || udpConfig.multicastTtl > 255) {
+        return "Invalid multicast TTL";
+    }
+    if (udpConfig.clientTimeoutSec < 0) {
+        return "Invalid UDP client timeout";
+    }
+    if (sendQueueConfig.capacityFrames < 1) {
+        return "Invalid send queue capacity";
+    }
+    if (!metricsEndpoint.isEmpty()) {
+        QHostAddress host;
+        quint16 port;
+        if (!parseHostPort(metricsEndpoint, host, port)) {
+            return QSL("Invalid metrics endpoint: %1").arg(metricsEndpoint);
+        }
+    }
+    if (!estimationShm.isEmpty()
+        && (!estimationShm.startsWith('/') || estimationShm.indexOf('/', 1) >= 0)) {
+        return QSL("Invalid estimation ring name (must be /NAME): %1").arg(estimationShm);
+    }
+    if (!feedConfig.destination.isEmpty()) {
+        QHostAddress host;
+        quint16 port;
+        if (!parseHostPort(feedConfig.destination, host, port)
+            || host.protocol() != QAbstractSocket::IPv4Protocol) {
+            return QSL("Invalid feed destination: %1").arg(feedConfig.destination);
+        }
+    }
+    if (feedConfig.rate < 0 || feedConfig.rate > (int)qpmu::TimeDenom) {
+        return "Invalid feed rate";
+    }
+    return "";
+}
+
+// --------------------------------------------------------
+
+void StationSettings::load(QSettings settings)
+{
+    settings.beginGroup(QSL("stations"));
+
+    streamIdCode = settings.value(QSL("stream_idcode"), 17).toUInt();
+
+    stations.clear();
+    auto count = settings.beginReadArray(QSL("station"));
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        Station station;
+        station.name = settings.value(QSL("name"), QSL("PMU %1").arg(i + 1)).toString();
+        station.idCode = settings.value(QSL("idcode"), streamIdCode + i).toUInt();
+        station.input = settings.value(QSL("input")).toString();
+        station.cpu = settings.value(QSL("cpu"), -1).toInt();
+        stations.append(station);
+    }
+    settings.endArray();
+    if (stations.isEmpty()) {
+        stations = { Station() };
+        stations.first().idCode = streamIdCode;
+    }
+
+    settings.endGroup();
+}
+
+bool StationSettings::save() const
+{
+    if (!validate().isEmpty()) {
+        return false;
+    }
+    QSettings settings;
+    settings.beginGroup(QSL("stations"));
+
+    settings.setValue(QSL("stream_idcode"), streamIdCode);
+    settings.beginWriteArray(QSL("station"), stations.size());
+    for (int i = 0; i < stations.size(); ++i) {
+        settings.setArrayIndex(i);
+        settings.setValue(QSL("name"), stations[i].name);
+        settings.setValue(QSL("idcode"), stations[i].idCode);
+        settings.setValue(QSL("input"), stations[i].input);
+        settings.setValue(QSL("cpu"), stations[i].cpu);
+    }
+    settings.endArray();
+
+    settings.endGroup();
+    return true;
+}
+
+QString StationSettings::validate() const
+{
+    if (stations.isEmpty() || stations.size() > MaxStations) {
+        return QSL("Between 1 and %1 stations are supported").arg(MaxStations);
+    }
+    for (int i = 0; i < stations.size(); ++i) {
+        const auto &station = stations[i];
+        if (station.name.isEmpty() || station.name.size() > 16) {
+            return QSL("Invalid name of station %1").arg(i + 1);
+        }
+        for (int j = 0; j < i; ++j) {
+            if (stations[j].idCode == station.idCode) {
+                return QSL("Duplicate station IDCODE: %1").arg(station.idCode);
+            }
+        }
+        if (i > 0 && station.input.isEmpty()) {
+            return QSL("No input for station %1").arg(station.name);
+        }
+    }
+    return "";
+}
+
+// --------------------------------------------------------
+
+/// Names of the input health flags in the `reporting/stat_flags` list
+static const std::pair<uint32_t, const char *> InputFlagNames[] = {
+    { SampleGapFlag, "gap" },
+    { DuplicateSampleFlag, "duplicate" },
+    { TimingJitterFlag, "jitter" },
+    { RateDriftFlag, "drift" },
+};
+
+void ReportingSettings::load(QSettings settings)
+{
+    settings.beginGroup(QSL("reporting"));
+
+    rates.clear();
+    for (const auto &rate : settings.value(QSL("rates")).toStringList()) {
+        bool ok;
+        auto value = rate.trimmed().toInt(&ok);
+        if (ok && !rates.contains(value)) {
+            rates.append(value);
+        }
+    }
+    if (rates.isEmpty()) {
+        rates = { 50 };
+    }
+
+    filterClass = (settings.value(QSL("class")).toString() == QSL("M")) ? MeasurementClass
+                                                                         : ProtectionClass;
+
+    if (settings.contains(QSL("stat_flags"))) {
+        statInputFlags = 0;
+        for (const auto &name : settings.value(QSL("stat_flags")).toStringList()) {
+            for (const auto &[flag, flagName] : InputFlagNames) {
+                if (name.trimmed() == QLatin1String(flagName)) {
+                    statInputFlags |= flag;
+                }
+            }
+        }
+    } else {
+        statInputFlags = ReportingSettings().statInputFlags;
+    }
+
+    settings.endGroup();
+}
+
+bool ReportingSettings::save() const
+{
+    if (!validate().isEmpty()) {
+        return false;
+    }
+    QSettings settings;
+    settings.beginGroup(QSL("reporting"));
+
+    QStringList rateStrings;
+    for (auto rate : rates) {
+        rateStrings << QString::number(rate);
+    }
+    settings.setValue(QSL("rates"), rateStrings);
+    settings.setValue(QSL("class"), (filterClass == MeasurementClass) ? QSL("M") : QSL("P"));
+
+    QStringList flagNames;
+    for (const auto &[flag, flagName] : InputFlagNames) {
+        if (statInputFlags & flag) {
+            flagNames << QLatin1String(flagName);
+        }
+    }
+    settings.setValue(QSL("stat_flags"), flagNames);
+
+    settings.endGroup();
+    return true;
+}
+
+QString ReportingSettings::validate() const
+{
+    if (rates.isEmpty()) {
+        return "No reporting rate";
+    }
+    for (auto rate : rates) {
+        /// Rates that divide the 1200 Hz sampling rate evenly, up to two reports per cycle
+        if (rate < 1 || rate > 100 || 1200 % rate != 0) {
+            return QSL("Invalid reporting rate: %1").arg(rate);
+        }
+    }
+    return "";
+}
+
+// --------------------------------------------------------
+
+void ArchiveSettings::load(QSettings settings)
+{
+    settings.beginGroup(QSL("archive"));
+    directory = settings.value(QSL("directory"), QSL("")).toString();
+    rate = settings.value(QSL("rate"), 50).toInt();
+    chunkSeconds = settings.value(QSL("chunk_seconds"), 60).toInt();
+    retentionDays = settings.value(QSL("retention_days"), 30).toInt();
+    settings.endGroup();
+}
+
+bool ArchiveSettings::save() const
+{
+    if (!validate().isEmpty()) {
+        return false;
+    }
+    QSettings settings;
+    settings.beginGroup(QSL("archive"));
+    settings.setValue(QSL("directory"), directory);
+    settings.setValue(QSL("rate"), rate);
+    settings.setValue(QSL("chunk_seconds"), chunkSeconds);
+    settings.setValue(QSL("retention_days"), retentionDays);
+    settings.endGroup();
+    return true;
+}
+
+QString ArchiveSettings::validate() const
+{
+    if (rate < 1 || rate > 100 || 1200 % rate != 0) {
+        return QSL("Invalid archive rate: %1").arg(rate);
+    }
+    if (chunkSeconds < 1 || chunkSeconds > 3600) {
+        return QSL("Invalid archive chunk length: %1 s").arg(chunkSeconds);
+    }
+    if (retentionDays < 0) {
+        return QSL("Invalid archive retention: %1 days").arg(retentionDays);
+    }
+    return "";
+}
+
+// --------------------------------------------------------
+
+void RecorderSettings::load(QSettings settings)
+{
+    settings.beginGroup(QSL("recorder"));
+    directory = settings.value(QSL("directory"), QSL("")).toString();
+    bufferSeconds = settings.value(QSL("buffer_seconds"), 60.0).toDouble();
+    preTriggerSeconds = settings.value(QSL("pre_trigger_seconds"), 1.0).toDouble();
+    postTriggerSeconds = settings.value(QSL("post_trigger_seconds"), 2.0).toDouble();
+    magnitudeStep = settings.value(QSL("magnitude_step"), 0.2).toDouble();
+    frequencyDeviation = settings.value(QSL("frequency_deviation"), 0.5).toDouble();
+    settings.endGroup();
+}
+
+bool RecorderSettings::save() const
+{
+    if (!validate().isEmpty()) {
+        return false;
+    }
+    QSettings settings;
+    settings.beginGroup(QSL("recorder"));
+    settings.setValue(QSL("directory"), directory);
+    settings.setValue(QSL("buffer_seconds"), bufferSeconds);
+    settings.setValue(QSL("pre_trigger_seconds"), preTriggerSeconds);
+    settings.setValue(QSL("post_trigger_seconds"), postTriggerSeconds);
+    settings.setValue(QSL("magnitude_step"), magnitudeStep);
+    settings.setValue(QSL("frequency_deviation"), frequencyDeviation);
+    settings.endGroup();
+    return true;
+}
+
+QString RecorderSettings::validate() const
+{
+    if (bufferSeconds < 1 || bufferSeconds > 600) {
+        return QSL("Invalid recorder buffer length: %1 s").arg(bufferSeconds);
+    }
+    /// The writer copies a capture out of the ring after its post-trigger samples are in
+    if (preTriggerSeconds < 0 || postTriggerSeconds < 0
+        || preTriggerSeconds + postTriggerSeconds > bufferSeconds / 2) {
+        return QSL("Invalid recorder capture: %1 s before and %2 s after the trigger, for a "
+                   "buffer of %3 s (at most half of it)")
+                .arg(preTriggerSeconds)
+                .arg(postTriggerSeconds)
+                .arg(bufferSeconds);
+    }
+    if (magnitudeStep < 0) {
+        return QSL("Invalid recorder magnitude step: %1").arg(magnitudeStep);
+    }
+    if (frequencyDeviation < 0) {
+        return QSL("Invalid recorder frequency deviation: %1 Hz").arg(frequencyDeviation);
+    }
     return "";
 }
 
@@ -126,6 +481,8 @@ bool CalibrationSettings::save() const
 
 // --------------------------------------------------------
 
+#ifdef QT_GUI_LIB
+
 void VisualisationSettings::load(QSettings settings)
 {
     settings.beginGroup(QSL("visualisation"));
@@ -164,4 +521,6 @@ bool VisualisationSettings::save() const
     return true;
 }
 
+#endif // QT_GUI_LIB
+
 #undef QSL
\ No newline at end of file
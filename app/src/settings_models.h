@@ -2,16 +2,24 @@
 #define QPMU_APP_SETTINGS_MODELS_H
 
 #include "qpmu/defs.h"
-#include "app.h"
+#include "qpmu/decimator.h"
+#include "qpmu/input_monitor.h"
+#include "qpmu/send_queue.h"
 
 #include <QSettings>
 #include <QtGlobal>
 #include <QString>
+#include <QStringList>
+#include <QHostAddress>
 #include <QVector>
+#include <QList>
 #include <QPointF>
-#include <QColor>
 #include <QtGlobal>
 
+#ifdef QT_GUI_LIB
+#  include <QColor>
+#endif
+
 #include <array>
 #include <type_traits>
 
@@ -56,7 +64,53 @@ struct NetworkSettings : public AbstractSettingsModel
         QStringList args = {};
     };
 
+    /// UDP output: data frames are sent as datagrams instead of over the TCP connections
+    struct UdpConfig
+    {
+        /// Fixed receivers of data frames, as "host:port"; the host may be a multicast group
+        QStringList destinations = {};
+
+        /// Whether to also accept commands over TCP on the same host and port. With it, data flows
+        /// to the destinations only while a TCP client has enabled data output; without it, the
+        /// destinations receive data spontaneously.
+        bool tcpCommandChannel = true;
+
+        /// Time-to-live of multicast datagrams
+        int multicastTtl = 1;
+
+        /// Seconds after its last command that a client commanding over UDP is forgotten and
+        /// stops receiving data; 0 to keep such clients forever
+        int clientTimeoutSec = 60;
+    };
+
+    /// Bounded outbound queue of each TCP client
+    struct SendQueueConfig
+    {
+        int capacityFrames = 25;
+        qpmu::SendQueue::Policy policy = qpmu::SendQueue::DropOldest;
+    };
+
+    /// Internal estimation feed (see `qpmu::EstimationFeed`), apart from C37.118
+    struct FeedConfig
+    {
+        /// Receivers of the packets, as "host:port", e.g. a multicast group; empty to disable it
+        QString destination = "";
+
+        /// Packets per second of each station; 0 for every estimation (the sampling rate)
+        int rate = 0;
+    };
+
+    /// HTTP endpoint serving the metrics, as "host:port"; empty to disable it
+    QString metricsEndpoint = "127.0.0.1:9712";
+
+    /// Name prefix of the shared-memory rings of every estimation, e.g. "/qpmu-estimations"; each
+    /// station publishes to "<prefix>-<ID code>". Empty to disable them.
+    QString estimationShm = "";
+
     SocketConfig socketConfig = {};
+    UdpConfig udpConfig = {};
+    SendQueueConfig sendQueueConfig = {};
+    FeedConfig feedConfig = {};
 
     void load(QSettings settings = QSettings()) override;
     bool save() const override;
@@ -66,7 +120,17 @@ struct NetworkSettings : public AbstractSettingsModel
     {
         return socketConfig.socketType == other.socketConfig.socketType
                 && socketConfig.host == other.socketConfig.host
-                && socketConfig.port == other.socketConfig.port;
+                && socketConfig.port == other.socketConfig.port
+                && udpConfig.destinations == other.udpConfig.destinations
+                && udpConfig.tcpCommandChannel == other.udpConfig.tcpCommandChannel
+                && udpConfig.multicastTtl == other.udpConfig.multicastTtl
+                && udpConfig.clientTimeoutSec == other.udpConfig.clientTimeoutSec
+                && sendQueueConfig.capacityFrames == other.sendQueueConfig.capacityFrames
+                && sendQueueConfig.policy == other.sendQueueConfig.policy
+                && metricsEndpoint == other.metricsEndpoint
+                && estimationShm == other.estimationShm
+                && feedConfig.destination == other.feedConfig.destination
+                && feedConfig.rate == other.feedConfig.rate;
     }
 
     bool operator!=(const NetworkSettings &other) const { return !(*this == other); }
@@ -74,6 +138,139 @@ struct NetworkSettings : public AbstractSettingsModel
 
 STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(NetworkSettings)
 
+/// PMU stations published by this process; each has its own acquisition pipeline, and all of
+/// them are sent together in one data frame
+struct StationSettings : public AbstractSettingsModel
+{
+    /// Upper bound on the number of stations
+    static constexpr int MaxStations = 8;
+
+    struct Station
+    {
+        /// Station name (STN), at most 16 characters
+        QString name = "PMU 1";
+        quint16 idCode = 17;
+
+        /// Binary sample stream to read; empty for the first station means stdin or `ADC_STREAM`
+        QString input = "";
+
+        /// CPU core the station's pipeline is pinned to; -1 leaves it to the scheduler
+        int cpu = -1;
+
+        bool operator==(const Station &other) const
+        {
+            return name == other.name && idCode == other.idCode && input == other.input
+                    && cpu == other.cpu;
+        }
+    };
+
+    /// IDCODE of the data stream, i.e., of the frames that carry all the stations
+    quint16 streamIdCode = 17;
+
+    QList<Station> stations = { Station() };
+
+    void load(QSettings settings = QSettings()) override;
+    bool save() const override;
+    QString validate() const override;
+
+    bool operator==(const StationSettings &other) const
+    {
+        return streamIdCode == other.streamIdCode && stations == other.stations;
+    }
+
+    bool operator!=(const StationSettings &other) const { return !(*this == other); }
+};
+STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(StationSettings)
+
+struct ReportingSettings : public AbstractSettingsModel
+{
+    /// Reporting rates (frames per second) offered to clients; the first one is the default, and
+    /// the one announced to clients that do not choose a rate with `SelectRateCommand`
+    QList<int> rates = { 50 };
+
+    /// Class of the anti-alias filter applied before decimating to each rate
+    qpmu::FilterClass filterClass = qpmu::ProtectionClass;
+
+    /// Input health flags (`qpmu::InputHealthFlag`) that mark the reported data in the STAT word;
+    /// the other ones only show in the metrics
+    uint32_t statInputFlags = qpmu::SampleGapFlag | qpmu::DuplicateSampleFlag;
+
+    void load(QSettings settings = QSettings()) override;
+    bool save() const override;
+    QString validate() const override;
+
+    uint16_t primaryRate() const { return rates.isEmpty() ? 50 : (uint16_t)rates.first(); }
+
+    bool operator==(const ReportingSettings &other) const
+    {
+        return rates == other.rates && filterClass == other.filterClass
+                && statInputFlags == other.statInputFlags;
+    }
+
+    bool operator!=(const ReportingSettings &other) const { return !(*this == other); }
+};
+STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(ReportingSettings)
+
+struct ArchiveSettings : public AbstractSettingsModel
+{
+    /// Directory of the phasor archive; empty to disable archiving
+    QString directory = "";
+
+    /// Estimations archived per second, filtered like a reporting rate
+    int rate = 50;
+
+    /// Seconds of estimations per chunk, i.e., at most lost on a power cut
+    int chunkSeconds = 60;
+
+    /// Days of archive kept; 0 to keep everything
+    int retentionDays = 30;
+
+    void load(QSettings settings = QSettings()) override;
+    bool save() const override;
+    QString validate() const override;
+
+    bool operator==(const ArchiveSettings &other) const
+    {
+        return directory == other.directory && rate == other.rate
+                && chunkSeconds == other.chunkSeconds && retentionDays == other.retentionDays;
+    }
+
+    bool operator!=(const ArchiveSettings &other) const { return !(*this == other); }
+};
+STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(ArchiveSettings)
+
+struct RecorderSettings : public AbstractSettingsModel
+{
+    /// Directory of the flight recorder's COMTRADE files; empty to disable the recorder
+    QString directory = "";
+
+    /// Seconds of raw samples kept, and captured before and after a trigger
+    double bufferSeconds = 60;
+    double preTriggerSeconds = 1;
+    double postTriggerSeconds = 2;
+
+    /// Triggers: a change of a magnitude by this fraction of its recent average, and a voltage
+    /// frequency off nominal by this many Hz; 0 disables either
+    double magnitudeStep = 0.2;
+    double frequencyDeviation = 0.5;
+
+    void load(QSettings settings = QSettings()) override;
+    bool save() const override;
+    QString validate() const override;
+
+    bool operator==(const RecorderSettings &other) const
+    {
+        return directory == other.directory && bufferSeconds == other.bufferSeconds
+                && preTriggerSeconds == other.preTriggerSeconds
+                && postTriggerSeconds == other.postTriggerSeconds
+                && magnitudeStep == other.magnitudeStep
+                && frequencyDeviation == other.frequencyDeviation;
+    }
+
+    bool operator!=(const RecorderSettings &other) const { return !(*this == other); }
+};
+STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(RecorderSettings)
+
 struct CalibrationSettings : public AbstractSettingsModel
 {
     static constexpr quint32 MaxPoints = 10;
@@ -107,6 +304,8 @@ struct CalibrationSettings : public AbstractSettingsModel
 };
 STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(CalibrationSettings)
 
+/// Only with Qt Gui, i.e., not in the headless daemon
+#ifdef QT_GUI_LIB
 struct VisualisationSettings : public AbstractSettingsModel
 {
 
@@ -125,7 +324,14 @@ struct VisualisationSettings : public AbstractSettingsModel
     bool operator!=(const VisualisationSettings &other) const { return !(*this == other); }
 };
 STATIC_ASSERT_SETTINGS_MODEL_CONCEPTS(VisualisationSettings)
+#endif // QT_GUI_LIB
 
 QStringList parsePrcoessString(const QString &processString);
 
+/// Parses a "host:port" string; returns false if either part is invalid
+bool parseHostPort(const QString &hostPort, QHostAddress &host, quint16 &port);
+
+/// Name of a send queue policy as stored in the settings file
+QString sendQueuePolicyName(qpmu::SendQueue::Policy policy);
+
 #endif // QPMU_APP_SETTINGS_MODELS_H
\ No newline at end of file
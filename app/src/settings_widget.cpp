@@ -74,6 +74,8 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
     auto tcpRadio = new QRadioButton();
     auto hostEdit = new QLineEdit();
     auto portEdit = new QLineEdit();
+    auto udpDestinationsEdit = new QLineEdit();
+    auto tcpCommandsCheck = new QCheckBox();
 
     auto dialogButtonBox = new QDialogButtonBox();
     auto updateConnectionButton = dialogButtonBox->addButton(QDialogButtonBox::Apply);
@@ -90,6 +92,19 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
         newSettings.socketConfig.port = portEdit->text().toInt();
         newSettings.socketConfig.socketType =
                 (NetworkSettings::SocketType)socketTypeGroup->checkedId();
+        newSettings.udpConfig.destinations.clear();
+        for (const auto &destination : udpDestinationsEdit->text().split(',')) {
+            if (!destination.trimmed().isEmpty()) {
+                newSettings.udpConfig.destinations.append(destination.trimmed());
+            }
+        }
+        newSettings.udpConfig.tcpCommandChannel = tcpCommandsCheck->isChecked();
+        /// Not editable on this page
+        newSettings.udpConfig.multicastTtl = settings.udpConfig.multicastTtl;
+        newSettings.udpConfig.clientTimeoutSec = settings.udpConfig.clientTimeoutSec;
+        newSettings.sendQueueConfig = settings.sendQueueConfig;
+        newSettings.estimationShm = settings.estimationShm;
+        newSettings.feedConfig = settings.feedConfig;
         return newSettings;
     };
 
@@ -100,6 +115,8 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
         hostEdit->setText(settings.socketConfig.host);
         portEdit->setText(QString::number(settings.socketConfig.port));
         socketTypeGroup->button(settings.socketConfig.socketType)->setChecked(true);
+        udpDestinationsEdit->setText(settings.udpConfig.destinations.join(", "));
+        tcpCommandsCheck->setChecked(settings.udpConfig.tcpCommandChannel);
     };
 
     /// * Check if settings are changed
@@ -135,6 +152,8 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
         socketConfigForm->addRow("Host IP", hostEdit);
         socketConfigForm->addRow("Port", portEdit);
         socketConfigForm->addRow("Socket type", socketTypeLayout);
+        socketConfigForm->addRow("UDP destinations", udpDestinationsEdit);
+        socketConfigForm->addRow("UDP commands over TCP", tcpCommandsCheck);
 
         { /// Host edit
             auto ipPattern = QString("^(%1\\.%1\\.%1\\.%1)|localhost$")
@@ -166,14 +185,34 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
             socketTypeGroup->addButton(udpRadio, NetworkSettings::UdpSocket);
             socketTypeGroup->button(settings.socketConfig.socketType)->setChecked(true);
         }
+
+        { /// UDP output
+            udpDestinationsEdit->setPlaceholderText("host:port, 239.1.1.1:4713, ...");
+            udpDestinationsEdit->setText(settings.udpConfig.destinations.join(", "));
+            tcpCommandsCheck->setChecked(settings.udpConfig.tcpCommandChannel);
+            auto updateUdpEnabled = [=] {
+                bool udp = socketTypeGroup->checkedId() == NetworkSettings::UdpSocket;
+                udpDestinationsEdit->setEnabled(udp);
+                tcpCommandsCheck->setEnabled(udp);
+            };
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+            connect(socketTypeGroup, &QButtonGroup::idToggled, updateUdpEnabled);
+#else
+            connect(socketTypeGroup, QOverload<int, bool>::of(&QButtonGroup::buttonToggled),
+                    updateUdpEnabled);
+#endif
+            updateUdpEnabled();
+        }
     }
 
     { /// Initialize
-        for (QObject *obj :
-             { (QObject *)socketTypeGroup, (QObject *)hostEdit, (QObject *)portEdit }) {
+        for (QObject *obj : { (QObject *)socketTypeGroup, (QObject *)hostEdit, (QObject *)portEdit,
+                              (QObject *)udpDestinationsEdit, (QObject *)tcpCommandsCheck }) {
 
             if (auto edit = qobject_cast<QLineEdit *>(obj)) {
                 connect(edit, &QLineEdit::textChanged, updateEnabledState);
+            } else if (auto check = qobject_cast<QCheckBox *>(obj)) {
+                connect(check, &QCheckBox::toggled, updateEnabledState);
             } else if (auto group = qobject_cast<QButtonGroup *>(obj)) {
 #if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
                 connect(group, &QButtonGroup::idToggled, updateEnabledState);
@@ -219,8 +258,8 @@ QWidget *SettingsWidget::networkSettingsPage(const NetworkSettings &settings)
 
 Float sampleMagnitude(size_t signalIndex)
 {
-    const auto &phasors = APP->dataProcessor()->lastEstimation().phasors;
-    return std::abs(phasors[signalIndex]);
+    const auto estimation = APP->dataProcessor()->lastEstimation();
+    return std::abs(estimation.phasors[signalIndex]);
 }
 
 QWidget *SettingsWidget::calibrationWidget(const size_t signalIndex,
@@ -0,0 +1,133 @@
+#ifndef QPMU_ARCHIVE_ARCHIVE_CHUNK_H
+#define QPMU_ARCHIVE_ARCHIVE_CHUNK_H
+
+#include "qpmu/defs.h"
+#include "qpmu/gorilla.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+/// One archived estimation
+struct ArchiveRecord
+{
+    uint16_t station = 0;
+    /// Reporting instant of the estimation (in microseconds since epoch)
+    int64_t timeUsec = 0;
+    Estimation estimation = {};
+};
+
+/// @brief Columns of an archive chunk, after the timestamps: the magnitude, phase angle,
+/// frequency and ROCOF of every signal, then the sampling rate.
+///
+/// Phasors are stored in polar form, whose magnitude barely changes between reports and so
+/// compresses far better than the rotating rectangular parts.
+struct ArchiveColumns
+{
+    static constexpr size_t PerSignal = 4;
+    static constexpr size_t Count = CountSignals * PerSignal + 1;
+
+    static size_t magnitude(size_t signal) { return signal * PerSignal; }
+    static size_t angle(size_t signal) { return signal * PerSignal + 1; }
+    static size_t frequency(size_t signal) { return signal * PerSignal + 2; }
+    static size_t rocof(size_t signal) { return signal * PerSignal + 3; }
+    static constexpr size_t SamplingRate = Count - 1;
+
+    /// Name of a column, e.g., `VA.magnitude`
+    static std::string name(size_t column);
+
+    /// Column of a name, or `Count` if there is none
+    static size_t find(const std::string &name);
+};
+
+/// @brief A chunk of one station's estimations, stored column by column.
+///
+/// Layout (integers little-endian):
+///
+///     magic "QPA2" (4) | station (2) | column count (2) | record count (4)
+///     | first time (8, us since epoch) | last time (8)
+///     | byte size of the time column and of each value column (4 each)
+///     | checksum of the header before it and of the columns (2, CRC-CCITT) | columns
+///
+/// Chunks of the first version, "QPA1", are still read; their checksum covers only the columns.
+///
+/// The time column is delta-of-delta encoded and the value columns XOR encoded (see
+/// `TimestampEncoder` and `FloatEncoder`). A chunk is self-contained, so the chunks of a file
+/// can be read, or skipped by their header, one at a time.
+class ArchiveChunkEncoder
+{
+public:
+    static constexpr uint32_t Magic = 0x32415051; /// "QPA2"
+    static constexpr uint32_t LegacyMagic = 0x31415051; /// "QPA1"
+
+    explicit ArchiveChunkEncoder(uint16_t station = 0);
+
+    /// The encoders point into the bit buffers
+    ArchiveChunkEncoder(const ArchiveChunkEncoder &) = delete;
+    ArchiveChunkEncoder &operator=(const ArchiveChunkEncoder &) = delete;
+
+    void append(int64_t timeUsec, const Estimation &estimation);
+
+    uint16_t station() const { return m_station; }
+    size_t count() const { return m_count; }
+    int64_t firstTimeUsec() const { return m_firstTimeUsec; }
+    int64_t lastTimeUsec() const { return m_lastTimeUsec; }
+
+    /// Size of the chunk if it were finished now
+    size_t size() const;
+
+    /// Appends the complete chunk to `out`, and starts a new one
+    void finish(std::vector<uint8_t> &out);
+
+private:
+    void reset();
+
+    uint16_t m_station = 0;
+    size_t m_count = 0;
+    int64_t m_firstTimeUsec = 0;
+    int64_t m_lastTimeUsec = 0;
+
+    BitWriter m_timeBits = {};
+    TimestampEncoder m_times;
+    std::vector<BitWriter> m_columnBits = {};
+    std::vector<FloatEncoder> m_columns = {};
+};
+
+/// Header of an archive chunk
+struct ArchiveChunkHeader
+{
+    uint16_t station = 0;
+    uint32_t countRecords = 0;
+    int64_t firstTimeUsec = 0;
+    int64_t lastTimeUsec = 0;
+    /// Sizes of the time column and the value columns
+    std::vector<uint32_t> columnSizes = {};
+    uint16_t checksum = 0;
+    /// A "QPA1" chunk, whose checksum does not cover the header
+    bool legacy = false;
+
+    /// Size of the header itself, and of the whole chunk
+    size_t headerSize() const;
+    size_t chunkSize() const;
+};
+
+/// Parses the header of the chunk at `data`. Returns false, with the reason in `error`, if it is
+/// truncated, not a chunk, or has more records than its columns can hold.
+bool readArchiveChunkHeader(const uint8_t *data, size_t size, ArchiveChunkHeader &header,
+                            std::string &error);
+
+/// Checksum of the chunk at `data` with the parsed `header`, to compare with `header.checksum`;
+/// the chunk must be complete
+uint16_t archiveChunkChecksum(const uint8_t *data, const ArchiveChunkHeader &header);
+
+/// Decodes a whole chunk, appending its records to `records`. Returns false, with the reason in
+/// `error`, if it is truncated or corrupt.
+bool decodeArchiveChunk(const uint8_t *data, size_t size, std::vector<ArchiveRecord> &records,
+                        std::string &error);
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_ARCHIVE_CHUNK_H
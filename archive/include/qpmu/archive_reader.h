@@ -0,0 +1,159 @@
+#ifndef QPMU_ARCHIVE_ARCHIVE_READER_H
+#define QPMU_ARCHIVE_ARCHIVE_READER_H
+
+#include "qpmu/archive_chunk.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+/// @brief A memory-mapped archive file, with a sparse index of its chunks.
+///
+/// Opening a file reads only the chunk headers, hopping from one to the next by their sizes, and
+/// indexes each station's chunks by time. A corrupt chunk is skipped by scanning for the magic
+/// of the next chunk whose checksum holds. An incomplete chunk at the end -- being written, or
+/// cut short by a power cut -- is left out until `refresh()` finds the file has grown.
+class ArchiveFile
+{
+public:
+    struct ChunkEntry
+    {
+        size_t offset = 0;
+        ArchiveChunkHeader header = {};
+    };
+
+    ArchiveFile() = default;
+    ~ArchiveFile();
+
+    ArchiveFile(const ArchiveFile &) = delete;
+    ArchiveFile &operator=(const ArchiveFile &) = delete;
+
+    /// Maps and indexes the file. Returns false, with the reason in `error`, if it cannot be
+    /// read; corrupt chunks are not an error, see `indexError()`.
+    bool open(const std::string &path, std::string &error);
+
+    /// Maps the file again if its size changed since it was mapped, and indexes the chunks
+    /// appended since. Returns false, with the reason in `error`, if it cannot be read anymore.
+    bool refresh(std::string &error);
+
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    /// End of the last complete chunk; the bytes after it are an incomplete chunk
+    size_t indexedSize() const { return m_indexedSize; }
+
+    /// Chunks of a station, in time order
+    const std::vector<ChunkEntry> &chunks(uint16_t station) const;
+
+    /// Stations with chunks in the file
+    std::vector<uint16_t> stations() const;
+
+    /// Why the last chunk skipped, or the incomplete one at the end, could not be indexed
+    const std::string &indexError() const { return m_indexError; }
+
+    /// Bytes of corrupt chunks skipped
+    size_t skippedBytes() const { return m_skippedBytes; }
+
+private:
+    bool map(std::string &error);
+    void unmap();
+    void index();
+
+    /// Offset of the first intact chunk at or after `offset`, or the size if there is none
+    size_t findChunk(size_t offset) const;
+
+    void close();
+
+    std::string m_path = {};
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    std::vector<uint8_t> m_contents = {};
+
+    std::map<uint16_t, std::vector<ChunkEntry>> m_chunks = {};
+    size_t m_indexedSize = 0;
+    size_t m_skippedBytes = 0;
+    std::string m_indexError = {};
+};
+
+/// Summary of the values of a column over a time bucket
+struct ArchiveBucket
+{
+    /// Start of the bucket (in microseconds since epoch)
+    int64_t timeUsec = 0;
+    uint64_t count = 0;
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+};
+
+struct ArchiveQuery
+{
+    uint16_t station = 0;
+    /// Columns to decode, as indexes of `ArchiveColumns`
+    std::vector<size_t> columns = {};
+    /// Time range, start inclusive and end exclusive (in microseconds since epoch)
+    int64_t fromUsec = 0;
+    int64_t toUsec = 0;
+    /// Width of the downsampling buckets (in microseconds); 0 for the raw values
+    int64_t bucketUsec = 0;
+    /// Whether to check the chunk checksums, which means reading every column of the chunks
+    bool verifyChecksums = false;
+};
+
+struct ArchiveQueryResult
+{
+    /// Raw values: the timestamps, and the values of each queried column
+    std::vector<int64_t> times = {};
+    std::vector<std::vector<double>> values = {};
+
+    /// Downsampled values: the non-empty buckets of each queried column, aligned to multiples of
+    /// the bucket width
+    std::vector<std::vector<ArchiveBucket>> buckets = {};
+
+    /// Chunks that were decoded, and that failed to decode (and were skipped)
+    size_t chunksRead = 0;
+    size_t chunksFailed = 0;
+};
+
+/// @brief Reads time ranges from the daily files of an archive directory.
+///
+/// Only the files of the days in the range are opened, only the chunks overlapping the range
+/// are decoded (found by binary search on the index), and of those only the time column and the
+/// queried columns. Opened files stay mapped for later queries, and are refreshed before each
+/// one, so that the chunks appended since are found.
+class ArchiveReader
+{
+public:
+    explicit ArchiveReader(const std::string &directory);
+
+    ArchiveQueryResult query(const ArchiveQuery &query);
+
+    /// The mapped file of a day (given by any time in it), refreshed, or null if there is none
+    const ArchiveFile *file(int64_t timeUsec);
+
+    const std::string &directory() const { return m_directory; }
+
+private:
+    void queryChunk(const uint8_t *chunk, const ArchiveChunkHeader &header,
+                    const ArchiveQuery &query, ArchiveQueryResult &result);
+
+    std::string m_directory = {};
+    std::map<std::string, std::unique_ptr<ArchiveFile>> m_files = {};
+};
+
+/// Decodes the records before `untilUsec` of a chunk whose header was read already: their times,
+/// and their values of the given columns only. Returns false if the chunk is corrupt.
+bool decodeArchiveColumns(const uint8_t *chunk, const ArchiveChunkHeader &header,
+                          const std::vector<size_t> &columns, std::vector<int64_t> &times,
+                          std::vector<std::vector<double>> &values,
+                          int64_t untilUsec = INT64_MAX);
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_ARCHIVE_READER_H
@@ -0,0 +1,118 @@
+#ifndef QPMU_ARCHIVE_ARCHIVE_WRITER_H
+#define QPMU_ARCHIVE_ARCHIVE_WRITER_H
+
+#include "qpmu/defs.h"
+#include "qpmu/archive_chunk.h"
+#include "qpmu/metrics.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace qpmu {
+
+struct ArchiveConfig
+{
+    /// Directory of the archive files, one per UTC day: `qpmu-YYYYMMDD.qpa`
+    std::string directory = {};
+
+    /// A station's chunk is written once it holds this many records, or once its records span
+    /// `chunkSeconds`; at most that much is lost on a power cut
+    size_t chunkRecords = 3000;
+    int64_t chunkSeconds = 60;
+
+    /// Files older than this many days are deleted (0: never)
+    int retentionDays = 30;
+
+    /// Records waiting for the writer thread; more are dropped, or with `blockWhenFull`, wait
+    /// for room, as in simulations, whose input outruns the writer
+    size_t queueCapacity = 4096;
+    bool blockWhenFull = false;
+};
+
+/// @brief Archives estimations to chunked, compressed columnar files on a background thread.
+///
+/// `push()` only copies the record into a bounded queue under a short lock, so it can be called
+/// from the acquisition threads. The writer thread wakes up once a second, or when the queue is
+/// half full, encodes the queued records into each station's open chunk (see
+/// `ArchiveChunkEncoder`), and appends the chunks that are complete to the day's file. Values
+/// compress to about 1.5 to 3 bytes each, so a station at 50 frames per second takes a few MB per
+/// hour. Before its first append to a file, the writer drops an incomplete chunk at its end (left
+/// by a power cut), so that the chunks appended after it can be found by their sizes.
+class ArchiveWriter
+{
+public:
+    using ErrorCallback = std::function<void(const std::string &)>;
+
+    /// Creates the directory and starts the writer thread. Errors are passed to the callback,
+    /// which is called on the writer thread after construction.
+    explicit ArchiveWriter(const ArchiveConfig &config, ErrorCallback onError = ErrorCallback());
+
+    /// Flushes the open chunks, and stops the writer thread
+    ~ArchiveWriter();
+
+    ArchiveWriter(const ArchiveWriter &) = delete;
+    ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+    /// Queues an estimation; thread-safe. Returns false if it was dropped because the queue is
+    /// full (never with `blockWhenFull`).
+    bool push(uint16_t station, int64_t timeUsec, const Estimation &estimation);
+
+    /// Writes the queued records and the open chunks, and waits until they are written;
+    /// thread-safe. Call before the process exits.
+    void flush();
+
+    const ArchiveConfig &config() const { return m_config; }
+
+    /// Path of the file holding the records of the UTC day of the given time
+    static std::string filePath(const std::string &directory, int64_t timeUsec);
+
+private:
+    void run();
+    void encode(const std::vector<ArchiveRecord> &records);
+    void writeChunk(ArchiveChunkEncoder &encoder);
+    void dropIncompleteChunk(const std::string &path);
+    void removeExpiredFiles(int64_t nowUsec);
+    void reportError(const std::string &error);
+
+    ArchiveConfig m_config = {};
+    ErrorCallback m_onError = {};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_flushed;
+    std::condition_variable m_drained;
+    std::vector<ArchiveRecord> m_queue = {};
+    bool m_stopRequested = false;
+    uint64_t m_flushRequests = 0;
+    uint64_t m_flushesDone = 0;
+
+    /// Open chunk of each station, and the buffer of the chunks being written; writer thread only
+    std::map<uint16_t, std::unique_ptr<ArchiveChunkEncoder>> m_encoders = {};
+    std::vector<uint8_t> m_buffer = {};
+    /// The file last appended to, whose end was checked for an incomplete chunk
+    std::string m_checkedPath = {};
+    int64_t m_lastRetentionCheckUsec = 0;
+
+    struct
+    {
+        Counter *records = nullptr;
+        Counter *droppedRecords = nullptr;
+        Counter *chunks = nullptr;
+        Counter *bytes = nullptr;
+        Counter *writeErrors = nullptr;
+    } m_metrics = {};
+
+    std::thread m_thread;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_ARCHIVE_WRITER_H
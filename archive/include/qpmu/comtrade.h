@@ -0,0 +1,48 @@
+#ifndef QPMU_ARCHIVE_COMTRADE_H
+#define QPMU_ARCHIVE_COMTRADE_H
+
+#include "qpmu/defs.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+/// Raw samples of the channels, at one instant
+struct RawSample
+{
+    int64_t timeUsec = 0;
+    uint16_t channels[CountSignals] = {};
+};
+
+/// A recording of the raw channels around a trigger
+struct ComtradeRecording
+{
+    std::string stationName = {};
+    std::string deviceId = {};
+    Float nominalFrequency = 50;
+    Float samplingRate = 1200;
+
+    /// Conversion of the raw values to volts or amperes: `scale * raw + offset`
+    Float channelScales[CountSignals] = { 1, 1, 1, 1, 1, 1 };
+    Float channelOffsets[CountSignals] = { 0, 0, 0, 0, 0, 0 };
+
+    std::vector<RawSample> samples = {};
+    /// Index of the trigger in `samples`
+    size_t triggerIndex = 0;
+};
+
+/// @brief Writes a recording as IEEE C37.111-1999 (COMTRADE) files: `<basePath>.cfg` and, in
+/// the binary format, `<basePath>.dat`.
+///
+/// Each channel is an analog channel named after its signal, with the sample timestamps relative
+/// to the first sample. Raw values above 32767 are stored offset by 32768 (and the offset folded
+/// into the channel's conversion), so that 16-bit ADCs fit the 16-bit data format. Returns
+/// false, with the reason in `error`, if a file could not be written.
+bool writeComtrade(const std::string &basePath, const ComtradeRecording &recording,
+                   std::string &error);
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_COMTRADE_H
@@ -0,0 +1,172 @@
+#ifndef QPMU_ARCHIVE_FLIGHT_RECORDER_H
+#define QPMU_ARCHIVE_FLIGHT_RECORDER_H
+
+#include "qpmu/defs.h"
+#include "qpmu/comtrade.h"
+#include "qpmu/metrics.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace qpmu {
+
+enum FlightTrigger : uint8_t {
+    ManualTrigger = 0,
+    MagnitudeStepTrigger = 1,
+    FrequencyTrigger = 2,
+    CountFlightTriggers = 3,
+};
+
+constexpr char const *NameOfFlightTrigger[CountFlightTriggers] = { "manual", "magnitude_step",
+                                                                   "frequency" };
+
+struct FlightRecorderConfig
+{
+    /// Directory of the COMTRADE files
+    std::string directory = {};
+    std::string stationName = "QPMU";
+    uint16_t idCode = 0;
+
+    Float nominalFrequency = 50;
+    Float samplingRate = 1200;
+
+    /// Nominal cycles of the estimator's phasor window; the estimations of the samples before it
+    /// is full are of partial windows, and are not checked
+    size_t windowCycles = 1;
+
+    /// Raw samples kept in the ring, and captured before and after a trigger (in seconds); the
+    /// capture must fit the ring with room to spare, since it is copied out after the trigger
+    Float bufferSeconds = 60;
+    Float preTriggerSeconds = 1;
+    Float postTriggerSeconds = 2;
+
+    /// Triggers on a change of a phasor magnitude by this fraction of its average over the last
+    /// second (0: off), once the magnitude or its average is at least `minMagnitude` (raw units).
+    /// The averages start at the first full window, and are checked once they have settled.
+    Float magnitudeStep = 0.2;
+    Float minMagnitude = 10;
+
+    /// Triggers on a voltage frequency off nominal by this much (in Hz; 0: off)
+    Float frequencyDeviation = 0.5;
+
+    /// Conversion of the raw values to volts or amperes, written to the COMTRADE configuration
+    Float channelScales[CountSignals] = { 1, 1, 1, 1, 1, 1 };
+    Float channelOffsets[CountSignals] = { 0, 0, 0, 0, 0, 0 };
+
+    /// Whether `record()` writes each capture itself as soon as it is complete, instead of the
+    /// writer thread; for simulations, whose input can outrun the writer's polling and overwrite
+    /// a capture before it is copied out
+    bool writeOnRecordingThread = false;
+};
+
+/// @brief Keeps the last raw samples of a station in a ring, and writes the samples around each
+/// trigger as COMTRADE files.
+///
+/// The ring and the queue of captures are allocated up front, and `record()` only stores to them
+/// and updates the triggers, so it is safe to call on the acquisition thread: it neither
+/// allocates nor takes a lock. Once a capture's post-trigger samples are in, it is queued, and a
+/// writer thread, which polls the queue every 100 ms, copies it out of the ring and writes it (see
+/// `writeComtrade()`). Triggers during a capture are ignored; the next capture can start once it
+/// is queued.
+class FlightRecorder
+{
+public:
+    using ErrorCallback = std::function<void(const std::string &)>;
+
+    /// Allocates the ring and starts the writer thread. Errors are passed to the callback, which
+    /// is called on the thread that writes the captures.
+    explicit FlightRecorder(const FlightRecorderConfig &config,
+                            ErrorCallback onError = ErrorCallback());
+
+    /// Writes the queued captures, and stops the writer thread; a capture still waiting for its
+    /// post-trigger samples is dropped
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+    /// Stores a sample, and checks the triggers against its estimation; acquisition thread only.
+    /// Blocks while writing a capture with `writeOnRecordingThread`.
+    void record(const Sample &sample, const Estimation &estimation);
+
+    /// Triggers a capture at the next recorded sample; thread-safe
+    void trigger() { m_manualTrigger.store(true, std::memory_order_relaxed); }
+
+    const FlightRecorderConfig &config() const { return m_config; }
+    size_t capacity() const { return m_capacity; }
+
+private:
+    /// A sample, packed into words that the writer thread can read while they are overwritten
+    struct Slot
+    {
+        std::atomic<int64_t> timeUsec = { 0 };
+        std::atomic<uint64_t> channels[2] = {};
+    };
+
+    struct Capture
+    {
+        uint64_t firstIndex = 0;
+        uint64_t triggerIndex = 0;
+        uint64_t endIndex = 0;
+        FlightTrigger cause = ManualTrigger;
+        int64_t triggerUsec = 0;
+    };
+
+    static constexpr size_t QueueCapacity = 8;
+
+    bool checkTriggers(const Estimation &estimation, FlightTrigger &cause);
+    void run();
+    void write(const Capture &capture);
+    void reportError(const std::string &error);
+
+    FlightRecorderConfig m_config = {};
+    ErrorCallback m_onError = {};
+
+    std::unique_ptr<Slot[]> m_ring;
+    size_t m_capacity = 0;
+    uint64_t m_preTriggerSamples = 0;
+    uint64_t m_postTriggerSamples = 0;
+    std::atomic<uint64_t> m_written = { 0 };
+
+    std::atomic<bool> m_manualTrigger = { false };
+
+    /// Trigger state; acquisition thread only
+    Float m_references[CountSignals] = {};
+    Float m_referenceWeight = 0;
+    /// Samples until the window is full, and then until the references have settled
+    uint64_t m_windowSamples = 0;
+    uint64_t m_warmUpSamples = 0;
+    bool m_capturing = false;
+    Capture m_capture = {};
+
+    /// Single-producer single-consumer queue of complete captures
+    std::array<Capture, QueueCapacity> m_queue = {};
+    std::atomic<uint64_t> m_queueHead = { 0 };
+    std::atomic<uint64_t> m_queueTail = { 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    bool m_stopRequested = false;
+
+    struct
+    {
+        Counter *triggers[CountFlightTriggers] = {};
+        Counter *captures = nullptr;
+        Counter *droppedCaptures = nullptr;
+        Counter *writeErrors = nullptr;
+    } m_metrics = {};
+
+    std::thread m_thread;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_FLIGHT_RECORDER_H
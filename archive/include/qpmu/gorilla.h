@@ -0,0 +1,144 @@
+#ifndef QPMU_ARCHIVE_GORILLA_H
+#define QPMU_ARCHIVE_GORILLA_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// Appends bits to a byte buffer, most significant bit first. Bits are gathered in a 64-bit word,
+/// which is appended whole once full.
+class BitWriter
+{
+public:
+    /// Writes the low `count` bits (at most 64) of the value
+    void write(uint64_t value, int count);
+    void writeBit(bool bit) { write(bit, 1); }
+
+    /// The bits written, the last byte padded with zeros
+    const std::vector<uint8_t> &bytes() const;
+    size_t bitCount() const { return m_bitCount; }
+
+    void clear();
+
+private:
+    /// The full words, then the bytes of the partial word once `bytes()` has appended them
+    mutable std::vector<uint8_t> m_bytes = {};
+    mutable bool m_synced = true;
+    size_t m_bitCount = 0;
+    /// The partial word, in its low `m_wordBits` bits
+    uint64_t m_word = 0;
+    int m_wordBits = 0;
+};
+
+/// Reads bits written by `BitWriter`, from a 64-bit word loaded whole once the previous one is used
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, size_t size) : m_data(data), m_size(size) { }
+
+    /// Reads `count` bits (at most 64); past the end, sets `overrun()` and reads zeros
+    uint64_t read(int count)
+    {
+        assert(count >= 0 && count <= 64);
+        if (count == 0 || count > m_wordBits) {
+            return readAcrossWords(count);
+        }
+        const auto value = m_word >> (64 - count);
+        m_word = count < 64 ? m_word << count : 0;
+        m_wordBits -= count;
+        return value;
+    }
+    bool readBit() { return read(1) != 0; }
+
+    bool overrun() const { return m_overrun; }
+
+private:
+    uint64_t readAcrossWords(int count);
+
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    /// Offset of the next word to load
+    size_t m_offset = 0;
+    /// The bits not read yet of the current word, most significant first
+    uint64_t m_word = 0;
+    int m_wordBits = 0;
+    bool m_overrun = false;
+};
+
+/// @brief Delta-of-delta timestamp encoding of the Gorilla paper (Pelkonen et al., VLDB 2015).
+///
+/// The first timestamp is written in full; every other one as the change of its delta from the
+/// previous delta, in a variable-length code: `0` for no change, then `10`, `110` and `1110`
+/// followed by 7, 9 and 12 bits, and `1111` followed by the full 64 bits. Reporting instants are
+/// evenly spaced, so they take one bit each.
+class TimestampEncoder
+{
+public:
+    explicit TimestampEncoder(BitWriter &out) : m_out(&out) { }
+
+    void append(int64_t timeUsec);
+
+private:
+    BitWriter *m_out;
+    int64_t m_previous = 0;
+    int64_t m_previousDelta = 0;
+    size_t m_count = 0;
+};
+
+class TimestampDecoder
+{
+public:
+    explicit TimestampDecoder(BitReader &in) : m_in(&in) { }
+
+    int64_t next();
+
+private:
+    BitReader *m_in;
+    int64_t m_previous = 0;
+    int64_t m_previousDelta = 0;
+    size_t m_count = 0;
+};
+
+/// @brief XOR floating-point encoding of the Gorilla paper.
+///
+/// The first value is written in full; every other one as its XOR with the previous value: `0`
+/// if equal, else `10` and the meaningful bits if they fit in the previous block of meaningful
+/// bits, else `11`, 5 bits of leading zeros, 6 bits of (length - 1) and the meaningful bits.
+/// Values are encoded as doubles; single-precision values widened to double have 29 trailing
+/// zero bits, which cost nothing.
+class FloatEncoder
+{
+public:
+    explicit FloatEncoder(BitWriter &out) : m_out(&out) { }
+
+    void append(double value);
+
+private:
+    BitWriter *m_out;
+    uint64_t m_previous = 0;
+    int m_leading = -1;
+    int m_trailing = 0;
+    size_t m_count = 0;
+};
+
+class FloatDecoder
+{
+public:
+    explicit FloatDecoder(BitReader &in) : m_in(&in) { }
+
+    double next();
+
+private:
+    BitReader *m_in;
+    uint64_t m_previous = 0;
+    int m_leading = 0;
+    int m_trailing = 0;
+    size_t m_count = 0;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_ARCHIVE_GORILLA_H
@@ -0,0 +1,258 @@
+#include "qpmu/archive_chunk.h"
+#include "qpmu/frames.h"
+
+#include <cmath>
+#include <complex>
+
+namespace qpmu {
+
+namespace {
+
+constexpr size_t FixedHeaderSize = 4 + 2 + 2 + 4 + 8 + 8;
+
+template <class T>
+void putLE(std::vector<uint8_t> &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back((uint8_t)((uint64_t)value >> (8 * i)));
+    }
+}
+
+template <class T>
+T getLE(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return (T)value;
+}
+
+} // namespace
+
+std::string ArchiveColumns::name(size_t column)
+{
+    static const char *Quantities[PerSignal] = { "magnitude", "angle", "frequency", "rocof" };
+    if (column == SamplingRate) {
+        return "sampling_rate";
+    }
+    if (column >= Count) {
+        return std::string();
+    }
+    return std::string(NameOfSignal[column / PerSignal]) + "." + Quantities[column % PerSignal];
+}
+
+size_t ArchiveColumns::find(const std::string &name)
+{
+    for (size_t column = 0; column < Count; ++column) {
+        if (ArchiveColumns::name(column) == name) {
+            return column;
+        }
+    }
+    return Count;
+}
+
+ArchiveChunkEncoder::ArchiveChunkEncoder(uint16_t station)
+    : m_station(station), m_times(m_timeBits), m_columnBits(ArchiveColumns::Count)
+{
+    for (auto &bits : m_columnBits) {
+        m_columns.emplace_back(bits);
+    }
+}
+
+void ArchiveChunkEncoder::append(int64_t timeUsec, const Estimation &estimation)
+{
+    if (m_count == 0) {
+        m_firstTimeUsec = timeUsec;
+    }
+    m_lastTimeUsec = timeUsec;
+    ++m_count;
+
+    m_times.append(timeUsec);
+    for (size_t i = 0; i < CountSignals; ++i) {
+        m_columns[ArchiveColumns::magnitude(i)].append(std::abs(estimation.phasors[i]));
+        m_columns[ArchiveColumns::angle(i)].append(std::arg(estimation.phasors[i]));
+        m_columns[ArchiveColumns::frequency(i)].append(estimation.frequencies[i]);
+        m_columns[ArchiveColumns::rocof(i)].append(estimation.rocofs[i]);
+    }
+    m_columns[ArchiveColumns::SamplingRate].append(estimation.samplingRate);
+}
+
+size_t ArchiveChunkEncoder::size() const
+{
+    size_t size = FixedHeaderSize + 4 * (1 + m_columnBits.size()) + 2 + m_timeBits.bytes().size();
+    for (const auto &bits : m_columnBits) {
+        size += bits.bytes().size();
+    }
+    return size;
+}
+
+void ArchiveChunkEncoder::finish(std::vector<uint8_t> &out)
+{
+    const size_t chunkAt = out.size();
+    putLE<uint32_t>(out, Magic);
+    putLE<uint16_t>(out, m_station);
+    putLE<uint16_t>(out, (uint16_t)m_columnBits.size());
+    putLE<uint32_t>(out, (uint32_t)m_count);
+    putLE<int64_t>(out, m_firstTimeUsec);
+    putLE<int64_t>(out, m_lastTimeUsec);
+    putLE<uint32_t>(out, (uint32_t)m_timeBits.bytes().size());
+    for (const auto &bits : m_columnBits) {
+        putLE<uint32_t>(out, (uint32_t)bits.bytes().size());
+    }
+
+    const size_t checksumAt = out.size();
+    putLE<uint16_t>(out, 0);
+    const size_t columnsAt = out.size();
+    out.insert(out.end(), m_timeBits.bytes().begin(), m_timeBits.bytes().end());
+    for (const auto &bits : m_columnBits) {
+        out.insert(out.end(), bits.bytes().begin(), bits.bytes().end());
+    }
+
+    const auto headerChecksum = crcCcitt(out.data() + chunkAt, checksumAt - chunkAt);
+    const auto checksum =
+            crcCcitt(out.data() + columnsAt, out.size() - columnsAt, headerChecksum);
+    out[checksumAt] = (uint8_t)checksum;
+    out[checksumAt + 1] = (uint8_t)(checksum >> 8);
+
+    reset();
+}
+
+void ArchiveChunkEncoder::reset()
+{
+    m_count = 0;
+    m_firstTimeUsec = 0;
+    m_lastTimeUsec = 0;
+    m_timeBits.clear();
+    m_times = TimestampEncoder(m_timeBits);
+    for (size_t i = 0; i < m_columnBits.size(); ++i) {
+        m_columnBits[i].clear();
+        m_columns[i] = FloatEncoder(m_columnBits[i]);
+    }
+}
+
+size_t ArchiveChunkHeader::headerSize() const
+{
+    return FixedHeaderSize + 4 * columnSizes.size() + 2;
+}
+
+size_t ArchiveChunkHeader::chunkSize() const
+{
+    size_t size = headerSize();
+    for (auto columnSize : columnSizes) {
+        size += columnSize;
+    }
+    return size;
+}
+
+bool readArchiveChunkHeader(const uint8_t *data, size_t size, ArchiveChunkHeader &header,
+                            std::string &error)
+{
+    if (size < FixedHeaderSize) {
+        error = "Truncated chunk header";
+        return false;
+    }
+    const auto magic = getLE<uint32_t>(data);
+    if (magic != ArchiveChunkEncoder::Magic && magic != ArchiveChunkEncoder::LegacyMagic) {
+        error = "Not an archive chunk";
+        return false;
+    }
+    header.legacy = magic == ArchiveChunkEncoder::LegacyMagic;
+    header.station = getLE<uint16_t>(data + 4);
+    const auto countColumns = getLE<uint16_t>(data + 6);
+    header.countRecords = getLE<uint32_t>(data + 8);
+    header.firstTimeUsec = getLE<int64_t>(data + 12);
+    header.lastTimeUsec = getLE<int64_t>(data + 20);
+
+    /// The time column, then the value columns
+    header.columnSizes.resize(1 + (size_t)countColumns);
+    if (size < header.headerSize()) {
+        error = "Truncated chunk header";
+        return false;
+    }
+    auto p = data + FixedHeaderSize;
+    for (auto &columnSize : header.columnSizes) {
+        columnSize = getLE<uint32_t>(p);
+        p += 4;
+    }
+    header.checksum = getLE<uint16_t>(p);
+
+    /// Every record takes at least one bit of each column, which bounds a corrupt record count
+    /// before the checksum can be verified, and in "QPA1" chunks, whose checksum does not cover it
+    for (auto columnSize : header.columnSizes) {
+        if (header.countRecords > 8 * (uint64_t)columnSize) {
+            error = "Record count exceeds the chunk's columns";
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t archiveChunkChecksum(const uint8_t *data, const ArchiveChunkHeader &header)
+{
+    const auto checksumAt = header.headerSize() - 2;
+    const uint16_t headerChecksum = header.legacy ? 0xFFFF : crcCcitt(data, checksumAt);
+    return crcCcitt(data + header.headerSize(), header.chunkSize() - header.headerSize(),
+                    headerChecksum);
+}
+
+bool decodeArchiveChunk(const uint8_t *data, size_t size, std::vector<ArchiveRecord> &records,
+                        std::string &error)
+{
+    ArchiveChunkHeader header;
+    if (!readArchiveChunkHeader(data, size, header, error)) {
+        return false;
+    }
+    if (header.columnSizes.size() != 1 + ArchiveColumns::Count) {
+        error = "Unexpected number of columns: " + std::to_string(header.columnSizes.size() - 1);
+        return false;
+    }
+    if (size < header.chunkSize()) {
+        error = "Truncated chunk";
+        return false;
+    }
+    if (archiveChunkChecksum(data, header) != header.checksum) {
+        error = "Chunk checksum mismatch";
+        return false;
+    }
+
+    std::vector<BitReader> readers;
+    readers.reserve(header.columnSizes.size());
+    auto p = data + header.headerSize();
+    for (auto columnSize : header.columnSizes) {
+        readers.emplace_back(p, columnSize);
+        p += columnSize;
+    }
+    TimestampDecoder times(readers[0]);
+    std::vector<FloatDecoder> values;
+    values.reserve(ArchiveColumns::Count);
+    for (size_t c = 0; c < ArchiveColumns::Count; ++c) {
+        values.emplace_back(readers[1 + c]);
+    }
+
+    for (uint32_t r = 0; r < header.countRecords; ++r) {
+        ArchiveRecord record;
+        record.station = header.station;
+        record.timeUsec = times.next();
+        auto &estimation = record.estimation;
+        for (size_t i = 0; i < CountSignals; ++i) {
+            auto magnitude = values[ArchiveColumns::magnitude(i)].next();
+            auto angle = values[ArchiveColumns::angle(i)].next();
+            estimation.phasors[i] = std::polar((Float)magnitude, (Float)angle);
+            estimation.frequencies[i] = (Float)values[ArchiveColumns::frequency(i)].next();
+            estimation.rocofs[i] = (Float)values[ArchiveColumns::rocof(i)].next();
+        }
+        estimation.samplingRate = (Float)values[ArchiveColumns::SamplingRate].next();
+        records.push_back(record);
+    }
+
+    for (const auto &reader : readers) {
+        if (reader.overrun()) {
+            error = "Chunk column shorter than its records";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace qpmu
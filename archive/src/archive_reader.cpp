@@ -0,0 +1,377 @@
+#include "qpmu/archive_reader.h"
+#include "qpmu/archive_writer.h"
+#include "qpmu/trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace qpmu {
+
+namespace {
+
+constexpr int64_t UsecPerDay = 86400LL * 1000000;
+
+/// Start of the bucket holding a time, rounding towards negative infinity
+int64_t bucketStart(int64_t timeUsec, int64_t bucketUsec)
+{
+    auto remainder = timeUsec % bucketUsec;
+    return timeUsec - (remainder < 0 ? remainder + bucketUsec : remainder);
+}
+
+void addToBuckets(std::vector<ArchiveBucket> &buckets, int64_t bucketUsec, int64_t timeUsec,
+                  double value)
+{
+    const auto start = bucketStart(timeUsec, bucketUsec);
+    if (buckets.empty() || buckets.back().timeUsec != start) {
+        /// The mean holds the sum until the query ends
+        buckets.push_back({ start, 1, value, value, value });
+        return;
+    }
+    auto &bucket = buckets.back();
+    ++bucket.count;
+    bucket.min = std::min(bucket.min, value);
+    bucket.max = std::max(bucket.max, value);
+    bucket.mean += value;
+}
+
+} // namespace
+
+ArchiveFile::~ArchiveFile()
+{
+    close();
+}
+
+bool ArchiveFile::open(const std::string &path, std::string &error)
+{
+    close();
+    m_path = path;
+    if (!map(error)) {
+        return false;
+    }
+    index();
+    return true;
+}
+
+bool ArchiveFile::refresh(std::string &error)
+{
+    std::error_code sizeError;
+    const auto size = (size_t)std::filesystem::file_size(m_path, sizeError);
+    if (sizeError) {
+        error = "Failed to read the size of " + m_path;
+        return false;
+    }
+    if (size == m_size) {
+        return true;
+    }
+    if (size < m_size) {
+        /// Truncated, e.g., by the writer dropping an incomplete chunk: index it all again
+        const auto path = m_path;
+        return open(path, error);
+    }
+
+    /// The writer only appends, so the chunks indexed so far stay where they are
+    unmap();
+    if (!map(error)) {
+        return false;
+    }
+    index();
+    return true;
+}
+
+bool ArchiveFile::map(std::string &error)
+{
+#ifdef _WIN32
+    auto file = std::fopen(m_path.c_str(), "rb");
+    if (!file) {
+        error = "Failed to open " + m_path;
+        return false;
+    }
+    uint8_t buffer[1 << 16];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        m_contents.insert(m_contents.end(), buffer, buffer + count);
+    }
+    std::fclose(file);
+    m_data = m_contents.data();
+    m_size = m_contents.size();
+#else
+    const int fd = ::open(m_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Failed to open " + m_path;
+        return false;
+    }
+    struct stat status = {};
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        error = "Failed to read the size of " + m_path;
+        return false;
+    }
+    m_size = (size_t)status.st_size;
+    if (m_size > 0) {
+        auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            m_size = 0;
+            error = "Failed to map " + m_path;
+            return false;
+        }
+        m_data = (const uint8_t *)data;
+        m_mapped = true;
+    }
+    ::close(fd);
+#endif
+    return true;
+}
+
+void ArchiveFile::unmap()
+{
+#ifndef _WIN32
+    if (m_mapped) {
+        ::munmap((void *)m_data, m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_contents.clear();
+}
+
+void ArchiveFile::index()
+{
+    m_indexError.clear();
+    size_t offset = m_indexedSize;
+    while (offset < m_size) {
+        ChunkEntry entry;
+        entry.offset = offset;
+        std::string error;
+        bool intact = readArchiveChunkHeader(m_data + offset, m_size - offset, entry.header,
+                                             error);
+        if (intact && entry.header.chunkSize() > m_size - offset) {
+            error = "Truncated chunk";
+            intact = false;
+        }
+        if (intact) {
+            offset += entry.header.chunkSize();
+            m_indexedSize = offset;
+            if (entry.header.countRecords > 0) {
+                m_chunks[entry.header.station].push_back(std::move(entry));
+            }
+            continue;
+        }
+
+        /// A corrupt chunk, skipped to the next intact one; if there is none, the chunk is
+        /// incomplete, and is indexed once the file has grown
+        m_indexError = error;
+        const auto next = findChunk(offset + 1);
+        if (next == m_size) {
+            break;
+        }
+        m_skippedBytes += next - offset;
+        offset = next;
+        m_indexedSize = offset;
+    }
+    for (auto &[station, chunks] : m_chunks) {
+        std::stable_sort(chunks.begin(), chunks.end(), [](const auto &a, const auto &b) {
+            return a.header.firstTimeUsec < b.header.firstTimeUsec;
+        });
+    }
+}
+
+size_t ArchiveFile::findChunk(size_t offset) const
+{
+    /// The magic without its version byte, which the header parser checks
+    const uint8_t magic[3] = { (uint8_t)ArchiveChunkEncoder::Magic,
+                               (uint8_t)(ArchiveChunkEncoder::Magic >> 8),
+                               (uint8_t)(ArchiveChunkEncoder::Magic >> 16) };
+    const auto end = m_data + m_size;
+    for (auto p = m_data + offset; p < end;) {
+        p = std::search(p, end, magic, magic + 3);
+        if (p == end) {
+            break;
+        }
+        /// The magic may occur in compressed data, so only a chunk whose checksum holds counts
+        ArchiveChunkHeader header;
+        std::string error;
+        const auto size = (size_t)(end - p);
+        if (readArchiveChunkHeader(p, size, header, error) && header.chunkSize() <= size
+            && archiveChunkChecksum(p, header) == header.checksum) {
+            return (size_t)(p - m_data);
+        }
+        ++p;
+    }
+    return m_size;
+}
+
+void ArchiveFile::close()
+{
+    unmap();
+    m_path.clear();
+    m_chunks.clear();
+    m_indexedSize = 0;
+    m_skippedBytes = 0;
+    m_indexError.clear();
+}
+
+const std::vector<ArchiveFile::ChunkEntry> &ArchiveFile::chunks(uint16_t station) const
+{
+    static const std::vector<ChunkEntry> None;
+    auto it = m_chunks.find(station);
+    return it == m_chunks.end() ? None : it->second;
+}
+
+std::vector<uint16_t> ArchiveFile::stations() const
+{
+    std::vector<uint16_t> stations;
+    for (const auto &[station, chunks] : m_chunks) {
+        stations.push_back(station);
+    }
+    return stations;
+}
+
+bool decodeArchiveColumns(const uint8_t *chunk, const ArchiveChunkHeader &header,
+                          const std::vector<size_t> &columns, std::vector<int64_t> &times,
+                          std::vector<std::vector<double>> &values, int64_t untilUsec)
+{
+    /// Offsets of the columns, from the sizes in the header
+    std::vector<size_t> offsets(header.columnSizes.size());
+    size_t offset = header.headerSize();
+    for (size_t c = 0; c < header.columnSizes.size(); ++c) {
+        offsets[c] = offset;
+        offset += header.columnSizes[c];
+    }
+
+    times.clear();
+    times.reserve(header.countRecords);
+    BitReader timeBits(chunk + offsets[0], header.columnSizes[0]);
+    TimestampDecoder timeDecoder(timeBits);
+    for (uint32_t r = 0; r < header.countRecords; ++r) {
+        const auto time = timeDecoder.next();
+        if (time >= untilUsec) {
+            break;
+        }
+        times.push_back(time);
+    }
+    if (timeBits.overrun()) {
+        return false;
+    }
+
+    /// Values are XOR encoded against their predecessors, so a column is decoded from its start,
+    /// but only up to the last record wanted
+    values.resize(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (1 + columns[i] >= header.columnSizes.size()) {
+            return false;
+        }
+        BitReader bits(chunk + offsets[1 + columns[i]], header.columnSizes[1 + columns[i]]);
+        FloatDecoder decoder(bits);
+        values[i].resize(times.size());
+        for (auto &value : values[i]) {
+            value = decoder.next();
+        }
+        if (bits.overrun()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ArchiveReader::ArchiveReader(const std::string &directory) : m_directory(directory) { }
+
+const ArchiveFile *ArchiveReader::file(int64_t timeUsec)
+{
+    const auto path = ArchiveWriter::filePath(m_directory, timeUsec);
+    std::string error;
+    auto it = m_files.find(path);
+    if (it == m_files.end()) {
+        std::unique_ptr<ArchiveFile> file(new ArchiveFile);
+        if (!file->open(path, error)) {
+            return nullptr;
+        }
+        it = m_files.emplace(path, std::move(file)).first;
+    } else if (!it->second->refresh(error)) {
+        /// Deleted, e.g., by the retention of the writer
+        m_files.erase(it);
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+ArchiveQueryResult ArchiveReader::query(const ArchiveQuery &query)
+{
+    QPMU_TRACE_SCOPE("archive query");
+    ArchiveQueryResult result;
+    result.values.resize(query.bucketUsec > 0 ? 0 : query.columns.size());
+    result.buckets.resize(query.bucketUsec > 0 ? query.columns.size() : 0);
+    if (query.toUsec <= query.fromUsec) {
+        return result;
+    }
+
+    const auto firstDay = bucketStart(query.fromUsec, UsecPerDay);
+    for (int64_t day = firstDay; day < query.toUsec; day += UsecPerDay) {
+        auto file = this->file(day);
+        if (!file) {
+            continue;
+        }
+        const auto &chunks = file->chunks(query.station);
+
+        /// The first chunk ending at or after the start of the range
+        auto it = std::partition_point(chunks.begin(), chunks.end(), [&](const auto &entry) {
+            return entry.header.lastTimeUsec < query.fromUsec;
+        });
+        for (; it != chunks.end() && it->header.firstTimeUsec < query.toUsec; ++it) {
+            queryChunk(file->data() + it->offset, it->header, query, result);
+        }
+    }
+
+    for (auto &buckets : result.buckets) {
+        for (auto &bucket : buckets) {
+            bucket.mean /= (double)bucket.count;
+        }
+    }
+    return result;
+}
+
+void ArchiveReader::queryChunk(const uint8_t *chunk, const ArchiveChunkHeader &header,
+                               const ArchiveQuery &query, ArchiveQueryResult &result)
+{
+    if (query.verifyChecksums && archiveChunkChecksum(chunk, header) != header.checksum) {
+        ++result.chunksFailed;
+        return;
+    }
+
+    std::vector<int64_t> times;
+    std::vector<std::vector<double>> values;
+    if (!decodeArchiveColumns(chunk, header, query.columns, times, values, query.toUsec)) {
+        ++result.chunksFailed;
+        return;
+    }
+    ++result.chunksRead;
+
+    const size_t end = times.size();
+    const size_t begin =
+            std::lower_bound(times.begin(), times.end(), query.fromUsec) - times.begin();
+    for (size_t i = 0; i < query.columns.size(); ++i) {
+        if (query.bucketUsec > 0) {
+            for (size_t r = begin; r < end; ++r) {
+                addToBuckets(result.buckets[i], query.bucketUsec, times[r], values[i][r]);
+            }
+        } else {
+            result.values[i].insert(result.values[i].end(), values[i].begin() + begin,
+                                    values[i].begin() + end);
+        }
+    }
+    if (query.bucketUsec <= 0) {
+        result.times.insert(result.times.end(), times.begin() + begin, times.begin() + end);
+    }
+}
+
+} // namespace qpmu
@@ -0,0 +1,265 @@
+#include "qpmu/archive_writer.h"
+#include "qpmu/archive_reader.h"
+#include "qpmu/clock.h"
+#include "qpmu/trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <system_error>
+
+namespace qpmu {
+
+namespace {
+
+constexpr int64_t UsecPerDay = 86400LL * 1000000;
+
+const char FilePrefix[] = "qpmu-";
+const char FileSuffix[] = ".qpa";
+
+/// UTC day of a time, as `YYYYMMDD`
+std::string dayString(int64_t timeUsec)
+{
+    std::time_t seconds = (std::time_t)(timeUsec / 1000000);
+    std::tm tm = {};
+#ifdef _WIN32
+    gmtime_s(&tm, &seconds);
+#else
+    gmtime_r(&seconds, &tm);
+#endif
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), "%Y%m%d", &tm);
+    return buffer;
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(const ArchiveConfig &config, ErrorCallback onError)
+    : m_config(config), m_onError(std::move(onError))
+{
+    auto &registry = MetricsRegistry::instance();
+    m_metrics.records = &registry.counter("qpmu_archive_records_total",
+                                          "Estimations written to the archive.");
+    m_metrics.droppedRecords = &registry.counter(
+            "qpmu_archive_dropped_total",
+            "Estimations not archived because the archive writer's queue was full.");
+    m_metrics.chunks = &registry.counter("qpmu_archive_chunks_total",
+                                         "Chunks appended to the archive files.");
+    m_metrics.bytes = &registry.counter("qpmu_archive_bytes_total",
+                                        "Bytes appended to the archive files.");
+    m_metrics.writeErrors = &registry.counter(
+            "qpmu_archive_write_errors_total",
+            "Chunks lost because their archive file could not be written.");
+
+    m_queue.reserve(m_config.queueCapacity);
+
+    std::error_code error;
+    std::filesystem::create_directories(m_config.directory, error);
+    if (error) {
+        reportError("Failed to create the archive directory " + m_config.directory + ": "
+                    + error.message());
+    }
+
+    m_thread = std::thread([this] { run(); });
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+bool ArchiveWriter::push(uint16_t station, int64_t timeUsec, const Estimation &estimation)
+{
+    bool wakeUp = false;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_config.blockWhenFull) {
+            m_drained.wait(lock, [this] {
+                return m_queue.size() < m_config.queueCapacity || m_stopRequested;
+            });
+        }
+        if (m_queue.size() >= m_config.queueCapacity) {
+            m_metrics.droppedRecords->add();
+            return false;
+        }
+        m_queue.push_back({ station, timeUsec, estimation });
+        wakeUp = (m_queue.size() == m_config.queueCapacity / 2);
+    }
+    if (wakeUp) {
+        m_wakeUp.notify_one();
+    }
+    return true;
+}
+
+void ArchiveWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const auto request = ++m_flushRequests;
+    m_wakeUp.notify_one();
+    m_flushed.wait(lock, [&] { return m_flushesDone >= request; });
+}
+
+std::string ArchiveWriter::filePath(const std::string &directory, int64_t timeUsec)
+{
+    return (std::filesystem::path(directory) / (FilePrefix + dayString(timeUsec) + FileSuffix))
+            .string();
+}
+
+void ArchiveWriter::run()
+{
+    QPMU_TRACE_THREAD_NAME("archive");
+
+    /// Swapped with the queue, so that both keep their capacity
+    std::vector<ArchiveRecord> batch;
+    batch.reserve(m_config.queueCapacity);
+
+    bool stop = false;
+    while (!stop) {
+        uint64_t flushRequests;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait_for(lock, std::chrono::seconds(1), [this] {
+                return m_stopRequested || m_flushRequests > m_flushesDone
+                        || m_queue.size() >= m_config.queueCapacity / 2;
+            });
+            stop = m_stopRequested;
+            flushRequests = m_flushRequests;
+            batch.swap(m_queue);
+        }
+        m_drained.notify_all();
+
+        encode(batch);
+        batch.clear();
+
+        if (stop || flushRequests > m_flushesDone) {
+            for (auto &[station, encoder] : m_encoders) {
+                writeChunk(*encoder);
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_flushesDone = flushRequests;
+            m_flushed.notify_all();
+        }
+        removeExpiredFiles(currentTimeUsec());
+    }
+}
+
+void ArchiveWriter::encode(const std::vector<ArchiveRecord> &records)
+{
+    QPMU_TRACE_SCOPE("archive encode");
+    const int64_t chunkUsec = m_config.chunkSeconds * 1000000;
+    for (const auto &record : records) {
+        auto &encoder = m_encoders[record.station];
+        if (!encoder) {
+            encoder.reset(new ArchiveChunkEncoder(record.station));
+        }
+
+        /// A chunk never spans two days, so that it belongs to a single file
+        if (encoder->count() > 0
+            && record.timeUsec / UsecPerDay != encoder->firstTimeUsec() / UsecPerDay) {
+            writeChunk(*encoder);
+        }
+
+        encoder->append(record.timeUsec, record.estimation);
+        m_metrics.records->add();
+
+        if (encoder->count() >= m_config.chunkRecords
+            || encoder->lastTimeUsec() - encoder->firstTimeUsec() >= chunkUsec) {
+            writeChunk(*encoder);
+        }
+    }
+}
+
+void ArchiveWriter::writeChunk(ArchiveChunkEncoder &encoder)
+{
+    if (encoder.count() == 0) {
+        return;
+    }
+    QPMU_TRACE_SCOPE("archive write");
+
+    const auto path = filePath(m_config.directory, encoder.firstTimeUsec());
+    m_buffer.clear();
+    encoder.finish(m_buffer);
+
+    if (path != m_checkedPath) {
+        dropIncompleteChunk(path);
+        m_checkedPath = path;
+    }
+
+    auto file = std::fopen(path.c_str(), "ab");
+    bool ok = (file != nullptr);
+    if (ok) {
+        ok = std::fwrite(m_buffer.data(), 1, m_buffer.size(), file) == m_buffer.size();
+        ok = (std::fclose(file) == 0) && ok;
+    }
+    if (!ok) {
+        m_metrics.writeErrors->add();
+        reportError("Failed to write to the archive file " + path);
+        return;
+    }
+    m_metrics.chunks->add();
+    m_metrics.bytes->add(m_buffer.size());
+}
+
+void ArchiveWriter::dropIncompleteChunk(const std::string &path)
+{
+    size_t indexedSize = 0;
+    size_t size = 0;
+    {
+        ArchiveFile file;
+        std::string error;
+        if (!file.open(path, error)) {
+            return;
+        }
+        indexedSize = file.indexedSize();
+        size = file.size();
+    }
+    if (indexedSize == size) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::resize_file(path, indexedSize, error);
+    if (error) {
+        reportError("Failed to drop the incomplete chunk at the end of the archive file " + path
+                    + ": " + error.message());
+        return;
+    }
+    reportError("Dropped an incomplete chunk of " + std::to_string(size - indexedSize)
+                + " bytes at the end of the archive file " + path);
+}
+
+void ArchiveWriter::removeExpiredFiles(int64_t nowUsec)
+{
+    /// Checked hourly; the file names sort by date
+    constexpr int64_t CheckIntervalUsec = 3600LL * 1000000;
+    if (m_config.retentionDays <= 0 || nowUsec - m_lastRetentionCheckUsec < CheckIntervalUsec) {
+        return;
+    }
+    m_lastRetentionCheckUsec = nowUsec;
+
+    const auto oldestKept = FilePrefix + dayString(nowUsec - m_config.retentionDays * UsecPerDay)
+            + FileSuffix;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(m_config.directory, error)) {
+        const auto name = entry.path().filename().string();
+        if (name.size() == oldestKept.size() && name.rfind(FilePrefix, 0) == 0
+            && name.compare(name.size() - 4, 4, FileSuffix) == 0 && name < oldestKept) {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+void ArchiveWriter::reportError(const std::string &error)
+{
+    if (m_onError) {
+        m_onError(error);
+    }
+}
+
+} // namespace qpmu
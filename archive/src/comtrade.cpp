@@ -0,0 +1,124 @@
+#include "qpmu/comtrade.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace qpmu {
+
+namespace {
+
+/// Value marking a missing sample in the binary data format
+constexpr int32_t MissingValue = -32768;
+
+/// UTC date and time of a timestamp, as `dd/mm/yyyy,hh:mm:ss.ssssss`
+std::string comtradeTime(int64_t timeUsec)
+{
+    auto seconds = timeUsec / 1000000;
+    auto micros = timeUsec % 1000000;
+    if (micros < 0) {
+        micros += 1000000;
+        seconds -= 1;
+    }
+    std::time_t time = (std::time_t)seconds;
+    std::tm tm = {};
+#ifdef _WIN32
+    gmtime_s(&tm, &time);
+#else
+    gmtime_r(&time, &tm);
+#endif
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%02d/%02d/%04d,%02d:%02d:%02d.%06lld", tm.tm_mday,
+                  tm.tm_mon + 1, tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                  (long long)micros);
+    return buffer;
+}
+
+template <class T>
+void putLE(std::ostream &out, T value)
+{
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bytes[i] = (char)((uint64_t)value >> (8 * i));
+    }
+    out.write(bytes, sizeof(T));
+}
+
+} // namespace
+
+bool writeComtrade(const std::string &basePath, const ComtradeRecording &recording,
+                   std::string &error)
+{
+    if (recording.samples.empty()) {
+        error = "No samples to record";
+        return false;
+    }
+    const auto &samples = recording.samples;
+    const auto firstUsec = samples.front().timeUsec;
+
+    /// Channels whose raw values do not fit the signed 16-bit data are stored shifted down
+    int32_t shifts[CountSignals] = {};
+    uint16_t maxRaw[CountSignals] = {};
+    uint16_t minRaw[CountSignals];
+    std::fill(std::begin(minRaw), std::end(minRaw), (uint16_t)65535);
+    for (const auto &sample : samples) {
+        for (size_t c = 0; c < CountSignals; ++c) {
+            minRaw[c] = std::min(minRaw[c], sample.channels[c]);
+            maxRaw[c] = std::max(maxRaw[c], sample.channels[c]);
+        }
+    }
+    auto stored = [&](size_t c, uint16_t raw) {
+        return std::max<int32_t>((int32_t)raw - shifts[c], MissingValue + 1);
+    };
+
+    std::ostringstream cfg;
+    cfg.precision(9);
+    cfg << recording.stationName << "," << recording.deviceId << ",1999\r\n";
+    cfg << CountSignals << "," << CountSignals << "A,0D\r\n";
+    for (size_t c = 0; c < CountSignals; ++c) {
+        shifts[c] = maxRaw[c] > 32767 ? 32768 : 0;
+        const auto scale = recording.channelScales[c];
+        const auto offset = recording.channelOffsets[c] + scale * (Float)shifts[c];
+        cfg << (c + 1) << "," << NameOfSignal[c] << "," << (char)('A' + PhaseOfSignal[c]) << ",,"
+            << UnitSymbolOfSignalType[TypeOfSignal[c]] << "," << scale << "," << offset << ",0,"
+            << stored(c, minRaw[c]) << "," << stored(c, maxRaw[c]) << ",1,1,P\r\n";
+    }
+    cfg << recording.nominalFrequency << "\r\n";
+    cfg << "1\r\n";
+    cfg << recording.samplingRate << "," << samples.size() << "\r\n";
+    cfg << comtradeTime(firstUsec) << "\r\n";
+    cfg << comtradeTime(samples[std::min(recording.triggerIndex, samples.size() - 1)].timeUsec)
+        << "\r\n";
+    cfg << "BINARY\r\n";
+    cfg << "1\r\n";
+
+    std::ofstream cfgFile(basePath + ".cfg", std::ios::binary);
+    cfgFile << cfg.str();
+    cfgFile.close();
+    if (!cfgFile) {
+        error = "Failed to write " + basePath + ".cfg";
+        return false;
+    }
+
+    /// Records: sample number (4), timestamp (4, microseconds), then a 2-byte value per channel
+    std::ofstream datFile(basePath + ".dat", std::ios::binary);
+    uint32_t number = 0;
+    for (const auto &sample : samples) {
+        putLE<uint32_t>(datFile, ++number);
+        putLE<uint32_t>(datFile, (uint32_t)std::max<int64_t>(sample.timeUsec - firstUsec, 0));
+        for (size_t c = 0; c < CountSignals; ++c) {
+            putLE<int16_t>(datFile, (int16_t)stored(c, sample.channels[c]));
+        }
+    }
+    datFile.close();
+    if (!datFile) {
+        error = "Failed to write " + basePath + ".dat";
+        return false;
+    }
+    return true;
+}
+
+} // namespace qpmu
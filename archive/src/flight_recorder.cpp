@@ -0,0 +1,283 @@
+#include "qpmu/flight_recorder.h"
+#include "qpmu/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <system_error>
+
+namespace qpmu {
+
+namespace {
+
+/// Time constant of the magnitude references (in seconds), and how many of them pass before
+/// they are checked: 5 leave less than 1% of their starting error
+constexpr Float ReferenceSeconds = 1;
+constexpr Float WarmUpTimeConstants = 5;
+
+/// How often the writer thread looks for captures; `record()` does not wake it up, since that
+/// may take a system call
+constexpr auto PollInterval = std::chrono::milliseconds(100);
+
+uint64_t packChannels(const uint16_t *channels, size_t count)
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+        word |= (uint64_t)channels[i] << (16 * i);
+    }
+    return word;
+}
+
+void unpackChannels(uint64_t word, uint16_t *channels, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        channels[i] = (uint16_t)(word >> (16 * i));
+    }
+}
+
+/// File name of a capture, without the extension, e.g., `qpmu-1-20260101-123456.789012-frequency`
+std::string captureName(uint16_t idCode, int64_t timeUsec, FlightTrigger cause)
+{
+    std::time_t seconds = (std::time_t)(timeUsec / 1000000);
+    std::tm tm = {};
+#ifdef _WIN32
+    gmtime_s(&tm, &seconds);
+#else
+    gmtime_r(&seconds, &tm);
+#endif
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "qpmu-%u-%04d%02d%02d-%02d%02d%02d.%06lld-%s",
+                  (unsigned)idCode, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour,
+                  tm.tm_min, tm.tm_sec, (long long)(timeUsec % 1000000),
+                  NameOfFlightTrigger[cause]);
+    return buffer;
+}
+
+} // namespace
+
+static_assert(CountSignals > 4 && CountSignals <= 8,
+              "The channels of a sample must pack into two 64-bit words");
+
+FlightRecorder::FlightRecorder(const FlightRecorderConfig &config, ErrorCallback onError)
+    : m_config(config), m_onError(std::move(onError))
+{
+    const auto rate = m_config.samplingRate;
+    m_capacity = std::max<size_t>(1, (size_t)std::lround(m_config.bufferSeconds * rate));
+    m_preTriggerSamples = (uint64_t)std::lround(m_config.preTriggerSeconds * rate);
+    m_postTriggerSamples = (uint64_t)std::lround(m_config.postTriggerSeconds * rate);
+    m_ring.reset(new Slot[m_capacity]);
+    m_windowSamples = (uint64_t)std::lround(m_config.windowCycles * rate
+                                            / std::max<Float>(1, m_config.nominalFrequency));
+    m_warmUpSamples = (uint64_t)std::lround(WarmUpTimeConstants * ReferenceSeconds * rate);
+    m_referenceWeight = 1 / std::max<Float>(1, ReferenceSeconds * rate);
+
+    auto &registry = MetricsRegistry::instance();
+    const auto station = "station=\"" + std::to_string(m_config.idCode) + "\"";
+    for (size_t i = 0; i < CountFlightTriggers; ++i) {
+        m_metrics.triggers[i] = &registry.counter(
+                "qpmu_recorder_triggers_total", "Flight recorder captures started, by cause.",
+                station + ",cause=\"" + NameOfFlightTrigger[i] + "\"");
+    }
+    m_metrics.captures = &registry.counter(
+            "qpmu_recorder_captures_total", "Flight recorder captures written as COMTRADE files.",
+            station);
+    m_metrics.droppedCaptures = &registry.counter(
+            "qpmu_recorder_captures_dropped_total",
+            "Flight recorder captures dropped because the writer fell behind.", station);
+    m_metrics.writeErrors = &registry.counter(
+            "qpmu_recorder_write_errors_total",
+            "Flight recorder captures lost because their files could not be written.", station);
+
+    std::error_code error;
+    std::filesystem::create_directories(m_config.directory, error);
+    if (error) {
+        reportError("Failed to create the recorder directory " + m_config.directory + ": "
+                    + error.message());
+    }
+
+    m_thread = std::thread([this] { run(); });
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+void FlightRecorder::record(const Sample &sample, const Estimation &estimation)
+{
+    const auto index = m_written.load(std::memory_order_relaxed);
+    auto &slot = m_ring[index % m_capacity];
+    slot.timeUsec.store(sample.timestampUsec, std::memory_order_relaxed);
+    slot.channels[0].store(packChannels(sample.channels, 4), std::memory_order_relaxed);
+    slot.channels[1].store(packChannels(sample.channels + 4, CountSignals - 4),
+                           std::memory_order_relaxed);
+    m_written.store(index + 1, std::memory_order_release);
+
+    FlightTrigger cause;
+    const bool triggered = checkTriggers(estimation, cause);
+
+    if (m_capturing) {
+        if (index + 1 < m_capture.endIndex) {
+            return;
+        }
+        m_capturing = false;
+        if (m_config.writeOnRecordingThread) {
+            write(m_capture);
+            return;
+        }
+        const auto tail = m_queueTail.load(std::memory_order_relaxed);
+        if (tail - m_queueHead.load(std::memory_order_acquire) >= QueueCapacity) {
+            m_metrics.droppedCaptures->add();
+            return;
+        }
+        m_queue[tail % QueueCapacity] = m_capture;
+        m_queueTail.store(tail + 1, std::memory_order_release);
+        return;
+    }
+
+    if (triggered) {
+        m_capturing = true;
+        m_capture.firstIndex = index >= m_preTriggerSamples ? index - m_preTriggerSamples : 0;
+        m_capture.triggerIndex = index;
+        m_capture.endIndex = index + 1 + m_postTriggerSamples;
+        m_capture.cause = cause;
+        m_capture.triggerUsec = sample.timestampUsec;
+        m_metrics.triggers[cause]->add();
+    }
+}
+
+bool FlightRecorder::checkTriggers(const Estimation &estimation, FlightTrigger &cause)
+{
+    bool triggered = false;
+    if (m_manualTrigger.exchange(false, std::memory_order_relaxed)) {
+        cause = ManualTrigger;
+        triggered = true;
+    }
+
+    /// Magnitudes against their exponential averages, which start at the first estimation of a
+    /// full window
+    const auto count = m_written.load(std::memory_order_relaxed);
+    if (count <= m_windowSamples) {
+        return triggered;
+    }
+    const bool first = count == m_windowSamples + 1;
+    const bool warm = count > m_windowSamples + m_warmUpSamples;
+    for (size_t i = 0; i < CountSignals; ++i) {
+        const auto magnitude = std::abs(estimation.phasors[i]);
+        auto &reference = m_references[i];
+        if (first) {
+            reference = magnitude;
+        }
+        if (warm && !triggered && m_config.magnitudeStep > 0
+            && std::abs(magnitude - reference)
+                    > m_config.magnitudeStep * std::max(reference, m_config.minMagnitude)) {
+            cause = MagnitudeStepTrigger;
+            triggered = true;
+        }
+        reference += m_referenceWeight * (magnitude - reference);
+    }
+
+    /// A frequency of 0 is not estimated yet (its window is longer than the phasors')
+    if (warm && !triggered && m_config.frequencyDeviation > 0) {
+        for (auto signal : SignalsOfType[VoltageSignal]) {
+            const auto frequency = estimation.frequencies[signal];
+            if (m_references[signal] >= m_config.minMagnitude && frequency > 0
+                && std::abs(frequency - m_config.nominalFrequency)
+                        > m_config.frequencyDeviation) {
+                cause = FrequencyTrigger;
+                triggered = true;
+                break;
+            }
+        }
+    }
+    return triggered;
+}
+
+void FlightRecorder::run()
+{
+    QPMU_TRACE_THREAD_NAME("flight recorder");
+    bool stop = false;
+    while (!stop) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait_for(lock, PollInterval, [this] { return m_stopRequested; });
+            stop = m_stopRequested;
+        }
+
+        auto head = m_queueHead.load(std::memory_order_relaxed);
+        while (head != m_queueTail.load(std::memory_order_acquire)) {
+            write(m_queue[head % QueueCapacity]);
+            m_queueHead.store(++head, std::memory_order_release);
+        }
+    }
+}
+
+void FlightRecorder::write(const Capture &capture)
+{
+    QPMU_TRACE_SCOPE("flight recorder write");
+
+    ComtradeRecording recording;
+    recording.stationName = m_config.stationName;
+    recording.deviceId = std::to_string(m_config.idCode);
+    recording.nominalFrequency = m_config.nominalFrequency;
+    recording.samplingRate = m_config.samplingRate;
+    std::copy(std::begin(m_config.channelScales), std::end(m_config.channelScales),
+              recording.channelScales);
+    std::copy(std::begin(m_config.channelOffsets), std::end(m_config.channelOffsets),
+              recording.channelOffsets);
+
+    auto &samples = recording.samples;
+    samples.resize(capture.endIndex - capture.firstIndex);
+    for (auto i = capture.firstIndex; i < capture.endIndex; ++i) {
+        const auto &slot = m_ring[i % m_capacity];
+        auto &sample = samples[i - capture.firstIndex];
+        sample.timeUsec = slot.timeUsec.load(std::memory_order_relaxed);
+        unpackChannels(slot.channels[0].load(std::memory_order_relaxed), sample.channels, 4);
+        unpackChannels(slot.channels[1].load(std::memory_order_relaxed), sample.channels + 4,
+                       CountSignals - 4);
+    }
+
+    /// Drop the samples whose slots were reused while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto written = m_written.load(std::memory_order_relaxed);
+    auto first = capture.firstIndex;
+    if (written + 1 > first + m_capacity) {
+        const auto overwritten = std::min<uint64_t>(written + 1 - m_capacity - first,
+                                                    samples.size());
+        samples.erase(samples.begin(), samples.begin() + overwritten);
+        first += overwritten;
+    }
+    if (samples.empty() || capture.triggerIndex < first) {
+        m_metrics.droppedCaptures->add();
+        return;
+    }
+    recording.triggerIndex = capture.triggerIndex - first;
+
+    const auto basePath = (std::filesystem::path(m_config.directory)
+                           / captureName(m_config.idCode, capture.triggerUsec, capture.cause))
+                                  .string();
+    std::string error;
+    if (!writeComtrade(basePath, recording, error)) {
+        m_metrics.writeErrors->add();
+        reportError(error);
+        return;
+    }
+    m_metrics.captures->add();
+}
+
+void FlightRecorder::reportError(const std::string &error)
+{
+    if (m_onError) {
+        m_onError(error);
+    }
+}
+
+} // namespace qpmu
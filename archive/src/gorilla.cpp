@@ -0,0 +1,263 @@
+#include "qpmu/gorilla.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace qpmu {
+
+namespace {
+
+int countLeadingZeros(uint64_t x)
+{
+    if (x == 0) {
+        return 64;
+    }
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    for (uint64_t mask = uint64_t(1) << 63; !(x & mask); mask >>= 1) {
+        ++n;
+    }
+    return n;
+#endif
+}
+
+int countTrailingZeros(uint64_t x)
+{
+    if (x == 0) {
+        return 64;
+    }
+#if defined(__GNUC__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+inline uint64_t lowBits(int count)
+{
+    return (count >= 64) ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+}
+
+/// Sign-extends the low `count` bits
+inline int64_t signExtend(uint64_t value, int count)
+{
+    const auto sign = uint64_t(1) << (count - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+inline uint64_t toBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline double fromBits(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+void BitWriter::write(uint64_t value, int count)
+{
+    assert(count >= 0 && count <= 64);
+    if (count == 0) {
+        return;
+    }
+    /// Callers pass sign-extended values, e.g. a negative delta-of-delta in 7 bits
+    value &= lowBits(count);
+    m_bitCount += count;
+    m_synced = false;
+
+    const int free = 64 - m_wordBits;
+    if (count < free) {
+        m_word = (m_word << count) | value;
+        m_wordBits += count;
+        return;
+    }
+
+    /// Fill the word and append it; the rest of the value starts the next one
+    const int rest = count - free;
+    const auto word = (m_wordBits == 0 ? 0 : m_word << free) | (value >> rest);
+    m_bytes.resize((m_bitCount - count - m_wordBits) / 8);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        m_bytes.push_back((uint8_t)(word >> shift));
+    }
+    m_word = value & lowBits(rest);
+    m_wordBits = rest;
+}
+
+const std::vector<uint8_t> &BitWriter::bytes() const
+{
+    if (!m_synced) {
+        m_bytes.resize((m_bitCount - m_wordBits) / 8);
+        const auto tail = m_word << (64 - m_wordBits);
+        for (int i = 0; i < (m_wordBits + 7) / 8; ++i) {
+            m_bytes.push_back((uint8_t)(tail >> (56 - 8 * i)));
+        }
+        m_synced = true;
+    }
+    return m_bytes;
+}
+
+void BitWriter::clear()
+{
+    m_bytes.clear();
+    m_synced = true;
+    m_bitCount = 0;
+    m_word = 0;
+    m_wordBits = 0;
+}
+
+uint64_t BitReader::readAcrossWords(int count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    /// The rest of the current word, then the first bits of the next one
+    const int first = m_wordBits;
+    const auto high = first == 0 ? 0 : m_word >> (64 - first);
+    const int rest = count - first;
+
+    m_word = 0;
+    const auto available = std::min<size_t>(8, m_size - m_offset);
+    for (size_t i = 0; i < available; ++i) {
+        m_word |= (uint64_t)m_data[m_offset + i] << (56 - 8 * i);
+    }
+    m_offset += available;
+    m_wordBits = 8 * (int)available;
+
+    /// Past the end, the word is padded with zeros
+    if (rest > m_wordBits) {
+        m_overrun = true;
+        m_wordBits = rest;
+    }
+    const auto low = m_word >> (64 - rest);
+    m_word = rest < 64 ? m_word << rest : 0;
+    m_wordBits -= rest;
+    return rest == 64 ? low : (high << rest) | low;
+}
+
+void TimestampEncoder::append(int64_t timeUsec)
+{
+    if (m_count++ == 0) {
+        m_out->write((uint64_t)timeUsec, 64);
+        m_previous = timeUsec;
+        return;
+    }
+
+    const int64_t delta = timeUsec - m_previous;
+    const int64_t dod = delta - m_previousDelta;
+    m_previous = timeUsec;
+    m_previousDelta = delta;
+
+    if (dod == 0) {
+        m_out->write(0b0, 1);
+    } else if (dod >= -64 && dod <= 63) {
+        m_out->write(0b10, 2);
+        m_out->write((uint64_t)dod, 7);
+    } else if (dod >= -256 && dod <= 255) {
+        m_out->write(0b110, 3);
+        m_out->write((uint64_t)dod, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        m_out->write(0b1110, 4);
+        m_out->write((uint64_t)dod, 12);
+    } else {
+        m_out->write(0b1111, 4);
+        m_out->write((uint64_t)dod, 64);
+    }
+}
+
+int64_t TimestampDecoder::next()
+{
+    if (m_count++ == 0) {
+        m_previous = (int64_t)m_in->read(64);
+        return m_previous;
+    }
+
+    int64_t dod = 0;
+    if (!m_in->readBit()) {
+        dod = 0;
+    } else if (!m_in->readBit()) {
+        dod = signExtend(m_in->read(7), 7);
+    } else if (!m_in->readBit()) {
+        dod = signExtend(m_in->read(9), 9);
+    } else if (!m_in->readBit()) {
+        dod = signExtend(m_in->read(12), 12);
+    } else {
+        dod = (int64_t)m_in->read(64);
+    }
+
+    m_previousDelta += dod;
+    m_previous += m_previousDelta;
+    return m_previous;
+}
+
+void FloatEncoder::append(double value)
+{
+    const auto bits = toBits(value);
+    if (m_count++ == 0) {
+        m_out->write(bits, 64);
+        m_previous = bits;
+        return;
+    }
+
+    const auto x = bits ^ m_previous;
+    m_previous = bits;
+    if (x == 0) {
+        m_out->write(0b0, 1);
+        return;
+    }
+
+    /// The leading zero count is written in 5 bits, so at most 31 of them are skipped
+    int leading = std::min(countLeadingZeros(x), 31);
+    int trailing = countTrailingZeros(x);
+    if (m_leading >= 0 && leading >= m_leading && trailing >= m_trailing) {
+        m_out->write(0b10, 2);
+        m_out->write(x >> m_trailing, 64 - m_leading - m_trailing);
+        return;
+    }
+
+    const int length = 64 - leading - trailing;
+    m_out->write(0b11, 2);
+    m_out->write((uint64_t)leading, 5);
+    m_out->write((uint64_t)(length - 1), 6);
+    m_out->write(x >> trailing, length);
+    m_leading = leading;
+    m_trailing = trailing;
+}
+
+double FloatDecoder::next()
+{
+    if (m_count++ == 0) {
+        m_previous = m_in->read(64);
+        return fromBits(m_previous);
+    }
+
+    if (!m_in->readBit()) {
+        return fromBits(m_previous);
+    }
+    if (m_in->readBit()) {
+        m_leading = (int)m_in->read(5);
+        const int length = (int)m_in->read(6) + 1;
+        m_trailing = 64 - m_leading - length;
+    }
+    const int length = 64 - m_leading - m_trailing;
+    const auto x = (m_in->read(length) & lowBits(length)) << m_trailing;
+    m_previous ^= x;
+    return fromBits(m_previous);
+}
+
+} // namespace qpmu
@@ -7,7 +7,12 @@ find_package(
   QT REQUIRED
   NAMES Qt6 Qt5
 )
+# The daemon needs only Core and Network; the GUI stack is needed only by the app
+set(QT_COMPONENTS Core Network)
+if(BUILD_APP)
+  list(APPEND QT_COMPONENTS Gui Widgets Charts)
+endif()
 find_package(
   Qt${QT_VERSION_MAJOR} REQUIRED
-  COMPONENTS Core Gui Widgets Charts Network
+  COMPONENTS ${QT_COMPONENTS}
 )
@@ -0,0 +1,86 @@
+#ifndef QPMU_COMMON_AGGREGATION_H
+#define QPMU_COMMON_AGGREGATION_H
+
+#include "qpmu/defs.h"
+#include "qpmu/reporting.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// @brief Collects the estimations that several stations report for the same instant, so that
+/// they are sent together in one multi-station data frame.
+///
+/// The stations run in separate pipelines, so their estimations for an instant arrive in any
+/// order. A few instants are kept open at once; an instant is released as soon as every station
+/// has reported it, or, when a newer instant needs its slot, with the missing stations marked.
+/// Instants are released in time order: the open instants older than one that completes are
+/// released, incomplete, before it. An aggregator serves a single reporting rate.
+class StationAggregator
+{
+public:
+    /// Number of instants that may be open at once
+    static constexpr size_t Depth = 4;
+
+    struct Aggregate
+    {
+        ReportingInstant instant = {};
+        std::vector<Estimation> estimations = {};
+        /// Whether each station has reported the instant
+        std::vector<uint8_t> present = {};
+        /// Input health flags of each station's instant
+        std::vector<uint32_t> inputFlags = {};
+        size_t countPresent = 0;
+
+        bool complete() const { return countPresent == present.size(); }
+    };
+
+    struct Stats
+    {
+        /// Instants released with every station
+        uint64_t completeInstants = 0;
+        /// Instants released with some stations missing
+        uint64_t incompleteInstants = 0;
+        /// Estimations discarded because their instant was already released
+        uint64_t lateEstimations = 0;
+    };
+
+    explicit StationAggregator(size_t countStations = 1);
+
+    /// Stores a station's estimation. Returns the instants released by it, oldest first: the
+    /// completed one and the older open ones before it, or one evicted for lack of slots. The
+    /// result is valid until the next call.
+    const std::vector<const Aggregate *> &add(size_t station, const ReportingInstant &instant,
+                                              const Estimation &estimation);
+
+    size_t countStations() const { return m_countStations; }
+    const Stats &stats() const { return m_stats; }
+
+private:
+    void open(Aggregate &slot, const ReportingInstant &instant);
+
+    /// Releases the open instants older than `timeUsec`, oldest first, as incomplete
+    void releaseOlder(int64_t timeUsec);
+
+    size_t m_countStations = 1;
+    std::array<Aggregate, Depth> m_slots = {};
+    std::array<bool, Depth> m_used = {};
+
+    /// Holds an evicted instant while its slot is reused
+    Aggregate m_evicted = {};
+
+    /// Instants released by the last call to `add()`
+    std::vector<const Aggregate *> m_released = {};
+
+    /// Time of the newest released instant; estimations at or before it are late
+    int64_t m_releasedUsec = INT64_MIN;
+
+    Stats m_stats = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_AGGREGATION_H
@@ -0,0 +1,26 @@
+#ifndef QPMU_COMMON_CLOCK_H
+#define QPMU_COMMON_CLOCK_H
+
+#include <cstdint>
+
+namespace qpmu {
+
+/// Current time of the pipeline and the server (in microseconds since epoch): the system clock,
+/// or the virtual clock once it is enabled
+int64_t currentTimeUsec();
+
+/// @brief Virtual clock of simulations: it stands still between samples, and the acquisition
+/// advances it to the timestamp of every sample it processes, so that a recorded input runs as
+/// fast as it can be processed and every timestamp derived from the clock repeats on every run.
+///
+/// Enable it before starting the threads that read the time; it is process-wide and cannot be
+/// disabled again.
+void enableVirtualClock();
+bool virtualClockEnabled();
+
+/// Moves the virtual clock forward to the time, if it is later; no-op on the system clock
+void advanceVirtualClock(int64_t timeUsec);
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_CLOCK_H
@@ -0,0 +1,159 @@
+#ifndef QPMU_COMMON_ESTIMATION_PACKET_H
+#define QPMU_COMMON_ESTIMATION_PACKET_H
+
+/// Layout of the datagrams of the internal estimation feed (see `EstimationFeed`), a compact
+/// alternative to C37.118 for dashboards and recorders on the local network, and the detection
+/// of lost packets from their sequence numbers.
+///
+/// This header stands alone -- it needs neither the rest of qpmu nor its build definitions -- so
+/// that receivers can copy it into their own trees. A datagram is one packet of `Size` bytes, all
+/// fields little-endian:
+///
+///     offset  size  field
+///          0     4  magic "QEF1"
+///          4     2  layout version (1)
+///          6     2  ID code of the station
+///          8     8  sequence number of the station's packets, from 0
+///         16     8  timestamp of the estimation's sample (microseconds since the epoch)
+///         24    48  phasors VA, VB, VC, IA, IB, IC as (real, imaginary) float32
+///         72    24  frequencies (Hz), float32
+///         96    24  ROCOFs (Hz/s), float32
+///        120     4  sampling rate (Hz), float32
+///        124     4  reserved (0)
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace qpmu {
+
+struct EstimationPacket
+{
+    static constexpr size_t Size = 128;
+    static constexpr uint32_t Magic = 0x31464551; // "QEF1" in little-endian order
+    static constexpr uint16_t LayoutVersion = 1;
+    static constexpr size_t Signals = 6;
+
+    uint16_t idCode = 0;
+    uint64_t sequence = 0;
+    int64_t timestampUsec = 0;
+    float phasors[Signals][2] = {};
+    float frequencies[Signals] = {};
+    float rocofs[Signals] = {};
+    float samplingRate = 0;
+
+    /// Writes the packet into `Size` bytes
+    void encode(uint8_t *data) const
+    {
+        size_t offset = 0;
+        auto put = [&](uint64_t value, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                data[offset++] = (uint8_t)(value >> (8 * i));
+            }
+        };
+        auto putFloat = [&](float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put(bits, 4);
+        };
+        put(Magic, 4);
+        put(LayoutVersion, 2);
+        put(idCode, 2);
+        put(sequence, 8);
+        put((uint64_t)timestampUsec, 8);
+        for (const auto &phasor : phasors) {
+            putFloat(phasor[0]);
+            putFloat(phasor[1]);
+        }
+        for (auto value : frequencies) {
+            putFloat(value);
+        }
+        for (auto value : rocofs) {
+            putFloat(value);
+        }
+        putFloat(samplingRate);
+        put(0, 4);
+    }
+
+    /// Reads a packet from a datagram; returns false if it is not one of this layout
+    bool decode(const uint8_t *data, size_t size)
+    {
+        if (size != Size) {
+            return false;
+        }
+        size_t offset = 0;
+        auto get = [&](size_t size) {
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; ++i) {
+                value |= (uint64_t)data[offset++] << (8 * i);
+            }
+            return value;
+        };
+        auto getFloat = [&]() {
+            const auto bits = (uint32_t)get(4);
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        };
+        if (get(4) != Magic || get(2) != LayoutVersion) {
+            return false;
+        }
+        idCode = (uint16_t)get(2);
+        sequence = get(8);
+        timestampUsec = (int64_t)get(8);
+        for (auto &phasor : phasors) {
+            phasor[0] = getFloat();
+            phasor[1] = getFloat();
+        }
+        for (auto &value : frequencies) {
+            value = getFloat();
+        }
+        for (auto &value : rocofs) {
+            value = getFloat();
+        }
+        samplingRate = getFloat();
+        return true;
+    }
+};
+
+/// @brief Counts the packets of one station that never arrived, or arrived out of order, from
+/// their sequence numbers.
+struct EstimationPacketTracker
+{
+    uint64_t received = 0;
+    /// Packets skipped by the sequence numbers, less those that arrived late
+    uint64_t lost = 0;
+    /// Packets older than one already received: late, or duplicated
+    uint64_t reordered = 0;
+    /// Times the sender restarted, i.e. its sequence went back to 0
+    uint64_t restarts = 0;
+
+    /// Updates the counts with a received packet; returns the packets lost just before it
+    uint64_t update(uint64_t sequence)
+    {
+        uint64_t skipped = 0;
+        if (received == 0) {
+            m_next = sequence;
+        } else if (sequence == 0 && m_next > 1) {
+            ++restarts;
+            m_next = 0;
+        }
+        if (sequence >= m_next) {
+            skipped = sequence - m_next;
+            lost += skipped;
+            m_next = sequence + 1;
+        } else {
+            ++reordered;
+            lost -= lost > 0 ? 1 : 0;
+        }
+        ++received;
+        return skipped;
+    }
+
+private:
+    uint64_t m_next = 0;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_ESTIMATION_PACKET_H
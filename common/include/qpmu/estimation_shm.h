@@ -0,0 +1,237 @@
+#ifndef QPMU_COMMON_ESTIMATION_SHM_H
+#define QPMU_COMMON_ESTIMATION_SHM_H
+
+/// Layout of the shared-memory estimation rings that a station publishes to (see
+/// `EstimationPublisher`), and a reader of them for co-located consumers, e.g., protection logic
+/// or a Modbus gateway.
+///
+/// This header stands alone -- it needs neither the rest of qpmu nor its build definitions -- so
+/// that consumers can copy it into their own trees:
+///
+///     qpmu::EstimationShmReader reader;
+///     std::string error;
+///     if (!reader.open("/qpmu-estimations-1", error)) { ... }
+///     qpmu::EstimationShmRecord record;
+///     while (running) {
+///         if (reader.readNext(record)) { ... } // or readLatest(record)
+///     }
+///
+/// Each slot of the ring is a seqlock: the publisher makes the slot's version odd, writes the
+/// record, and makes it even again. A reader copies the record between two loads of the version
+/// and keeps the copy only if the version did not change, so reading takes no lock and no system
+/// call, only a copy of about 128 bytes, and a slow reader never delays the publisher.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __unix__
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace qpmu {
+
+/// Number of signals of a record: VA, VB, VC, IA, IB, IC
+constexpr size_t EstimationShmSignals = 6;
+
+/// One published estimation, in a fixed layout of single-precision values
+struct EstimationShmRecord
+{
+    /// Publication sequence number of the station, from 0, with no gaps
+    uint64_t sequence;
+    /// Sequence number of the sample the estimation is of
+    uint64_t sampleSequence;
+    /// Timestamp of that sample (in microseconds since the epoch)
+    int64_t timestampUsec;
+    /// Raw phasors as (real, imaginary)
+    float phasors[EstimationShmSignals][2];
+    /// Frequencies (in Hz) and ROCOFs (in Hz/s)
+    float frequencies[EstimationShmSignals];
+    float rocofs[EstimationShmSignals];
+    float samplingRate;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(EstimationShmRecord) == 128, "The record layout must not change");
+
+/// A slot of the ring. Its version is `2 * (sequence + 1)` once the record of `sequence` is
+/// complete, and odd while a record is being written.
+struct alignas(64) EstimationShmSlot
+{
+    std::atomic<uint64_t> version;
+    EstimationShmRecord record;
+};
+
+/// Start of the shared memory, followed by `capacity` slots
+struct alignas(64) EstimationShmHeader
+{
+    static constexpr uint32_t Magic = 0x51455354; // "QEST"
+    static constexpr uint32_t LayoutVersion = 1;
+
+    uint32_t magic;
+    uint32_t layoutVersion;
+    uint32_t slotSize;
+    uint32_t capacity;
+    /// ID code of the publishing station
+    uint32_t idCode;
+    /// Set when the publisher has closed the ring; a new publisher creates a new one
+    std::atomic<uint32_t> closed;
+
+    /// Records published so far; the newest has sequence `published - 1`
+    alignas(64) std::atomic<uint64_t> published;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The ring's counts must be lock-free to be shared between processes");
+
+/// @brief Reader of a station's estimation ring. Not thread-safe: use one reader per thread.
+class EstimationShmReader
+{
+public:
+    EstimationShmReader() = default;
+    ~EstimationShmReader() { close(); }
+
+    EstimationShmReader(const EstimationShmReader &) = delete;
+    EstimationShmReader &operator=(const EstimationShmReader &) = delete;
+
+    /// Maps the ring `name` (e.g., "/qpmu-estimations-1"). Returns false with the reason in
+    /// `error`. `readNext()` starts from the newest record.
+    bool open(const std::string &name, std::string &error)
+    {
+        close();
+#ifdef __unix__
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            error = "Failed to open the shared memory " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat status;
+        void *data = MAP_FAILED;
+        size_t bytes = 0;
+        if (::fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(EstimationShmHeader)) {
+            bytes = (size_t)status.st_size;
+            data = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error = "Failed to map the shared memory " + name;
+            return false;
+        }
+        auto header = (const EstimationShmHeader *)data;
+        if (header->magic != EstimationShmHeader::Magic
+            || header->layoutVersion != EstimationShmHeader::LayoutVersion
+            || header->slotSize != sizeof(EstimationShmSlot) || header->capacity == 0
+            || bytes < sizeof(EstimationShmHeader)
+                            + (size_t)header->capacity * sizeof(EstimationShmSlot)) {
+            ::munmap(data, bytes);
+            error = "The shared memory " + name + " is not an estimation ring of this layout";
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        m_header = header;
+        m_slots = (const EstimationShmSlot *)(header + 1);
+        m_mappedBytes = bytes;
+        m_next = published();
+        m_lost = 0;
+        return true;
+#else
+        (void)name;
+        error = "Shared memory estimation rings are only supported on POSIX systems";
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifdef __unix__
+        if (m_header) {
+            ::munmap((void *)m_header, m_mappedBytes);
+        }
+#endif
+        m_header = nullptr;
+        m_slots = nullptr;
+        m_mappedBytes = 0;
+    }
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    /// Whether the publisher has closed the ring; reopen it to follow a restarted publisher
+    bool isClosed() const { return m_header->closed.load(std::memory_order_acquire) != 0; }
+
+    uint32_t idCode() const { return m_header->idCode; }
+    size_t capacity() const { return m_header->capacity; }
+
+    /// Number of records published so far
+    uint64_t published() const { return m_header->published.load(std::memory_order_acquire); }
+
+    /// Copies the newest record; returns false if nothing has been published yet
+    bool readLatest(EstimationShmRecord &record) const
+    {
+        for (;;) {
+            const auto count = published();
+            if (count == 0) {
+                return false;
+            }
+            if (read(count - 1, record)) {
+                return true;
+            }
+            /// Overwritten while copying: the newest record is newer still
+        }
+    }
+
+    /// Copies the record after the last one read. Returns false if there is none yet. Records
+    /// that were overwritten before they were read are skipped, and counted by `lost()`.
+    bool readNext(EstimationShmRecord &record)
+    {
+        for (;;) {
+            const auto count = published();
+            if (m_next >= count) {
+                return false;
+            }
+            if (count - m_next > capacity()) {
+                m_lost += count - capacity() - m_next;
+                m_next = count - capacity();
+            }
+            if (read(m_next, record)) {
+                ++m_next;
+                return true;
+            }
+            /// Overwritten while copying
+            ++m_lost;
+            ++m_next;
+        }
+    }
+
+    /// Records skipped by `readNext()` because they were overwritten first
+    uint64_t lost() const { return m_lost; }
+
+private:
+    /// Copies the record of `sequence`; returns false if it is no longer (or not yet) in its slot
+    bool read(uint64_t sequence, EstimationShmRecord &record) const
+    {
+        const auto &slot = m_slots[sequence % m_header->capacity];
+        const auto version = 2 * (sequence + 1);
+        if (slot.version.load(std::memory_order_acquire) != version) {
+            return false;
+        }
+        std::memcpy((void *)&record, (const void *)&slot.record, sizeof(record));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.version.load(std::memory_order_relaxed) == version;
+    }
+
+    const EstimationShmHeader *m_header = nullptr;
+    const EstimationShmSlot *m_slots = nullptr;
+    size_t m_mappedBytes = 0;
+    uint64_t m_next = 0;
+    uint64_t m_lost = 0;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_ESTIMATION_SHM_H
@@ -0,0 +1,64 @@
+#ifndef QPMU_COMMON_FRAME_ASSEMBLER_H
+#define QPMU_COMMON_FRAME_ASSEMBLER_H
+
+#include "qpmu/frames.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace qpmu {
+
+/// @brief Extracts complete C37.118 frames from a byte stream that arrives in arbitrary chunks,
+/// e.g., partial or coalesced TCP reads.
+///
+/// Frames are delimited by their FRAMESIZE field and accepted only if their SYNC word is valid and
+/// their CHK word matches. On garbage or a corrupt frame, the assembler skips ahead to the next
+/// SYNC byte. A frame still waiting for the bytes its FRAMESIZE claims is abandoned as soon as a
+/// complete, valid frame follows it, so a corrupt FRAMESIZE does not stall the stream. All bytes
+/// live in a fixed buffer, so nothing is allocated.
+class FrameAssembler
+{
+public:
+    /// Largest frame that can be assembled; longer ones are skipped
+    static constexpr size_t Capacity = 2048;
+
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t skippedBytes = 0;
+        uint64_t crcErrors = 0;
+        uint64_t oversizedFrames = 0;
+    };
+
+    /// Returns the free space at the end of the buffer, to read into directly, after moving the
+    /// pending bytes to the front
+    uint8_t *prepare(size_t &space);
+
+    /// Marks `size` bytes written into the space returned by `prepare()` as received
+    void commit(size_t size);
+
+    /// Copies as many bytes as fit into the buffer; returns the number copied
+    size_t push(const uint8_t *data, size_t size);
+
+    /// Extracts the next complete frame, if there is one. The frame stays valid until the next
+    /// call to `prepare()` or `push()`.
+    bool next(const uint8_t *&frame, size_t &size);
+
+    const Stats &stats() const { return m_stats; }
+
+private:
+    void skip(size_t count);
+
+    /// Offset of the first complete, valid frame after the start of `data`; 0 if there is none
+    static size_t nextCompleteFrame(const uint8_t *data, size_t size);
+
+    std::array<uint8_t, Capacity> m_buffer = {};
+    size_t m_begin = 0;
+    size_t m_end = 0;
+    Stats m_stats = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_FRAME_ASSEMBLER_H
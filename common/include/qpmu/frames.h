@@ -0,0 +1,140 @@
+#ifndef QPMU_COMMON_FRAMES_H
+#define QPMU_COMMON_FRAMES_H
+
+#include "qpmu/defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// Size of the common frame header: SYNC, FRAMESIZE, IDCODE, SOC and FRACSEC
+constexpr size_t FrameHeaderSize = 14;
+
+/// Size of the CHK word that terminates every frame
+constexpr size_t FrameChecksumSize = 2;
+
+/// Types of frames, from bits 6-4 of the second SYNC byte
+enum FrameType {
+    DataFrameType = 0,
+    HeaderFrameType = 1,
+    Config1FrameType = 2,
+    Config2FrameType = 3,
+    CommandFrameType = 4,
+    Config3FrameType = 5,
+};
+
+/// First SYNC byte of every frame
+constexpr uint8_t FrameSyncByte = 0xAA;
+
+inline uint16_t readU16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+inline uint32_t readU32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline FrameType frameType(const uint8_t *frame)
+{
+    return (FrameType)((frame[1] >> 4) & 0x07);
+}
+
+/// Whether the SYNC word of a frame is valid: the SYNC byte, then a zero bit, a frame type of
+/// 0-5, and a version of 1 (C37.118-2005) or 2 (C37.118.2-2011)
+inline bool validSync(const uint8_t *frame)
+{
+    const auto version = frame[1] & 0x0F;
+    return frame[0] == FrameSyncByte && (frame[1] & 0x80) == 0
+            && frameType(frame) <= Config3FrameType && (version == 1 || version == 2);
+}
+
+/// Size of a frame as given by its FRAMESIZE field
+inline uint16_t frameSize(const uint8_t *frame)
+{
+    return readU16(frame + 2);
+}
+
+/// The CMD word of a command frame
+inline uint16_t frameCommand(const uint8_t *frame)
+{
+    return readU16(frame + FrameHeaderSize);
+}
+
+/// CRC-CCITT (polynomial 0x1021, initial value 0xFFFF) used for the CHK word of C37.118 frames,
+/// computed a byte at a time from a lookup table. Passing the CRC of preceding bytes as `crc`
+/// continues it over `data`.
+uint16_t crcCcitt(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF);
+
+/// @brief Layout of one PMU station's block in a data frame, as declared by the FORMAT word and
+/// the channel counts of the configuration frame.
+struct StationLayout
+{
+    uint16_t countPhasors = 0;
+    uint16_t countAnalogs = 0;
+    uint16_t countDigitals = 0;
+
+    /// FORMAT bit 0: polar (true) or rectangular (false) phasors
+    bool polarPhasors = false;
+    /// FORMAT bit 1: floating point (true) or 16-bit integer (false) phasors
+    bool floatPhasors = true;
+    /// FORMAT bit 2: floating point (true) or 16-bit integer (false) analogs
+    bool floatAnalogs = true;
+    /// FORMAT bit 3: floating point (true) or 16-bit integer (false) FREQ/DFREQ
+    bool floatFrequency = true;
+
+    /// Nominal frequency (in Hz), needed for integer FREQ which is the deviation from it
+    Float nominalFrequency = 50;
+
+    size_t phasorSize() const { return floatPhasors ? 8 : 4; }
+    size_t frequencySize() const { return floatFrequency ? 4 : 2; }
+    size_t size() const
+    {
+        return 2 + countPhasors * phasorSize() + 2 * frequencySize()
+                + countAnalogs * (floatAnalogs ? 4 : 2) + countDigitals * 2;
+    }
+};
+
+/// @brief Serializes C37.118 data frames into a buffer that is allocated once.
+///
+/// The frame is first loaded from a template (e.g., a frame packed once by the C37.118 library),
+/// which fixes the constant fields -- SYNC, FRAMESIZE, IDCODE, STAT, analogs and digitals. Each
+/// reported frame then only overwrites the fields that change, in place, and recomputes the CHK
+/// word, so no memory is allocated per frame.
+class DataFrameWriter
+{
+public:
+    DataFrameWriter() = default;
+    explicit DataFrameWriter(const std::vector<StationLayout> &stations);
+
+    /// Copies the constant fields from a complete frame. Returns false if its size does not match
+    /// the layout.
+    bool loadTemplate(const uint8_t *frame, size_t size);
+
+    bool isLoaded() const { return m_loaded; }
+
+    void setTime(uint32_t soc, uint32_t fracsec);
+    void setStat(size_t station, uint16_t stat);
+    void setPhasor(size_t station, size_t index, const Complex &phasor);
+    void setFrequency(size_t station, Float frequency);
+    void setRocof(size_t station, Float rocof);
+
+    /// Writes the CHK word and returns the complete frame
+    const uint8_t *finish();
+
+    const uint8_t *data() const { return m_buffer.data(); }
+    size_t size() const { return m_buffer.size(); }
+
+private:
+    std::vector<StationLayout> m_stations = {};
+    std::vector<size_t> m_offsets = {};
+    std::vector<uint8_t> m_buffer = {};
+    bool m_loaded = false;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_FRAMES_H
@@ -0,0 +1,114 @@
+#ifndef QPMU_COMMON_INPUT_MONITOR_H
+#define QPMU_COMMON_INPUT_MONITOR_H
+
+#include "qpmu/defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// Problems found in the input stream, as a bitmask
+enum InputHealthFlag : uint32_t {
+    /// Samples are missing before this one (its sequence number skips ahead)
+    SampleGapFlag = 1 << 0,
+    /// The sample repeats or precedes one already seen
+    DuplicateSampleFlag = 1 << 1,
+    /// The interval since the previous sample is off the running mean by more than the tolerance
+    TimingJitterFlag = 1 << 2,
+    /// The mean sampling interval has drifted from the one measured after the warm-up by more
+    /// than the tolerance, or is far off the nominal one
+    RateDriftFlag = 1 << 3,
+};
+
+/// STAT bits for the input health flags: gaps and duplicates are a data error (bits 15-14 = 01),
+/// and jitter and drift of the sample clock a sync error (bit 13)
+uint16_t inputHealthStatBits(uint32_t flags);
+
+/// @brief Checks the sequence numbers and intervals of the incoming samples.
+///
+/// The estimator assumes that samples arrive without loss at the nominal rate; this monitor tells
+/// when they do not. It counts the samples missing from gaps in the sequence, the repeated ones,
+/// and the intervals that stray from the running mean, and tracks the drift of the mean interval
+/// (an exponential average over about one second). ADC clocks are commonly off their nominal
+/// rate by about a percent (e.g., 841 us instead of 833 us), which the estimator measures and
+/// follows, so drift is judged against the mean interval of the first second rather than the
+/// nominal one; only a mean off the nominal by more than `MaxNominalDriftPpm` is flagged as such.
+/// It is not thread-safe; it runs on the processing thread, and the flags it returns travel with
+/// the reports.
+class InputMonitor
+{
+public:
+    /// Drift from the nominal interval that is flagged whatever the tolerance
+    static constexpr Float MaxNominalDriftPpm = 50000;
+
+    /// Result of checking one sample
+    struct Check
+    {
+        /// `InputHealthFlag`s raised by the sample
+        uint32_t flags = 0;
+        /// Samples missing right before this one
+        uint64_t missingSamples = 0;
+        /// Interval since the previous sample (in microseconds), or -1 if unknown
+        int64_t intervalUsec = -1;
+    };
+
+    struct Stats
+    {
+        uint64_t samples = 0;
+        uint64_t gaps = 0;
+        uint64_t missingSamples = 0;
+        uint64_t duplicates = 0;
+        uint64_t jitteredIntervals = 0;
+        int64_t minIntervalUsec = 0;
+        int64_t maxIntervalUsec = 0;
+    };
+
+    /// `jitterTolerance` is a fraction of the nominal interval; `driftTolerancePpm` is in parts
+    /// per million of it
+    explicit InputMonitor(Float samplingRate = 1200, Float jitterTolerance = 0.1,
+                          Float driftTolerancePpm = 5000);
+
+    Check update(const Sample &sample);
+
+    Float nominalIntervalUsec() const { return m_nominalUsec; }
+    Float meanIntervalUsec() const { return m_meanUsec; }
+
+    /// Drift of the mean sampling interval from the nominal one (in parts per million); positive
+    /// when the samples come slower than nominal
+    Float driftPpm() const;
+
+    /// Mean interval at the end of the warm-up, which the drift is judged against; 0 before
+    Float baselineIntervalUsec() const { return m_baselineUsec; }
+
+    const Stats &stats() const { return m_stats; }
+
+    /// Upper bounds of the buckets for a histogram of the sampling intervals (in microseconds),
+    /// finer near the nominal interval
+    std::vector<int64_t> intervalBucketsUsec() const;
+
+private:
+    Float m_nominalUsec = 0;
+    Float m_jitterToleranceUsec = 0;
+    Float m_driftTolerancePpm = 0;
+
+    /// Weight of a new interval in the running mean, and the intervals seen before the drift is
+    /// judged
+    Float m_alpha = 0;
+    uint64_t m_warmup = 0;
+
+    Float m_meanUsec = 0;
+    Float m_baselineUsec = 0;
+    uint64_t m_countIntervals = 0;
+
+    uint64_t m_lastSeq = 0;
+    int64_t m_lastTimestampUsec = 0;
+    bool m_anySample = false;
+
+    Stats m_stats = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_INPUT_MONITOR_H
@@ -0,0 +1,61 @@
+#ifndef QPMU_COMMON_LATENCY_HISTOGRAM_H
+#define QPMU_COMMON_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace qpmu {
+
+/// @brief Lock-free histogram of latencies (in microseconds) with bounded relative error, in the
+/// manner of HdrHistogram.
+///
+/// Values below `SubBucketCount` are counted exactly; above, every power of two is split into
+/// `SubBucketCount` linear buckets, so a value is known to within 1/`SubBucketCount` (about 3%)
+/// over the whole range. Recording is a few relaxed atomic increments, safe from any thread;
+/// reads are not synchronized with writes, so a percentile taken while recording may be off by
+/// the values in flight.
+class LatencyHistogram
+{
+public:
+    /// log2 of the number of linear sub-buckets per power of two
+    static constexpr int SubBucketBits = 5;
+    static constexpr int64_t SubBucketCount = int64_t(1) << SubBucketBits;
+
+    /// Values from 2^`MaxExponent` on are counted in the last bucket
+    static constexpr int MaxExponent = 40;
+    static constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 1) * SubBucketCount;
+
+    LatencyHistogram();
+
+    /// Records a value; negative values (e.g., from clock adjustments) are recorded as 0
+    void record(int64_t value);
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    int64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+    int64_t max() const { return m_max.load(std::memory_order_relaxed); }
+    int64_t min() const;
+
+    /// Smallest value such that at least the given fraction (in [0, 1]) of the recorded values are
+    /// not above it, to within the bucket resolution; 0 if nothing has been recorded
+    int64_t percentile(double fraction) const;
+
+    void reset();
+
+    static size_t bucketIndex(int64_t value);
+
+    /// Largest value that falls into the bucket
+    static int64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets;
+    std::atomic<uint64_t> m_count = { 0 };
+    std::atomic<int64_t> m_sum = { 0 };
+    std::atomic<int64_t> m_min = { INT64_MAX };
+    std::atomic<int64_t> m_max = { 0 };
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_LATENCY_HISTOGRAM_H
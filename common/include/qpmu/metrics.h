@@ -0,0 +1,128 @@
+#ifndef QPMU_COMMON_METRICS_H
+#define QPMU_COMMON_METRICS_H
+
+#include "qpmu/latency_histogram.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+/// Monotonic count of events
+class Counter
+{
+public:
+    void add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_value = { 0 };
+};
+
+/// Value that goes up and down, e.g., a queue depth
+class Gauge
+{
+public:
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value = { 0 };
+};
+
+/// Distribution of integer values (e.g., latencies in microseconds) over fixed buckets
+class Histogram
+{
+public:
+    /// `bounds` are the inclusive upper bounds of the buckets, in increasing order; values above
+    /// the last bound fall into an implicit +Inf bucket
+    explicit Histogram(const std::vector<int64_t> &bounds);
+
+    void record(int64_t value);
+
+    struct Snapshot
+    {
+        std::vector<int64_t> bounds = {};
+        /// Count of each bucket (not cumulative); the last one is the +Inf bucket
+        std::vector<uint64_t> counts = {};
+        uint64_t count = 0;
+        int64_t sum = 0;
+    };
+
+    Snapshot snapshot() const;
+
+private:
+    std::vector<int64_t> m_bounds = {};
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts = {};
+    std::atomic<uint64_t> m_count = { 0 };
+    std::atomic<int64_t> m_sum = { 0 };
+};
+
+/// Bucket bounds for latencies, from 50 us to 1 s
+std::vector<int64_t> latencyBucketsUsec();
+
+/// @brief Named metrics of the process, rendered in the Prometheus text exposition format.
+///
+/// Metrics are created on first use, under a lock; the returned references stay valid for the
+/// lifetime of the registry, and updating them is lock-free, so hot paths look a metric up once
+/// and keep the reference. A metric is identified by its name and its labels, given as they are
+/// to appear between the braces, e.g., `station="0"`.
+class MetricsRegistry
+{
+public:
+    Counter &counter(const std::string &name, const std::string &help,
+                     const std::string &labels = std::string());
+    Gauge &gauge(const std::string &name, const std::string &help,
+                 const std::string &labels = std::string());
+    Histogram &histogram(const std::string &name, const std::string &help,
+                         const std::vector<int64_t> &bounds,
+                         const std::string &labels = std::string());
+
+    /// Exposed as a summary with the 0.5, 0.99 and 0.999 quantiles and the maximum (quantile 1)
+    LatencyHistogram &latency(const std::string &name, const std::string &help,
+                              const std::string &labels = std::string());
+
+    std::string renderPrometheus() const;
+
+    /// Table of count, p50/p99/p99.9 and maximum of every latency histogram
+    std::string renderLatencyReport() const;
+
+    /// The registry of the process
+    static MetricsRegistry &instance();
+
+private:
+    enum Type {
+        CounterType = 0,
+        GaugeType = 1,
+        HistogramType = 2,
+        LatencyType = 3,
+    };
+
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        std::string labels;
+        Type type;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::unique_ptr<LatencyHistogram> latency;
+    };
+
+    Entry &entry(const std::string &name, const std::string &help, const std::string &labels,
+                 Type type);
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Entry>> m_entries = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_METRICS_H
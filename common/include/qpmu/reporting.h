@@ -0,0 +1,107 @@
+#ifndef QPMU_COMMON_REPORTING_H
+#define QPMU_COMMON_REPORTING_H
+
+#include "qpmu/defs.h"
+
+#include <cstdint>
+
+namespace qpmu {
+
+/// @brief An IEEE C37.118 reporting instant, i.e., a time that is an exact multiple of
+/// `1 / reportingRate` seconds past the top of a second.
+struct ReportingInstant
+{
+    /// Second-of-century (UNIX epoch seconds)
+    uint32_t soc = {};
+
+    /// Fraction of the second, in units of `TimeDenom`
+    uint32_t fracsec = {};
+
+    /// Full timestamp of the instant (in microseconds since epoch)
+    int64_t timeUsec = {};
+
+    /// Index of the instant within its second, in `[0, reportingRate)`
+    uint32_t index = {};
+
+    /// Reporting rate (frames per second) the instant belongs to
+    uint32_t reportingRate = {};
+
+    /// Time of the sample that completed the instant, less the instant (in microseconds); the
+    /// estimation of that sample must be moved back by this much, see `rotateToInstant()`
+    int64_t offsetUsec = {};
+
+    /// Trace of the sample that completed the instant, in epoch microseconds: its acquisition
+    /// timestamp, when the pipeline took it from the input, and when the filtered estimation was
+    /// ready; zero when not traced
+    int64_t sampleUsec = {};
+    int64_t dequeuedUsec = {};
+    int64_t estimatedUsec = {};
+
+    /// `InputHealthFlag`s raised by the samples since the previous instant of the same rate
+    uint32_t inputFlags = {};
+};
+
+/// @brief Computes the C37.118 reporting instants for a given reporting rate, and decides, from
+/// the timestamps of the incoming samples, when the estimation for the next instant is ready.
+///
+/// The estimation for an instant is taken to be ready at the first sample whose timestamp is at
+/// or past that instant, so the scheduler is driven by the data path rather than a wall-clock
+/// timer.
+class ReportingScheduler
+{
+public:
+    explicit ReportingScheduler(uint32_t reportingRate);
+
+    uint32_t reportingRate() const { return m_reportingRate; }
+
+    /// The first reporting instant at or after the given time
+    ReportingInstant instantAtOrAfter(int64_t timeUsec) const;
+
+    /// The last reporting instant at or before the given time
+    ReportingInstant instantAtOrBefore(int64_t timeUsec) const;
+
+    /// Feeds the timestamp of a new sample. Returns true, and sets `instant`, if the sample is the
+    /// first one at or past the pending reporting instant; `instant.offsetUsec` is then how far
+    /// past it the sample is.
+    bool update(int64_t sampleTimeUsec, ReportingInstant &instant);
+
+    /// The reporting instant that is waiting for its estimation
+    const ReportingInstant &pendingInstant() const { return m_pending; }
+
+    /// Number of instants that were skipped because no sample arrived between them
+    uint64_t countMissedInstants() const { return m_countMissed; }
+
+private:
+    ReportingInstant makeInstant(int64_t sec, int64_t index) const;
+
+    uint32_t m_reportingRate = 0;
+    ReportingInstant m_pending = {};
+    bool m_started = false;
+    uint64_t m_countMissed = 0;
+};
+
+/// Moves the phasors of an estimation `offsetUsec` back in time, by rotating each by the phase
+/// its signal advances in that time: at the signal's estimated frequency, or at the nominal one
+/// while the estimate is implausible, i.e. off the nominal by half of it or more, as it is before
+/// the first estimate and while a filter ramps up from it. Frequencies and ROCOFs are kept.
+Estimation rotateToInstant(const Estimation &estimation, int64_t offsetUsec,
+                           Float nominalFrequency);
+
+/// @brief Running statistics of the delay between a reporting instant and the moment its frame
+/// was handed to the network.
+struct DispatchLatency
+{
+    int64_t lastUsec = 0;
+    int64_t minUsec = 0;
+    int64_t maxUsec = 0;
+    int64_t totalUsec = 0;
+    uint64_t count = 0;
+
+    void record(int64_t latencyUsec);
+
+    int64_t meanUsec() const { return count ? totalUsec / (int64_t)count : 0; }
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_REPORTING_H
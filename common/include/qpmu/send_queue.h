@@ -0,0 +1,100 @@
+#ifndef QPMU_COMMON_SEND_QUEUE_H
+#define QPMU_COMMON_SEND_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// @brief Bounded FIFO of outbound frames for one client.
+///
+/// The slots are allocated up front and reused, so queueing a frame no larger than the ones
+/// before it does not allocate. When the queue is full, the policy decides what happens to the
+/// incoming frame. Replies to commands go ahead of the data frames, and the policy drops data
+/// frames rather than them.
+class SendQueue
+{
+public:
+    enum Policy {
+        /// Discard the oldest queued frame to make room for the new one
+        DropOldest = 0,
+        /// Discard the new frame
+        DropNewest = 1,
+        /// Refuse the new frame, and let the owner disconnect the client
+        Disconnect = 2,
+    };
+
+    /// What became of a pushed frame
+    enum PushResult {
+        /// The frame was queued (under `DropOldest`, possibly in place of the oldest one)
+        Queued = 0,
+        /// The queue was full and the frame was discarded (`DropNewest`)
+        Dropped = 1,
+        /// The queue was full and the frame was refused; the client should be disconnected
+        Refused = 2,
+    };
+
+    struct Stats
+    {
+        /// Bytes and frames waiting in the queue
+        uint64_t queuedBytes = 0;
+        uint64_t queuedFrames = 0;
+
+        /// Frames discarded because the queue was full
+        uint64_t droppedFrames = 0;
+
+        /// Largest time a frame has spent in the queue before being sent (in microseconds), since
+        /// the last `resetMaxAge()`
+        int64_t maxAgeUsec = 0;
+    };
+
+    SendQueue() = default;
+    SendQueue(size_t capacityFrames, size_t frameSizeHint, Policy policy);
+
+    /// Queues a copy of the frame, or, when the queue is full, applies the policy
+    PushResult push(const uint8_t *data, size_t size, int64_t nowUsec);
+
+    /// Queues a copy of a reply to a command (e.g., a CONFIG frame) after the replies queued
+    /// before it but ahead of the data frames. When the queue is full, `DropOldest` and
+    /// `DropNewest` discard the oldest or newest data frame instead of the reply; only a queue
+    /// full of replies discards its oldest one. `Disconnect` refuses the reply.
+    PushResult pushReply(const uint8_t *data, size_t size, int64_t nowUsec);
+
+    bool empty() const { return m_count == 0; }
+    const uint8_t *frontData() const { return m_slots[m_head].bytes.data(); }
+    size_t frontSize() const { return m_slots[m_head].bytes.size(); }
+
+    /// Removes the front frame once it has been handed to the socket
+    void pop(int64_t nowUsec);
+
+    Policy policy() const { return m_policy; }
+    const Stats &stats() const { return m_stats; }
+
+    /// Starts a new interval of `Stats::maxAgeUsec`, e.g. once its value has been read
+    void resetMaxAge() { m_stats.maxAgeUsec = 0; }
+
+private:
+    struct Slot
+    {
+        std::vector<uint8_t> bytes = {};
+        int64_t enqueuedUsec = 0;
+    };
+
+    Slot &slot(size_t position) { return m_slots[(m_head + position) % m_slots.size()]; }
+
+    /// Discards the frame at `position`, which the following frames close up on
+    void drop(size_t position);
+
+    std::vector<Slot> m_slots = {};
+    size_t m_head = 0;
+    size_t m_count = 0;
+    /// Replies at the front of the queue
+    size_t m_countReplies = 0;
+    Policy m_policy = DropOldest;
+    Stats m_stats = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_SEND_QUEUE_H
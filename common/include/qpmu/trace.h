@@ -0,0 +1,140 @@
+#ifndef QPMU_COMMON_TRACE_H
+#define QPMU_COMMON_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// `QPMU_TRACE_SCOPE("name")` records the time spent in the enclosing scope on the calling
+/// thread, and `QPMU_TRACE_THREAD_NAME(name)` names the calling thread in the trace. With the
+/// `ENABLE_TRACING` build option off, both compile to nothing. A scope's name must be a string
+/// literal (or otherwise outlive the process), since only the pointer is stored.
+#ifdef QPMU_ENABLE_TRACING
+#  define QPMU_TRACE_CONCAT_(a, b) a##b
+#  define QPMU_TRACE_CONCAT(a, b) QPMU_TRACE_CONCAT_(a, b)
+#  define QPMU_TRACE_SCOPE(name) \
+      const ::qpmu::TraceScope QPMU_TRACE_CONCAT(qpmuTraceScope, __LINE__)(name)
+#  define QPMU_TRACE_THREAD_NAME(name) ::qpmu::TraceRecorder::instance().setThreadName(name)
+#else
+#  define QPMU_TRACE_SCOPE(name) static_cast<void>(0)
+#  define QPMU_TRACE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+namespace qpmu {
+
+/// @brief Ring of the trace events recorded by one thread.
+///
+/// Only the owning thread writes, without locking; the exporter copies the ring from another
+/// thread and keeps only the events that were not overwritten meanwhile.
+class TraceBuffer
+{
+public:
+    /// Events kept per thread; at a few events per sample, several seconds of a 1200 Hz stream
+    static constexpr size_t Capacity = size_t(1) << 16;
+
+    struct Event
+    {
+        const char *name = nullptr;
+        int64_t beginUsec = 0;
+        int64_t durationUsec = 0;
+    };
+
+    explicit TraceBuffer(size_t threadIndex);
+
+    void record(const char *name, int64_t beginUsec, int64_t durationUsec);
+
+    /// Events still in the ring, oldest first
+    std::vector<Event> snapshot() const;
+
+    size_t threadIndex() const { return m_threadIndex; }
+
+    void setThreadName(const std::string &name);
+    std::string threadName() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<const char *> name = { nullptr };
+        std::atomic<int64_t> beginUsec = { 0 };
+        std::atomic<int64_t> durationUsec = { 0 };
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_written = { 0 };
+    size_t m_threadIndex = 0;
+
+    mutable std::mutex m_nameMutex;
+    std::string m_threadName = {};
+};
+
+/// @brief Trace buffers of all threads, exported as Chrome trace-event JSON (for Perfetto or
+/// chrome://tracing).
+///
+/// A thread's buffer is created on its first event and kept after the thread ends, so the trace
+/// still shows it.
+class TraceRecorder
+{
+public:
+    /// Whether the trace points were compiled in
+    static constexpr bool enabled()
+    {
+#ifdef QPMU_ENABLE_TRACING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /// The calling thread's buffer
+    TraceBuffer &threadBuffer();
+
+    /// Names the calling thread in the trace
+    void setThreadName(const std::string &name) { threadBuffer().setThreadName(name); }
+
+    /// Complete ("X") events of every thread, with the thread names as metadata
+    std::string renderChromeJson() const;
+
+    /// Writes `renderChromeJson()` to a file; returns false if that failed
+    bool writeChromeJson(const std::string &path) const;
+
+    /// Monotonic time of the trace events (in microseconds)
+    static int64_t nowUsec();
+
+    /// The recorder of the process
+    static TraceRecorder &instance();
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> m_buffers = {};
+};
+
+/// Records the lifetime of the scope as one event; use through `QPMU_TRACE_SCOPE`
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(name), m_beginUsec(TraceRecorder::nowUsec())
+    {
+    }
+
+    ~TraceScope()
+    {
+        TraceRecorder::instance().threadBuffer().record(m_name, m_beginUsec,
+                                                         TraceRecorder::nowUsec() - m_beginUsec);
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name;
+    int64_t m_beginUsec;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_COMMON_TRACE_H
@@ -0,0 +1,128 @@
+#include "qpmu/aggregation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace qpmu {
+
+StationAggregator::StationAggregator(size_t countStations)
+    : m_countStations(std::max(countStations, (size_t)1))
+{
+    for (auto &slot : m_slots) {
+        slot.estimations.resize(m_countStations);
+        slot.present.resize(m_countStations);
+        slot.inputFlags.resize(m_countStations);
+    }
+    m_evicted.estimations.resize(m_countStations);
+    m_evicted.present.resize(m_countStations);
+    m_evicted.inputFlags.resize(m_countStations);
+    m_released.reserve(Depth + 1);
+}
+
+void StationAggregator::open(Aggregate &slot, const ReportingInstant &instant)
+{
+    slot.instant = instant;
+    std::fill(slot.present.begin(), slot.present.end(), 0);
+    slot.countPresent = 0;
+}
+
+void StationAggregator::releaseOlder(int64_t timeUsec)
+{
+    for (;;) {
+        size_t oldest = Depth;
+        for (size_t i = 0; i < Depth; ++i) {
+            if (m_used[i] && m_slots[i].instant.timeUsec < timeUsec
+                && (oldest == Depth
+                    || m_slots[i].instant.timeUsec < m_slots[oldest].instant.timeUsec)) {
+                oldest = i;
+            }
+        }
+        if (oldest == Depth) {
+            return;
+        }
+        m_used[oldest] = false;
+        ++m_stats.incompleteInstants;
+        m_released.push_back(&m_slots[oldest]);
+    }
+}
+
+const std::vector<const StationAggregator::Aggregate *> &
+StationAggregator::add(size_t station, const ReportingInstant &instant,
+                       const Estimation &estimation)
+{
+    assert(station < m_countStations);
+
+    m_released.clear();
+
+    /// The instant's open slot, or a free one, or else the oldest one (which is evicted)
+    size_t index = Depth;
+    size_t free = Depth;
+    size_t oldest = Depth;
+    for (size_t i = 0; i < Depth; ++i) {
+        if (!m_used[i]) {
+            free = std::min(free, i);
+        } else if (m_slots[i].instant.timeUsec == instant.timeUsec) {
+            index = i;
+            break;
+        } else if (oldest == Depth
+                   || m_slots[i].instant.timeUsec < m_slots[oldest].instant.timeUsec) {
+            oldest = i;
+        }
+    }
+
+    if (index == Depth) {
+        if (instant.timeUsec <= m_releasedUsec) {
+            ++m_stats.lateEstimations;
+            return m_released;
+        }
+        if (free < Depth) {
+            index = free;
+        } else if (instant.timeUsec < m_slots[oldest].instant.timeUsec) {
+            /// Older than every open instant: evicting one of them would release it before this
+            /// one, so this one is released at once instead
+            open(m_evicted, instant);
+            m_evicted.present[station] = 1;
+            m_evicted.countPresent = 1;
+            m_evicted.estimations[station] = estimation;
+            m_evicted.inputFlags[station] = instant.inputFlags;
+            m_releasedUsec = instant.timeUsec;
+            if (m_evicted.complete()) {
+                ++m_stats.completeInstants;
+            } else {
+                ++m_stats.incompleteInstants;
+            }
+            m_released.push_back(&m_evicted);
+            return m_released;
+        } else {
+            index = oldest;
+            std::swap(m_evicted, m_slots[index]);
+            m_releasedUsec = m_evicted.instant.timeUsec;
+            ++m_stats.incompleteInstants;
+            m_released.push_back(&m_evicted);
+        }
+        open(m_slots[index], instant);
+        m_used[index] = true;
+    }
+
+    auto &slot = m_slots[index];
+    if (!slot.present[station]) {
+        slot.present[station] = 1;
+        ++slot.countPresent;
+    }
+    slot.estimations[station] = estimation;
+    slot.inputFlags[station] = instant.inputFlags;
+
+    if (slot.complete()) {
+        /// A new instant completes at once only with a single station, which never evicts
+        assert(m_released.empty());
+        releaseOlder(slot.instant.timeUsec);
+        m_used[index] = false;
+        m_releasedUsec = slot.instant.timeUsec;
+        ++m_stats.completeInstants;
+        m_released.push_back(&slot);
+    }
+    return m_released;
+}
+
+} // namespace qpmu
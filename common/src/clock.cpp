@@ -0,0 +1,46 @@
+#include "qpmu/clock.h"
+#include "qpmu/defs.h"
+#include "qpmu/util.h"
+
+#include <atomic>
+
+namespace qpmu {
+
+namespace {
+
+std::atomic<bool> virtualClock = { false };
+std::atomic<int64_t> virtualTimeUsec = { 0 };
+
+} // namespace
+
+int64_t currentTimeUsec()
+{
+    if (virtualClock.load(std::memory_order_relaxed)) {
+        return virtualTimeUsec.load(std::memory_order_relaxed);
+    }
+    return epochTime(SystemClock::now()).count();
+}
+
+void enableVirtualClock()
+{
+    virtualClock.store(true, std::memory_order_relaxed);
+}
+
+bool virtualClockEnabled()
+{
+    return virtualClock.load(std::memory_order_relaxed);
+}
+
+void advanceVirtualClock(int64_t timeUsec)
+{
+    if (!virtualClock.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto current = virtualTimeUsec.load(std::memory_order_relaxed);
+    while (current < timeUsec
+           && !virtualTimeUsec.compare_exchange_weak(current, timeUsec,
+                                                     std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace qpmu
@@ -0,0 +1,129 @@
+#include "qpmu/frame_assembler.h"
+#include "qpmu/frames.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace qpmu {
+
+uint8_t *FrameAssembler::prepare(size_t &space)
+{
+    if (m_begin > 0) {
+        std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    space = Capacity - m_end;
+    return m_buffer.data() + m_end;
+}
+
+void FrameAssembler::commit(size_t size)
+{
+    assert(m_end + size <= Capacity);
+    m_end += size;
+}
+
+size_t FrameAssembler::push(const uint8_t *data, size_t size)
+{
+    size_t space;
+    auto dest = prepare(space);
+    size = std::min(size, space);
+    std::memcpy(dest, data, size);
+    commit(size);
+    return size;
+}
+
+namespace {
+
+constexpr size_t MinFrameSize = FrameHeaderSize + FrameChecksumSize;
+
+} // namespace
+
+size_t FrameAssembler::nextCompleteFrame(const uint8_t *data, size_t size)
+{
+    for (size_t offset = 1; offset + 4 <= size; ++offset) {
+        auto sync = (const uint8_t *)std::memchr(data + offset, FrameSyncByte, size - offset);
+        if (!sync) {
+            break;
+        }
+        offset = (size_t)(sync - data);
+        const size_t available = size - offset;
+        if (available < 4 || !validSync(sync)) {
+            continue;
+        }
+        const size_t declared = frameSize(sync);
+        if (declared >= MinFrameSize && declared <= available
+            && crcCcitt(sync, declared - FrameChecksumSize)
+                    == readU16(sync + declared - FrameChecksumSize)) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+bool FrameAssembler::next(const uint8_t *&frame, size_t &size)
+{
+    while (m_begin < m_end) {
+        const uint8_t *p = m_buffer.data() + m_begin;
+        const size_t available = m_end - m_begin;
+
+        if (p[0] != FrameSyncByte) {
+            /// Resynchronize at the next SYNC byte
+            auto sync = (const uint8_t *)std::memchr(p, FrameSyncByte, available);
+            skip(sync ? (size_t)(sync - p) : available);
+            continue;
+        }
+
+        if (available < 4) {
+            return false;
+        }
+
+        if (!validSync(p)) {
+            skip(1);
+            continue;
+        }
+
+        const size_t declared = frameSize(p);
+        if (declared < MinFrameSize || declared > Capacity) {
+            ++m_stats.oversizedFrames;
+            skip(1);
+            continue;
+        }
+
+        if (available < declared) {
+            /// The FRAMESIZE may be corrupt; rather than wait for bytes that may never come, move
+            /// on to a later frame that is already complete
+            if (auto offset = nextCompleteFrame(p, available)) {
+                skip(offset);
+                continue;
+            }
+            return false;
+        }
+
+        /// On a mismatch, resynchronize at the next SYNC byte after this one
+        const uint16_t chk = readU16(p + declared - FrameChecksumSize);
+        if (crcCcitt(p, declared - FrameChecksumSize) != chk) {
+            ++m_stats.crcErrors;
+            skip(1);
+            continue;
+        }
+
+        frame = p;
+        size = declared;
+        m_begin += declared;
+        ++m_stats.frames;
+        return true;
+    }
+
+    m_begin = m_end = 0;
+    return false;
+}
+
+void FrameAssembler::skip(size_t count)
+{
+    m_begin += count;
+    m_stats.skippedBytes += count;
+}
+
+} // namespace qpmu
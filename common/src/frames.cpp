@@ -0,0 +1,152 @@
+#include "qpmu/defs.h"
+#include "qpmu/frames.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace qpmu {
+
+namespace {
+
+constexpr std::array<uint16_t, 256> makeCrcTable()
+{
+    std::array<uint16_t, 256> table = {};
+    for (uint16_t i = 0; i < 256; ++i) {
+        uint16_t crc = i << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> CrcTable = makeCrcTable();
+
+inline void putU16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)(value);
+}
+
+inline void putU32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)(value);
+}
+
+inline void putF32(uint8_t *p, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putU32(p, bits);
+}
+
+inline int16_t saturate16(Float value)
+{
+    value = std::round(value);
+    return (int16_t)std::max((Float)INT16_MIN, std::min((Float)INT16_MAX, value));
+}
+
+} // namespace
+
+uint16_t crcCcitt(const uint8_t *data, size_t size, uint16_t crc)
+{
+    for (size_t i = 0; i < size; ++i) {
+        crc = (uint16_t)(crc << 8) ^ CrcTable[(uint8_t)(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+DataFrameWriter::DataFrameWriter(const std::vector<StationLayout> &stations)
+    : m_stations(stations)
+{
+    size_t offset = FrameHeaderSize;
+    for (const auto &station : m_stations) {
+        m_offsets.push_back(offset);
+        offset += station.size();
+    }
+    m_buffer.resize(offset + FrameChecksumSize);
+}
+
+bool DataFrameWriter::loadTemplate(const uint8_t *frame, size_t size)
+{
+    if (size != m_buffer.size()) {
+        return false;
+    }
+    std::memcpy(m_buffer.data(), frame, size);
+    m_loaded = true;
+    return true;
+}
+
+void DataFrameWriter::setTime(uint32_t soc, uint32_t fracsec)
+{
+    putU32(&m_buffer[6], soc);
+    putU32(&m_buffer[10], fracsec);
+}
+
+void DataFrameWriter::setStat(size_t station, uint16_t stat)
+{
+    assert(station < m_stations.size());
+    putU16(&m_buffer[m_offsets[station]], stat);
+}
+
+void DataFrameWriter::setPhasor(size_t station, size_t index, const Complex &phasor)
+{
+    assert(station < m_stations.size());
+    const auto &layout = m_stations[station];
+    assert(index < layout.countPhasors);
+
+    auto p = &m_buffer[m_offsets[station] + 2 + index * layout.phasorSize()];
+    Float first = layout.polarPhasors ? std::abs(phasor) : phasor.real();
+    Float second = layout.polarPhasors ? std::arg(phasor) : phasor.imag();
+    if (layout.floatPhasors) {
+        putF32(p, (float)first);
+        putF32(p + 4, (float)second);
+    } else {
+        /// Integer polar angles are in radians x 10^4
+        putU16(p, (uint16_t)saturate16(first));
+        putU16(p + 2, (uint16_t)saturate16(layout.polarPhasors ? second * 1e4 : second));
+    }
+}
+
+void DataFrameWriter::setFrequency(size_t station, Float frequency)
+{
+    assert(station < m_stations.size());
+    const auto &layout = m_stations[station];
+    auto p = &m_buffer[m_offsets[station] + 2 + layout.countPhasors * layout.phasorSize()];
+    if (layout.floatFrequency) {
+        putF32(p, (float)frequency);
+    } else {
+        /// Integer FREQ is the deviation from nominal in mHz
+        putU16(p, (uint16_t)saturate16((frequency - layout.nominalFrequency) * 1000));
+    }
+}
+
+void DataFrameWriter::setRocof(size_t station, Float rocof)
+{
+    assert(station < m_stations.size());
+    const auto &layout = m_stations[station];
+    auto p = &m_buffer[m_offsets[station] + 2 + layout.countPhasors * layout.phasorSize()
+                       + layout.frequencySize()];
+    if (layout.floatFrequency) {
+        putF32(p, (float)rocof);
+    } else {
+        /// Integer DFREQ is the ROCOF in Hz/s x 100
+        putU16(p, (uint16_t)saturate16(rocof * 100));
+    }
+}
+
+const uint8_t *DataFrameWriter::finish()
+{
+    const size_t n = m_buffer.size() - FrameChecksumSize;
+    putU16(&m_buffer[n], crcCcitt(m_buffer.data(), n));
+    return m_buffer.data();
+}
+
+} // namespace qpmu
@@ -0,0 +1,121 @@
+#include "qpmu/input_monitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace qpmu {
+
+uint16_t inputHealthStatBits(uint32_t flags)
+{
+    uint16_t bits = 0;
+    if (flags & (SampleGapFlag | DuplicateSampleFlag)) {
+        bits |= 0x4000;
+    }
+    if (flags & (TimingJitterFlag | RateDriftFlag)) {
+        bits |= 0x2000;
+    }
+    return bits;
+}
+
+InputMonitor::InputMonitor(Float samplingRate, Float jitterTolerance, Float driftTolerancePpm)
+    : m_nominalUsec(1e6 / samplingRate),
+      m_jitterToleranceUsec(jitterTolerance * m_nominalUsec),
+      m_driftTolerancePpm(driftTolerancePpm),
+      m_alpha(1 / samplingRate),
+      m_warmup((uint64_t)samplingRate)
+{
+}
+
+InputMonitor::Check InputMonitor::update(const Sample &sample)
+{
+    Check check;
+    ++m_stats.samples;
+
+    if (!m_anySample) {
+        m_anySample = true;
+        m_lastSeq = sample.seq;
+        m_lastTimestampUsec = sample.timestampUsec;
+        return check;
+    }
+
+    if (sample.seq <= m_lastSeq) {
+        /// A sequence far behind is taken as the source starting over, and the stream as broken
+        /// there; anything else is a repeat, which is left out of the intervals
+        if (m_lastSeq - sample.seq < m_warmup) {
+            ++m_stats.duplicates;
+            check.flags |= DuplicateSampleFlag;
+            return check;
+        }
+        ++m_stats.gaps;
+        check.flags |= SampleGapFlag;
+    } else if (sample.seq > m_lastSeq + 1) {
+        check.missingSamples = sample.seq - m_lastSeq - 1;
+        ++m_stats.gaps;
+        m_stats.missingSamples += check.missingSamples;
+        check.flags |= SampleGapFlag;
+    }
+
+    /// The interval measured by the source, or else the one between the timestamps
+    if (sample.timeDeltaUsec > 0) {
+        check.intervalUsec = sample.timeDeltaUsec;
+    } else if (!(check.flags & SampleGapFlag)) {
+        check.intervalUsec = sample.timestampUsec - m_lastTimestampUsec;
+    }
+    m_lastSeq = sample.seq;
+    m_lastTimestampUsec = sample.timestampUsec;
+
+    if (check.intervalUsec >= 0) {
+        const auto interval = check.intervalUsec;
+        if (m_countIntervals == 0) {
+            m_meanUsec = interval;
+            m_stats.minIntervalUsec = interval;
+            m_stats.maxIntervalUsec = interval;
+        } else {
+            if (std::abs(interval - m_meanUsec) > m_jitterToleranceUsec) {
+                ++m_stats.jitteredIntervals;
+                check.flags |= TimingJitterFlag;
+            }
+            m_meanUsec += m_alpha * (interval - m_meanUsec);
+            m_stats.minIntervalUsec = std::min(m_stats.minIntervalUsec, interval);
+            m_stats.maxIntervalUsec = std::max(m_stats.maxIntervalUsec, interval);
+        }
+        ++m_countIntervals;
+    }
+
+    if (m_countIntervals >= m_warmup) {
+        if (m_baselineUsec == 0) {
+            m_baselineUsec = m_meanUsec;
+        }
+        const auto baselineDriftPpm = (m_meanUsec / m_baselineUsec - 1) * 1e6;
+        if (std::abs(baselineDriftPpm) > m_driftTolerancePpm
+            || std::abs(driftPpm()) > MaxNominalDriftPpm) {
+            check.flags |= RateDriftFlag;
+        }
+    }
+    return check;
+}
+
+Float InputMonitor::driftPpm() const
+{
+    if (m_countIntervals == 0) {
+        return 0;
+    }
+    return (m_meanUsec / m_nominalUsec - 1) * 1e6;
+}
+
+std::vector<int64_t> InputMonitor::intervalBucketsUsec() const
+{
+    static constexpr Float Ratios[] = { 0.5,  0.8,  0.9,  0.95, 0.98, 0.99, 0.995, 1.0,
+                                        1.005, 1.01, 1.02, 1.05, 1.1,  1.2,  1.5,   2.0,
+                                        3.0,  5.0,  10.0 };
+    std::vector<int64_t> bounds;
+    for (auto ratio : Ratios) {
+        auto bound = (int64_t)std::llround(ratio * m_nominalUsec);
+        if (bounds.empty() || bound > bounds.back()) {
+            bounds.push_back(bound);
+        }
+    }
+    return bounds;
+}
+
+} // namespace qpmu
@@ -0,0 +1,104 @@
+#include "qpmu/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace qpmu {
+
+namespace {
+
+inline int highestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+size_t LatencyHistogram::bucketIndex(int64_t value)
+{
+    if (value < SubBucketCount) {
+        return (size_t)std::max(value, (int64_t)0);
+    }
+    int exponent = highestBit((uint64_t)value);
+    if (exponent >= MaxExponent) {
+        return BucketCount - 1;
+    }
+    auto shift = exponent - SubBucketBits;
+    auto sub = (value >> shift) & (SubBucketCount - 1);
+    return (size_t)((shift + 1) * SubBucketCount + sub);
+}
+
+int64_t LatencyHistogram::bucketUpperBound(size_t index)
+{
+    if (index < (size_t)SubBucketCount) {
+        return (int64_t)index;
+    }
+    auto shift = (int64_t)(index / SubBucketCount) - 1;
+    auto sub = (int64_t)(index % SubBucketCount);
+    return ((SubBucketCount + sub) << shift) + (int64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t value)
+{
+    value = std::max(value, (int64_t)0);
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+    auto min = m_min.load(std::memory_order_relaxed);
+    while (value < min && !m_min.compare_exchange_weak(min, value, std::memory_order_relaxed)) { }
+}
+
+int64_t LatencyHistogram::min() const
+{
+    auto min = m_min.load(std::memory_order_relaxed);
+    return min == INT64_MAX ? 0 : min;
+}
+
+int64_t LatencyHistogram::percentile(double fraction) const
+{
+    auto total = count();
+    if (total == 0) {
+        return 0;
+    }
+    auto rank = (uint64_t)std::ceil(std::min(std::max(fraction, 0.0), 1.0) * total);
+    rank = std::max(rank, (uint64_t)1);
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < BucketCount; ++i) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        if (cumulative >= rank) {
+            /// The exact maximum is known; don't report past it
+            return std::min(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(INT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+} // namespace qpmu
@@ -0,0 +1,204 @@
+#include "qpmu/metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace qpmu {
+
+Histogram::Histogram(const std::vector<int64_t> &bounds)
+    : m_bounds(bounds), m_counts(new std::atomic<uint64_t>[bounds.size() + 1])
+{
+    assert(std::is_sorted(m_bounds.begin(), m_bounds.end()));
+    for (size_t i = 0; i <= m_bounds.size(); ++i) {
+        m_counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::record(int64_t value)
+{
+    auto bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+    m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.bounds = m_bounds;
+    snapshot.counts.resize(m_bounds.size() + 1);
+    for (size_t i = 0; i <= m_bounds.size(); ++i) {
+        snapshot.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count = m_count.load(std::memory_order_relaxed);
+    snapshot.sum = m_sum.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::vector<int64_t> latencyBucketsUsec()
+{
+    return { 50,    100,   250,    500,    1000,   2500,   5000,
+             10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+}
+
+MetricsRegistry::Entry &MetricsRegistry::entry(const std::string &name, const std::string &help,
+                                               const std::string &labels, Type type)
+{
+    for (auto &entry : m_entries) {
+        if (entry->name == name && entry->labels == labels) {
+            assert(entry->type == type);
+            return *entry;
+        }
+    }
+    m_entries.emplace_back(
+            new Entry{ name, help, labels, type, nullptr, nullptr, nullptr, nullptr });
+    return *m_entries.back();
+}
+
+Counter &MetricsRegistry::counter(const std::string &name, const std::string &help,
+                                  const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &e = entry(name, help, labels, CounterType);
+    if (!e.counter) {
+        e.counter.reset(new Counter());
+    }
+    return *e.counter;
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name, const std::string &help,
+                              const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &e = entry(name, help, labels, GaugeType);
+    if (!e.gauge) {
+        e.gauge.reset(new Gauge());
+    }
+    return *e.gauge;
+}
+
+Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help,
+                                      const std::vector<int64_t> &bounds,
+                                      const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &e = entry(name, help, labels, HistogramType);
+    if (!e.histogram) {
+        e.histogram.reset(new Histogram(bounds));
+    }
+    return *e.histogram;
+}
+
+LatencyHistogram &MetricsRegistry::latency(const std::string &name, const std::string &help,
+                                           const std::string &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &e = entry(name, help, labels, LatencyType);
+    if (!e.latency) {
+        e.latency.reset(new LatencyHistogram());
+    }
+    return *e.latency;
+}
+
+std::string MetricsRegistry::renderPrometheus() const
+{
+    static const char *typeNames[] = { "counter", "gauge", "histogram", "summary" };
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+
+    /// Entries of the same name (with different labels) are grouped under one HELP/TYPE header,
+    /// in the order the names were first registered
+    std::vector<bool> rendered(m_entries.size(), false);
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        if (rendered[i]) {
+            continue;
+        }
+        const auto &first = *m_entries[i];
+        out << "# HELP " << first.name << " " << first.help << "\n";
+        out << "# TYPE " << first.name << " " << typeNames[first.type] << "\n";
+
+        for (size_t j = i; j < m_entries.size(); ++j) {
+            const auto &e = *m_entries[j];
+            if (rendered[j] || e.name != first.name) {
+                continue;
+            }
+            rendered[j] = true;
+
+            auto braced = e.labels.empty() ? std::string() : "{" + e.labels + "}";
+            switch (e.type) {
+            case CounterType:
+                out << e.name << braced << " " << e.counter->value() << "\n";
+                break;
+            case GaugeType:
+                out << e.name << braced << " " << e.gauge->value() << "\n";
+                break;
+            case HistogramType: {
+                auto snapshot = e.histogram->snapshot();
+                auto prefix = e.labels.empty() ? std::string() : e.labels + ",";
+                uint64_t cumulative = 0;
+                for (size_t b = 0; b < snapshot.counts.size(); ++b) {
+                    cumulative += snapshot.counts[b];
+                    out << e.name << "_bucket{" << prefix << "le=\"";
+                    if (b < snapshot.bounds.size()) {
+                        out << snapshot.bounds[b];
+                    } else {
+                        out << "+Inf";
+                    }
+                    out << "\"} " << cumulative << "\n";
+                }
+                out << e.name << "_sum" << braced << " " << snapshot.sum << "\n";
+                out << e.name << "_count" << braced << " " << snapshot.count << "\n";
+                break;
+            }
+            case LatencyType: {
+                const auto &h = *e.latency;
+                auto prefix = e.labels.empty() ? std::string() : e.labels + ",";
+                static const std::pair<double, const char *> quantiles[] = {
+                    { 0.5, "0.5" }, { 0.99, "0.99" }, { 0.999, "0.999" }
+                };
+                for (const auto &[fraction, quantile] : quantiles) {
+                    out << e.name << "{" << prefix << "quantile=\"" << quantile << "\"} "
+                        << h.percentile(fraction) << "\n";
+                }
+                out << e.name << "{" << prefix << "quantile=\"1\"} " << h.max() << "\n";
+                out << e.name << "_sum" << braced << " " << h.sum() << "\n";
+                out << e.name << "_count" << braced << " " << h.count() << "\n";
+                break;
+            }
+            }
+        }
+    }
+    return out.str();
+}
+
+std::string MetricsRegistry::renderLatencyReport() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    out << std::left << std::setw(56) << "latency (us)" << std::right << std::setw(12) << "count"
+        << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+        << std::setw(10) << "max" << "\n";
+    for (const auto &e : m_entries) {
+        if (e->type != LatencyType) {
+            continue;
+        }
+        const auto &h = *e->latency;
+        auto name = e->labels.empty() ? e->name : e->name + "{" + e->labels + "}";
+        out << std::left << std::setw(56) << name << std::right << std::setw(12) << h.count()
+            << std::setw(10) << h.percentile(0.5) << std::setw(10) << h.percentile(0.99)
+            << std::setw(10) << h.percentile(0.999) << std::setw(10) << h.max() << "\n";
+    }
+    return out.str();
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+} // namespace qpmu
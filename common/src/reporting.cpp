@@ -0,0 +1,105 @@
+#include "qpmu/defs.h"
+#include "qpmu/reporting.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace qpmu {
+
+ReportingScheduler::ReportingScheduler(uint32_t reportingRate) : m_reportingRate(reportingRate)
+{
+    assert(reportingRate > 0);
+    assert(reportingRate <= TimeDenom);
+}
+
+ReportingInstant ReportingScheduler::makeInstant(int64_t sec, int64_t index) const
+{
+    ReportingInstant instant;
+    instant.soc = (uint32_t)sec;
+    instant.fracsec = (uint32_t)((index * (int64_t)TimeDenom) / m_reportingRate);
+    instant.timeUsec = sec * (int64_t)TimeDenom + instant.fracsec;
+    instant.index = (uint32_t)index;
+    instant.reportingRate = m_reportingRate;
+    return instant;
+}
+
+ReportingInstant ReportingScheduler::instantAtOrBefore(int64_t timeUsec) const
+{
+    const int64_t denom = TimeDenom;
+    const int64_t sec = timeUsec / denom;
+    const int64_t frac = timeUsec % denom;
+
+    /// Largest index whose fraction `index * denom / rate` (rounded down) is not after `frac`
+    int64_t index = (frac * m_reportingRate) / denom;
+    while (index + 1 < (int64_t)m_reportingRate
+           && ((index + 1) * denom) / m_reportingRate <= frac) {
+        ++index;
+    }
+    return makeInstant(sec, index);
+}
+
+ReportingInstant ReportingScheduler::instantAtOrAfter(int64_t timeUsec) const
+{
+    auto instant = instantAtOrBefore(timeUsec);
+    if (instant.timeUsec == timeUsec) {
+        return instant;
+    }
+    if (instant.index + 1 < m_reportingRate) {
+        return makeInstant(instant.soc, instant.index + 1);
+    }
+    return makeInstant((int64_t)instant.soc + 1, 0);
+}
+
+bool ReportingScheduler::update(int64_t sampleTimeUsec, ReportingInstant &instant)
+{
+    if (!m_started) {
+        m_pending = instantAtOrAfter(sampleTimeUsec);
+        m_started = true;
+    }
+
+    if (sampleTimeUsec < m_pending.timeUsec) {
+        return false;
+    }
+
+    /// Report the latest instant this sample has reached; the ones between the pending instant
+    /// and it had no sample of their own
+    instant = instantAtOrBefore(sampleTimeUsec);
+    auto globalIndex = [this](const ReportingInstant &x) {
+        return (uint64_t)x.soc * m_reportingRate + x.index;
+    };
+    m_countMissed += globalIndex(instant) - globalIndex(m_pending);
+    instant.offsetUsec = sampleTimeUsec - instant.timeUsec;
+
+    m_pending = instantAtOrAfter(sampleTimeUsec + 1);
+    return true;
+}
+
+Estimation rotateToInstant(const Estimation &estimation, int64_t offsetUsec,
+                           Float nominalFrequency)
+{
+    Estimation result = estimation;
+    if (offsetUsec == 0) {
+        return result;
+    }
+    const Float offsetSec = (Float)offsetUsec / TimeDenom;
+    for (size_t ch = 0; ch < CountSignals; ++ch) {
+        const Float estimate = estimation.frequencies[ch];
+        const Float frequency = std::abs(estimate - nominalFrequency) < nominalFrequency / 2
+                ? estimate
+                : nominalFrequency;
+        result.phasors[ch] *= std::polar((Float)1, (Float)(-2 * M_PI * frequency * offsetSec));
+    }
+    return result;
+}
+
+void DispatchLatency::record(int64_t latencyUsec)
+{
+    lastUsec = latencyUsec;
+    minUsec = count ? std::min(minUsec, latencyUsec) : latencyUsec;
+    maxUsec = count ? std::max(maxUsec, latencyUsec) : latencyUsec;
+    totalUsec += latencyUsec;
+    ++count;
+}
+
+} // namespace qpmu
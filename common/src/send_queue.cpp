@@ -0,0 +1,111 @@
+#include "qpmu/send_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace qpmu {
+
+SendQueue::SendQueue(size_t capacityFrames, size_t frameSizeHint, Policy policy)
+    : m_slots(std::max(capacityFrames, (size_t)1)), m_policy(policy)
+{
+    for (auto &slot : m_slots) {
+        slot.bytes.reserve(frameSizeHint);
+    }
+}
+
+SendQueue::PushResult SendQueue::push(const uint8_t *data, size_t size, int64_t nowUsec)
+{
+    assert(!m_slots.empty());
+
+    if (m_count == m_slots.size()) {
+        switch (m_policy) {
+        case DropOldest:
+            /// The oldest data frame makes room; a queue of nothing but replies keeps them
+            if (m_countReplies == m_count) {
+                ++m_stats.droppedFrames;
+                return Dropped;
+            }
+            drop(m_countReplies);
+            break;
+        case DropNewest:
+            ++m_stats.droppedFrames;
+            return Dropped;
+        case Disconnect:
+            ++m_stats.droppedFrames;
+            return Refused;
+        }
+    }
+
+    auto &back = slot(m_count);
+    back.bytes.assign(data, data + size);
+    back.enqueuedUsec = nowUsec;
+    ++m_count;
+
+    m_stats.queuedBytes += size;
+    m_stats.queuedFrames = m_count;
+    return Queued;
+}
+
+SendQueue::PushResult SendQueue::pushReply(const uint8_t *data, size_t size, int64_t nowUsec)
+{
+    assert(!m_slots.empty());
+
+    if (m_count == m_slots.size()) {
+        if (m_policy == Disconnect) {
+            ++m_stats.droppedFrames;
+            return Refused;
+        }
+        if (m_countReplies == m_count) {
+            drop(0);
+        } else {
+            drop(m_policy == DropOldest ? m_countReplies : m_count - 1);
+        }
+    }
+
+    /// Queued at the back, then moved ahead of the data frames; swapping keeps the slots'
+    /// buffers
+    auto &back = slot(m_count);
+    back.bytes.assign(data, data + size);
+    back.enqueuedUsec = nowUsec;
+    for (size_t i = m_count; i > m_countReplies; --i) {
+        std::swap(slot(i), slot(i - 1));
+    }
+    ++m_count;
+    ++m_countReplies;
+
+    m_stats.queuedBytes += size;
+    m_stats.queuedFrames = m_count;
+    return Queued;
+}
+
+void SendQueue::pop(int64_t nowUsec)
+{
+    assert(m_count > 0);
+    m_stats.maxAgeUsec = std::max(m_stats.maxAgeUsec, nowUsec - m_slots[m_head].enqueuedUsec);
+    m_stats.queuedBytes -= m_slots[m_head].bytes.size();
+    m_head = (m_head + 1) % m_slots.size();
+    --m_count;
+    m_countReplies -= m_countReplies > 0;
+    m_stats.queuedFrames = m_count;
+}
+
+void SendQueue::drop(size_t position)
+{
+    assert(position < m_count);
+    m_stats.queuedBytes -= slot(position).bytes.size();
+    m_countReplies -= position < m_countReplies;
+    if (position + 1 < m_count) {
+        /// The frames before it move up a slot, and the front advances past it; they are
+        /// replies, if any, so there are few of them
+        for (size_t i = position; i > 0; --i) {
+            std::swap(slot(i), slot(i - 1));
+        }
+        m_head = (m_head + 1) % m_slots.size();
+    }
+    --m_count;
+    m_stats.queuedFrames = m_count;
+    ++m_stats.droppedFrames;
+}
+
+} // namespace qpmu
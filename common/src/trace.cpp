@@ -0,0 +1,155 @@
+#include "qpmu/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace qpmu {
+
+namespace {
+
+void writeJsonString(std::ostringstream &out, const std::string &value)
+{
+    out << '"';
+    for (auto c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+TraceBuffer::TraceBuffer(size_t threadIndex)
+    : m_slots(new Slot[Capacity]), m_threadIndex(threadIndex)
+{
+}
+
+void TraceBuffer::record(const char *name, int64_t beginUsec, int64_t durationUsec)
+{
+    const auto n = m_written.load(std::memory_order_relaxed);
+    auto &slot = m_slots[n % Capacity];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.beginUsec.store(beginUsec, std::memory_order_relaxed);
+    slot.durationUsec.store(durationUsec, std::memory_order_relaxed);
+    m_written.store(n + 1, std::memory_order_release);
+}
+
+std::vector<TraceBuffer::Event> TraceBuffer::snapshot() const
+{
+    const auto before = m_written.load(std::memory_order_acquire);
+    const auto first = (before > Capacity) ? before - Capacity : 0;
+
+    std::vector<Event> events;
+    events.reserve(before - first);
+    for (auto i = first; i < before; ++i) {
+        const auto &slot = m_slots[i % Capacity];
+        events.push_back({ slot.name.load(std::memory_order_relaxed),
+                           slot.beginUsec.load(std::memory_order_relaxed),
+                           slot.durationUsec.load(std::memory_order_relaxed) });
+    }
+
+    /// Drop the events whose slots the writer may have reused while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto after = m_written.load(std::memory_order_relaxed);
+    if (after + 1 > first + Capacity) {
+        const auto overwritten = std::min<uint64_t>(after + 1 - Capacity - first, events.size());
+        events.erase(events.begin(), events.begin() + overwritten);
+    }
+    return events;
+}
+
+void TraceBuffer::setThreadName(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_nameMutex);
+    m_threadName = name;
+}
+
+std::string TraceBuffer::threadName() const
+{
+    std::lock_guard<std::mutex> lock(m_nameMutex);
+    return m_threadName;
+}
+
+TraceBuffer &TraceRecorder::threadBuffer()
+{
+    thread_local TraceBuffer *buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.emplace_back(new TraceBuffer(m_buffers.size() + 1));
+        buffer = m_buffers.back().get();
+    }
+    return *buffer;
+}
+
+std::string TraceRecorder::renderChromeJson() const
+{
+    std::vector<const TraceBuffer *> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &buffer : m_buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&] {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (auto buffer : buffers) {
+        const auto tid = buffer->threadIndex();
+        auto name = buffer->threadName();
+        if (name.empty()) {
+            name = "thread " + std::to_string(tid);
+        }
+        separate();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":";
+        writeJsonString(out, name);
+        out << "}}";
+
+        for (const auto &event : buffer->snapshot()) {
+            separate();
+            out << "{\"name\":";
+            writeJsonString(out, event.name ? event.name : "?");
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << event.beginUsec
+                << ",\"dur\":" << event.durationUsec << "}";
+        }
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+bool TraceRecorder::writeChromeJson(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << renderChromeJson();
+    return (bool)file.flush();
+}
+
+int64_t TraceRecorder::nowUsec()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+TraceRecorder &TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+} // namespace qpmu
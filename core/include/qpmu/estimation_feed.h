@@ -0,0 +1,74 @@
+#ifndef QPMU_CORE_ESTIMATION_FEED_H
+#define QPMU_CORE_ESTIMATION_FEED_H
+
+#include "qpmu/defs.h"
+#include "qpmu/estimation_packet.h"
+#include "qpmu/reporting.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace qpmu {
+
+struct EstimationFeedConfig
+{
+    /// Destination of the datagrams: a multicast group (e.g. 239.192.0.1) or a unicast address,
+    /// IPv4
+    std::string host = {};
+    uint16_t port = 0;
+
+    /// Packets per second, on the reporting instants of that rate; 0 for every estimation, i.e.,
+    /// the sampling rate
+    uint32_t rate = 0;
+
+    /// Time-to-live of the multicast datagrams; 1 keeps them on the local network
+    int multicastTtl = 1;
+
+    /// ID code of the station, in every packet
+    uint16_t idCode = 0;
+};
+
+/// @brief Sends a station's estimations as fixed-layout `EstimationPacket` datagrams, for
+/// internal consumers that need neither C37.118 nor a connection.
+///
+/// The estimations are sent unfiltered, one per sample or at the sample that completes each
+/// reporting instant of the configured rate. Every packet carries the next sequence number, so
+/// receivers detect losses (see `EstimationPacketTracker`). Multicast datagrams are looped back
+/// to receivers on the same host. Only on POSIX systems; elsewhere `open()` fails.
+class EstimationFeed
+{
+public:
+    EstimationFeed() = default;
+    ~EstimationFeed();
+
+    EstimationFeed(const EstimationFeed &) = delete;
+    EstimationFeed &operator=(const EstimationFeed &) = delete;
+
+    /// Creates the socket. Returns false with the reason in `error`.
+    bool open(const EstimationFeedConfig &config, std::string &error);
+
+    bool isOpen() const { return m_socket >= 0; }
+
+    /// Sends the estimation from the sample if it is due; from the processing thread only
+    void publish(const Sample &sample, const Estimation &estimation);
+
+    uint64_t countSent() const { return m_sequence; }
+    uint64_t countSendErrors() const { return m_sendErrors; }
+
+private:
+    void close();
+
+    EstimationFeedConfig m_config = {};
+    std::unique_ptr<ReportingScheduler> m_scheduler = {};
+    int m_socket = -1;
+    /// Destination address and port, in network byte order
+    uint32_t m_address = 0;
+    uint16_t m_port = 0;
+    uint64_t m_sequence = 0;
+    uint64_t m_sendErrors = 0;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_CORE_ESTIMATION_FEED_H
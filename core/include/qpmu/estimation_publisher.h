@@ -0,0 +1,52 @@
+#ifndef QPMU_CORE_ESTIMATION_PUBLISHER_H
+#define QPMU_CORE_ESTIMATION_PUBLISHER_H
+
+#include "qpmu/defs.h"
+#include "qpmu/estimation_shm.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace qpmu {
+
+/// @brief Publishes every estimation of a station into a seqlock ring in POSIX shared memory,
+/// for co-located consumers, which read it with `EstimationShmReader` (qpmu/estimation_shm.h).
+///
+/// Publishing converts the estimation to the record layout and writes one slot, without a lock
+/// or a system call, so it can be called from the processing thread. Only on POSIX systems;
+/// elsewhere `create()` fails.
+class EstimationPublisher
+{
+public:
+    /// Default slots of a ring: a few seconds of estimations at the usual sampling rates
+    static constexpr size_t DefaultCapacity = 4096;
+
+    EstimationPublisher() = default;
+    ~EstimationPublisher();
+
+    EstimationPublisher(const EstimationPublisher &) = delete;
+    EstimationPublisher &operator=(const EstimationPublisher &) = delete;
+
+    /// Creates the ring `name` (e.g., "/qpmu-estimations-1"), replacing an existing one; the
+    /// destructor marks the ring closed and removes it. Returns false with the reason in `error`.
+    bool create(const std::string &name, uint32_t idCode, size_t capacity, std::string &error);
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    /// Publishes the estimation from the sample. Publisher only (one thread).
+    void publish(const Sample &sample, const Estimation &estimation);
+
+private:
+    void close();
+
+    EstimationShmHeader *m_header = nullptr;
+    EstimationShmSlot *m_slots = nullptr;
+    size_t m_mappedBytes = 0;
+    uint64_t m_published = 0;
+    std::string m_name = {};
+};
+
+} // namespace qpmu
+
+#endif // QPMU_CORE_ESTIMATION_PUBLISHER_H
@@ -0,0 +1,171 @@
+#ifndef QPMU_CORE_PIPELINE_H
+#define QPMU_CORE_PIPELINE_H
+
+#include "qpmu/defs.h"
+#include "qpmu/decimator.h"
+#include "qpmu/estimator.h"
+#include "qpmu/input_monitor.h"
+#include "qpmu/metrics.h"
+#include "qpmu/reporting.h"
+#include "qpmu/sample_source.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+struct PipelineConfig
+{
+    /// Nominal frequency and sampling rate of the input samples (in Hz)
+    size_t nominalFrequency = 50;
+    size_t samplingRate = 1200;
+
+    /// Windows of the estimator: nominal cycles of the phasors, and microseconds of the
+    /// frequencies and the sampling rate
+    size_t windowCycles = 1;
+    int64_t frequencyWindowUsec = TimeDenom;
+
+    /// Estimations whose magnitudes are medianed by `lastEstimationFiltered()`, for the voltage
+    /// and the current signals; at most `Pipeline::HistorySize`
+    size_t voltageMedianWindow = 100;
+    size_t currentMedianWindow = 32;
+
+    /// Reporting rates (frames per second), each with its own schedule and anti-alias filter
+    std::vector<uint32_t> reportingRates = { 50 };
+    FilterClass filterClass = ProtectionClass;
+
+    /// Rate of the estimations passed to the archive callback (0: none); one of the reporting
+    /// rates, or else one more schedule and filter
+    uint32_t archiveRate = 0;
+
+    /// Tolerances of the input monitor: the jitter of a sampling interval, as a fraction of the
+    /// nominal interval, and the drift of the mean interval from the one of the first second, in
+    /// parts per million
+    Float jitterTolerance = 0.1;
+    Float driftTolerancePpm = 5000;
+
+    /// Value of the `station` label of the pipeline's metrics
+    std::string station = "0";
+};
+
+/// @brief Acquisition pipeline of one station: reads samples, estimates phasors, keeps a short
+/// history for display, and reports the filtered estimation at every reporting instant.
+///
+/// Only the standard library is used, so the pipeline runs on any thread -- a `QThread` in the
+/// app, a `std::thread` in tools and benchmarks, or the caller's own loop via `process()`. The
+/// history is guarded by a mutex for the snapshot accessors, which may be called from any thread;
+/// the callbacks are invoked on the processing thread, outside the lock.
+class Pipeline
+{
+public:
+    /// Number of samples and estimations kept in the history
+    static constexpr size_t HistorySize = 128;
+
+    using SampleWindow = std::array<Sample, HistorySize>;
+    using EstimationWindow = std::array<Estimation, HistorySize>;
+
+    using ReportCallback = std::function<void(const ReportingInstant &, const Estimation &)>;
+    using ErrorCallback = std::function<void(const std::string &)>;
+    using EstimationCallback = std::function<void(const Sample &, const Estimation &)>;
+
+    /// Schedule and anti-alias filter of one reporting rate
+    struct Reporter
+    {
+        ReportingScheduler scheduler;
+        DecimationFilter filter;
+        /// Input health flags raised since the last reported instant
+        uint32_t inputFlags = 0;
+        /// Whether the instants go to the report callback, and to the archive callback
+        bool report = true;
+        bool archive = false;
+    };
+
+    explicit Pipeline(const PipelineConfig &config = PipelineConfig());
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    void setReportCallback(ReportCallback callback) { m_onReport = std::move(callback); }
+    void setErrorCallback(ErrorCallback callback) { m_onError = std::move(callback); }
+    void setArchiveCallback(ReportCallback callback) { m_onArchive = std::move(callback); }
+
+    /// Called with every sample and the estimation from it, before the reporting; must not block
+    void setEstimationCallback(EstimationCallback callback)
+    {
+        m_onEstimation = std::move(callback);
+    }
+
+    /// Estimates from one sample, records both in the history, and reports every instant of
+    /// every rate that became due
+    void process(const Sample &sample);
+
+    /// Reads and processes samples from the source until `stop()` is called. Read errors are
+    /// passed to the error callback, and reading is retried.
+    void run(SampleSource &source);
+
+    /// Asks `run()` to return after the current read; thread-safe
+    void stop() { m_stopRequested.store(true, std::memory_order_relaxed); }
+    bool stopRequested() const { return m_stopRequested.load(std::memory_order_relaxed); }
+
+    const PipelineConfig &config() const { return m_config; }
+    const std::vector<Reporter> &reporters() const { return m_reporters; }
+    const InputMonitor &inputMonitor() const { return m_inputMonitor; }
+    const PhasorEstimator &estimator() const { return *m_estimator; }
+
+    /// Bytes of the pipeline, its estimator and its reporting filters
+    size_t memoryBytes() const;
+
+    /// Snapshots of the history; thread-safe
+    Estimation lastEstimation() const;
+    Sample lastSample() const;
+    SampleWindow sampleWindow() const;
+
+    /// Last estimation with the magnitudes replaced by their medians over the recent history
+    Estimation lastEstimationFiltered() const;
+
+private:
+    PipelineConfig m_config = {};
+    std::unique_ptr<PhasorEstimator> m_estimator = {};
+    std::vector<Reporter> m_reporters = {};
+
+    ReportCallback m_onReport = {};
+    ErrorCallback m_onError = {};
+    ReportCallback m_onArchive = {};
+    EstimationCallback m_onEstimation = {};
+    std::atomic<bool> m_stopRequested = { false };
+
+    InputMonitor m_inputMonitor;
+
+    struct
+    {
+        Counter *samples = nullptr;
+        Counter *droppedSamples = nullptr;
+        Counter *sampleGaps = nullptr;
+        Counter *duplicateSamples = nullptr;
+        Counter *jitteredIntervals = nullptr;
+        Histogram *sampleInterval = nullptr;
+        Gauge *rateDrift = nullptr;
+        Counter *inputErrors = nullptr;
+        Counter *reports = nullptr;
+        Histogram *processLatency = nullptr;
+    } m_metrics = {};
+
+    /// History, as rings whose newest entry is at `m_newest`
+    mutable std::mutex m_mutex;
+    SampleWindow m_samples = {};
+    EstimationWindow m_estimations = {};
+    size_t m_newest = HistorySize - 1;
+};
+
+/// Pins the calling thread to a CPU core; returns false if that failed or is not supported
+bool pinCurrentThread(int cpu);
+
+} // namespace qpmu
+
+#endif // QPMU_CORE_PIPELINE_H
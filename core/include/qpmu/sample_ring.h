@@ -0,0 +1,69 @@
+#ifndef QPMU_CORE_SAMPLE_RING_H
+#define QPMU_CORE_SAMPLE_RING_H
+
+#include "qpmu/defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace qpmu {
+
+/// @brief Single-producer single-consumer ring of samples in POSIX shared memory, between a
+/// sample producer (e.g., the load generator) and a station's pipeline.
+///
+/// The segment is a header -- a magic number, the capacity, and the counts of samples written
+/// and read -- followed by the slots. Each side only advances its own count, after it filled or
+/// emptied the slots, so neither side takes a lock or makes a system call per sample. Only on
+/// POSIX systems; elsewhere `create()` and `open()` fail.
+class SampleRing
+{
+public:
+    /// Default slots of a ring: a few seconds of samples at the usual rates
+    static constexpr size_t DefaultCapacity = 1 << 16;
+
+    SampleRing() = default;
+    ~SampleRing();
+
+    SampleRing(const SampleRing &) = delete;
+    SampleRing &operator=(const SampleRing &) = delete;
+
+    /// Creates the segment `name` (e.g. "/qpmu-adc"), replacing an existing one, as the producer;
+    /// the destructor marks the ring closed and removes the segment. Returns false with
+    /// the reason in `error`.
+    bool create(const std::string &name, size_t capacity, std::string &error);
+
+    /// Maps the existing segment `name`, as the consumer. Returns false with the reason in
+    /// `error`.
+    bool open(const std::string &name, std::string &error);
+
+    bool isOpen() const { return m_header != nullptr; }
+    size_t capacity() const { return m_capacity; }
+
+    /// Copies up to `count` samples into the free slots; returns the number copied, 0 if the
+    /// ring is full. Producer only.
+    size_t write(const Sample *samples, size_t count);
+
+    /// Whether the producer has closed the ring; the samples still in it can be read
+    bool isClosed() const;
+
+    /// Copies up to `count` samples out of the ring; returns the number copied, 0 if the ring is
+    /// empty. Consumer only.
+    size_t read(Sample *samples, size_t count);
+
+private:
+    struct Header;
+
+    void close();
+
+    Header *m_header = nullptr;
+    Sample *m_slots = nullptr;
+    size_t m_capacity = 0;
+    size_t m_mappedBytes = 0;
+    std::string m_name = {};
+    bool m_owner = false;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_CORE_SAMPLE_RING_H
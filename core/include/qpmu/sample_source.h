@@ -0,0 +1,108 @@
+#ifndef QPMU_CORE_SAMPLE_SOURCE_H
+#define QPMU_CORE_SAMPLE_SOURCE_H
+
+#include "qpmu/defs.h"
+#include "qpmu/sample_ring.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qpmu {
+
+/// @brief Input of an acquisition pipeline.
+class SampleSource
+{
+public:
+    virtual ~SampleSource() = default;
+
+    /// Reads up to `count` samples, blocking until they are available. Returns the number read;
+    /// when it is less than `count`, `error` says why (e.g., the end of the input).
+    virtual size_t read(Sample *samples, size_t count, std::string &error) = 0;
+
+    /// Whether the input could be opened, and why not
+    virtual bool isOpen() const { return true; }
+    const std::string &openError() const { return m_openError; }
+
+protected:
+    std::string m_openError = {};
+};
+
+/// @brief Binary `Sample` records from a file, a pipe or a character device (e.g., the ADC
+/// stream).
+class FileSampleSource : public SampleSource
+{
+public:
+    /// Reads from an open stream, e.g., stdin, which is not closed by the source
+    explicit FileSampleSource(FILE *file);
+
+    /// Opens the file at the path; check `isOpen()`
+    explicit FileSampleSource(const std::string &path);
+
+    ~FileSampleSource() override;
+
+    FileSampleSource(const FileSampleSource &) = delete;
+    FileSampleSource &operator=(const FileSampleSource &) = delete;
+
+    bool isOpen() const override { return m_file != nullptr; }
+
+    size_t read(Sample *samples, size_t count, std::string &error) override;
+
+private:
+    FILE *m_file = nullptr;
+    bool m_owned = false;
+};
+
+/// @brief Binary `Sample` records from UDP datagrams, each holding one or more whole records.
+///
+/// A datagram whose size is not a multiple of the record size is truncated: its whole records
+/// are read, after a read that returns none and says so. Only on POSIX systems.
+class UdpSampleSource : public SampleSource
+{
+public:
+    /// Binds to the port on the local address (empty: all addresses)
+    UdpSampleSource(const std::string &address, uint16_t port);
+    ~UdpSampleSource() override;
+
+    UdpSampleSource(const UdpSampleSource &) = delete;
+    UdpSampleSource &operator=(const UdpSampleSource &) = delete;
+
+    bool isOpen() const override { return m_socket >= 0; }
+
+    size_t read(Sample *samples, size_t count, std::string &error) override;
+
+private:
+    int m_socket = -1;
+    std::vector<uint8_t> m_datagram = {};
+    std::vector<Sample> m_pending = {};
+    size_t m_nextPending = 0;
+    std::string m_pendingError = {};
+};
+
+/// @brief Samples from a `SampleRing` in shared memory, which the producer must have created.
+///
+/// An empty ring is polled every 100 µs, so a read blocks until samples are available, or ends
+/// the stream once the producer has closed the ring.
+class SharedMemorySampleSource : public SampleSource
+{
+public:
+    explicit SharedMemorySampleSource(const std::string &name);
+
+    bool isOpen() const override { return m_ring.isOpen(); }
+
+    size_t read(Sample *samples, size_t count, std::string &error) override;
+
+private:
+    SampleRing m_ring;
+};
+
+/// Opens the input named by a station's `input` setting: `udp://[ADDRESS]:PORT`, `shm://NAME`
+/// (a `SampleRing`), or else the path of a file, a pipe or a device. Check `isOpen()`.
+std::unique_ptr<SampleSource> openSampleSource(const std::string &input);
+
+} // namespace qpmu
+
+#endif // QPMU_CORE_SAMPLE_SOURCE_H
@@ -0,0 +1,109 @@
+#include "qpmu/estimation_feed.h"
+
+#include <cstring>
+
+#ifdef __unix__
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace qpmu {
+
+static_assert(CountSignals == EstimationPacket::Signals, "A packet has one phasor per signal");
+
+EstimationFeed::~EstimationFeed()
+{
+    close();
+}
+
+void EstimationFeed::close()
+{
+#ifdef __unix__
+    if (m_socket >= 0) {
+        ::close(m_socket);
+    }
+#endif
+    m_socket = -1;
+}
+
+bool EstimationFeed::open(const EstimationFeedConfig &config, std::string &error)
+{
+    close();
+#ifdef __unix__
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    if (::inet_pton(AF_INET, config.host.c_str(), &address.sin_addr) != 1 || config.port == 0) {
+        error = "Invalid feed destination " + config.host + ":" + std::to_string(config.port);
+        return false;
+    }
+    if (config.rate > TimeDenom) {
+        error = "Invalid feed rate " + std::to_string(config.rate);
+        return false;
+    }
+    m_socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) {
+        error = std::string("Failed to create the feed socket: ") + std::strerror(errno);
+        return false;
+    }
+    const unsigned char ttl = (unsigned char)config.multicastTtl;
+    const unsigned char loopback = 1;
+    ::setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    ::setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loopback, sizeof(loopback));
+
+    m_address = address.sin_addr.s_addr;
+    m_port = address.sin_port;
+    m_config = config;
+    m_scheduler.reset(config.rate ? new ReportingScheduler(config.rate) : nullptr);
+    m_sequence = 0;
+    m_sendErrors = 0;
+    return true;
+#else
+    (void)config;
+    error = "The estimation feed is only supported on POSIX systems";
+    return false;
+#endif
+}
+
+void EstimationFeed::publish(const Sample &sample, const Estimation &estimation)
+{
+    if (m_socket < 0) {
+        return;
+    }
+    ReportingInstant instant;
+    if (m_scheduler && !m_scheduler->update(sample.timestampUsec, instant)) {
+        return;
+    }
+
+    EstimationPacket packet;
+    packet.idCode = m_config.idCode;
+    packet.sequence = m_sequence++;
+    packet.timestampUsec = sample.timestampUsec;
+    for (size_t i = 0; i < CountSignals; ++i) {
+        packet.phasors[i][0] = (float)estimation.phasors[i].real();
+        packet.phasors[i][1] = (float)estimation.phasors[i].imag();
+        packet.frequencies[i] = (float)estimation.frequencies[i];
+        packet.rocofs[i] = (float)estimation.rocofs[i];
+    }
+    packet.samplingRate = (float)estimation.samplingRate;
+
+    uint8_t data[EstimationPacket::Size];
+    packet.encode(data);
+#ifdef __unix__
+    /// A datagram that cannot be sent is dropped, as on the network; the receivers see the gap
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = m_address;
+    address.sin_port = m_port;
+    if (::sendto(m_socket, data, sizeof(data), MSG_DONTWAIT, (const sockaddr *)&address,
+                 sizeof(address))
+        < 0) {
+        ++m_sendErrors;
+    }
+#endif
+}
+
+} // namespace qpmu
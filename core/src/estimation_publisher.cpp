@@ -0,0 +1,149 @@
+#include "qpmu/estimation_publisher.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#ifdef __unix__
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace qpmu {
+
+static_assert(CountSignals == EstimationShmSignals,
+              "The record layout has one phasor per signal");
+
+EstimationPublisher::~EstimationPublisher()
+{
+    close();
+}
+
+void EstimationPublisher::close()
+{
+#ifdef __unix__
+    if (m_header) {
+        m_header->closed.store(1, std::memory_order_release);
+        ::munmap((void *)m_header, m_mappedBytes);
+        ::shm_unlink(m_name.c_str());
+    }
+#endif
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_mappedBytes = 0;
+    m_published = 0;
+}
+
+#ifdef __unix__
+/// Marks a ring left by an earlier publisher (e.g., one that did not exit cleanly) closed, so that
+/// its readers reopen the name and find the new ring
+static void closeStale(const std::string &name)
+{
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct stat status;
+    if (::fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(EstimationShmHeader)) {
+        void *data = ::mmap(nullptr, sizeof(EstimationShmHeader), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            auto header = (EstimationShmHeader *)data;
+            if (header->magic == EstimationShmHeader::Magic) {
+                header->closed.store(1, std::memory_order_release);
+            }
+            ::munmap(data, sizeof(EstimationShmHeader));
+        }
+    }
+    ::close(fd);
+}
+#endif
+
+bool EstimationPublisher::create(const std::string &name, uint32_t idCode, size_t capacity,
+                                 std::string &error)
+{
+    close();
+#ifdef __unix__
+    if (capacity == 0 || capacity > UINT32_MAX) {
+        error = "Invalid capacity of an estimation ring";
+        return false;
+    }
+    closeStale(name);
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        error = "Failed to create the shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    const auto bytes = sizeof(EstimationShmHeader) + capacity * sizeof(EstimationShmSlot);
+    void *data = MAP_FAILED;
+    if (::ftruncate(fd, (off_t)bytes) == 0) {
+        data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int savedErrno = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        error = "Failed to map the shared memory " + name + ": " + std::strerror(savedErrno);
+        return false;
+    }
+
+    /// The new segment is zero-filled, so every slot starts at version 0: empty
+    m_header = new (data) EstimationShmHeader();
+    m_header->layoutVersion = EstimationShmHeader::LayoutVersion;
+    m_header->slotSize = sizeof(EstimationShmSlot);
+    m_header->capacity = (uint32_t)capacity;
+    m_header->idCode = idCode;
+    m_header->closed.store(0, std::memory_order_relaxed);
+    m_header->published.store(0, std::memory_order_relaxed);
+    m_slots = (EstimationShmSlot *)(m_header + 1);
+    m_mappedBytes = bytes;
+    m_name = name;
+
+    /// The magic number last, so that a reader never accepts a half-initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = EstimationShmHeader::Magic;
+    return true;
+#else
+    (void)name;
+    (void)idCode;
+    (void)capacity;
+    error = "Shared memory estimation rings are only supported on POSIX systems";
+    return false;
+#endif
+}
+
+void EstimationPublisher::publish(const Sample &sample, const Estimation &estimation)
+{
+    if (!m_header) {
+        return;
+    }
+    const auto sequence = m_published;
+    auto &slot = m_slots[sequence % m_header->capacity];
+
+    /// Odd while writing; readers that see it, or see it change, discard their copy
+    slot.version.store(2 * sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto &record = slot.record;
+    record.sequence = sequence;
+    record.sampleSequence = sample.seq;
+    record.timestampUsec = sample.timestampUsec;
+    for (size_t i = 0; i < CountSignals; ++i) {
+        record.phasors[i][0] = (float)estimation.phasors[i].real();
+        record.phasors[i][1] = (float)estimation.phasors[i].imag();
+        record.frequencies[i] = (float)estimation.frequencies[i];
+        record.rocofs[i] = (float)estimation.rocofs[i];
+    }
+    record.samplingRate = (float)estimation.samplingRate;
+    record.reserved = 0;
+
+    slot.version.store(2 * sequence + 2, std::memory_order_release);
+    m_header->published.store(sequence + 1, std::memory_order_release);
+    m_published = sequence + 1;
+}
+
+} // namespace qpmu
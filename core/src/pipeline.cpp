@@ -0,0 +1,277 @@
+#include "qpmu/pipeline.h"
+#include "qpmu/clock.h"
+#include "qpmu/trace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#ifdef __linux__
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+namespace qpmu {
+
+namespace {
+
+template <class T>
+T median(std::vector<T> vec)
+{
+    assert(!vec.empty());
+    std::sort(vec.begin(), vec.end());
+    size_t n = vec.size();
+    if (n % 2 == 1) {
+        return vec[n / 2];
+    } else {
+        return (vec[n / 2 - 1] + vec[n / 2]) / 2;
+    }
+}
+
+} // namespace
+
+Pipeline::Pipeline(const PipelineConfig &config)
+    : m_config(config),
+      m_estimator(new PhasorEstimator(config.nominalFrequency, config.samplingRate,
+                                      config.windowCycles, config.frequencyWindowUsec)),
+      m_inputMonitor((Float)config.samplingRate, config.jitterTolerance, config.driftTolerancePpm)
+{
+    auto addReporter = [this](uint32_t rate) {
+        m_reporters.push_back({ ReportingScheduler(rate),
+                                DecimationFilter(m_config.nominalFrequency, m_config.samplingRate,
+                                                 rate, m_config.filterClass) });
+        return &m_reporters.back();
+    };
+    for (auto rate : m_config.reportingRates) {
+        addReporter(rate);
+    }
+    if (m_config.archiveRate > 0) {
+        auto reporter = std::find_if(m_reporters.begin(), m_reporters.end(),
+                                     [&](const Reporter &r) {
+                                         return r.scheduler.reportingRate() == m_config.archiveRate;
+                                     });
+        if (reporter != m_reporters.end()) {
+            reporter->archive = true;
+        } else {
+            auto added = addReporter(m_config.archiveRate);
+            added->report = false;
+            added->archive = true;
+        }
+    }
+
+    auto &registry = MetricsRegistry::instance();
+    const auto labels = "station=\"" + m_config.station + "\"";
+    m_metrics.samples = &registry.counter("qpmu_samples_total", "Samples read from the input.",
+                                          labels);
+    m_metrics.droppedSamples = &registry.counter(
+            "qpmu_samples_dropped_total",
+            "Samples missing from the input, from gaps in their sequence numbers.", labels);
+    m_metrics.sampleGaps = &registry.counter(
+            "qpmu_sample_gaps_total", "Gaps in the sequence numbers of the input samples.", labels);
+    m_metrics.duplicateSamples = &registry.counter(
+            "qpmu_samples_duplicate_total",
+            "Input samples whose sequence number repeats or goes back.", labels);
+    m_metrics.jitteredIntervals = &registry.counter(
+            "qpmu_sample_jitter_total",
+            "Sampling intervals off the running mean by more than the jitter tolerance.", labels);
+    m_metrics.sampleInterval = &registry.histogram(
+            "qpmu_sample_interval_us", "Interval between consecutive input samples.",
+            m_inputMonitor.intervalBucketsUsec(), labels);
+    m_metrics.rateDrift = &registry.gauge(
+            "qpmu_sample_interval_drift_ppm",
+            "Drift of the mean sampling interval from the nominal one, in parts per million.",
+            labels);
+    m_metrics.inputErrors = &registry.counter("qpmu_input_errors_total",
+                                              "Failed reads from the input.", labels);
+    m_metrics.reports = &registry.counter(
+            "qpmu_estimations_reported_total",
+            "Filtered estimations reported at reporting instants, over all rates.", labels);
+    m_metrics.processLatency = &registry.histogram(
+            "qpmu_process_latency_us",
+            "Time to process one sample: estimation, history and reporting filters.",
+            latencyBucketsUsec(), labels);
+}
+
+void Pipeline::process(const Sample &sample)
+{
+    QPMU_TRACE_SCOPE("process sample");
+    const auto start = std::chrono::steady_clock::now();
+    advanceVirtualClock(sample.timestampUsec);
+    const auto dequeuedUsec = currentTimeUsec();
+
+    m_metrics.samples->add();
+    const auto check = m_inputMonitor.update(sample);
+    if (check.flags & SampleGapFlag) {
+        m_metrics.sampleGaps->add();
+        m_metrics.droppedSamples->add(check.missingSamples);
+    }
+    if (check.flags & DuplicateSampleFlag) {
+        m_metrics.duplicateSamples->add();
+    }
+    if (check.flags & TimingJitterFlag) {
+        m_metrics.jitteredIntervals->add();
+    }
+    if (check.intervalUsec >= 0) {
+        m_metrics.sampleInterval->record(check.intervalUsec);
+    }
+    m_metrics.rateDrift->set((int64_t)std::lround(m_inputMonitor.driftPpm()));
+
+    {
+        QPMU_TRACE_SCOPE("estimate");
+        m_estimator->updateEstimation(sample);
+    }
+    const auto &estimation = m_estimator->currentEstimation();
+
+    {
+        QPMU_TRACE_SCOPE("record history");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_newest = (m_newest + 1) % HistorySize;
+        m_samples[m_newest] = sample;
+        m_estimations[m_newest] = estimation;
+    }
+
+    if (m_onEstimation) {
+        m_onEstimation(sample, estimation);
+    }
+
+    /// Report as soon as the filter output for the pending reporting instant is ready; the output
+    /// refers to the center of the filter's window, one group delay in the past, which is rotated
+    /// back to the instant itself. The delay is a number of samples, so it is timed with the
+    /// input's measured sampling interval once there is one: at 841 us rather than 833 us, the
+    /// nominal delay of an M-class window would be off by some 10 degrees at 50 Hz.
+    const auto intervalUsec = m_inputMonitor.meanIntervalUsec();
+    for (auto &reporter : m_reporters) {
+        reporter.filter.push(estimation);
+        reporter.inputFlags |= check.flags;
+        ReportingInstant instant;
+        const auto delayUsec = intervalUsec > 0
+                ? (int64_t)std::llround(reporter.filter.groupDelaySamples() * intervalUsec)
+                : reporter.filter.groupDelayUsec();
+        auto centerUsec = sample.timestampUsec - delayUsec;
+        if (!reporter.scheduler.update(centerUsec, instant)) {
+            continue;
+        }
+        instant.inputFlags = reporter.inputFlags;
+        reporter.inputFlags = 0;
+        if (reporter.report) {
+            m_metrics.reports->add();
+        }
+        const auto output = rotateToInstant(reporter.filter.output(), instant.offsetUsec,
+                                            (Float)m_config.nominalFrequency);
+        if (reporter.report && m_onReport) {
+            QPMU_TRACE_SCOPE("report");
+            instant.sampleUsec = sample.timestampUsec;
+            instant.dequeuedUsec = dequeuedUsec;
+            instant.estimatedUsec = currentTimeUsec();
+            m_onReport(instant, output);
+        }
+        if (reporter.archive && m_onArchive) {
+            m_onArchive(instant, output);
+        }
+    }
+
+    m_metrics.processLatency->record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                             std::chrono::steady_clock::now() - start)
+                                             .count());
+}
+
+void Pipeline::run(SampleSource &source)
+{
+    Sample sample;
+    std::string error;
+    while (!stopRequested()) {
+        error.clear();
+        size_t count;
+        {
+            QPMU_TRACE_SCOPE("read sample");
+            count = source.read(&sample, 1, error);
+        }
+        if (count == 1) {
+            process(sample);
+            continue;
+        }
+        m_metrics.inputErrors->add();
+        if (m_onError) {
+            m_onError(error);
+        }
+    }
+}
+
+Estimation Pipeline::lastEstimation() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_estimations[m_newest];
+}
+
+Sample Pipeline::lastSample() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_samples[m_newest];
+}
+
+size_t Pipeline::memoryBytes() const
+{
+    auto bytes = sizeof(*this) + m_estimator->memoryBytes()
+            + m_reporters.capacity() * sizeof(Reporter);
+    for (const auto &reporter : m_reporters) {
+        bytes += reporter.filter.memoryBytes();
+    }
+    return bytes;
+}
+
+Pipeline::SampleWindow Pipeline::sampleWindow() const
+{
+    QPMU_TRACE_SCOPE("sample window snapshot");
+    SampleWindow window;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t j = 0; j < HistorySize; ++j) {
+        window[j] = m_samples[(m_newest + 1 + j) % HistorySize];
+    }
+    return window;
+}
+
+Estimation Pipeline::lastEstimationFiltered() const
+{
+    QPMU_TRACE_SCOPE("filtered estimation snapshot");
+    std::vector<Float> filterableMagnitudes[CountSignals];
+    Estimation result;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        result = m_estimations[m_newest];
+        for (size_t i = 0; i < CountSignals; ++i) {
+            size_t medianWindowSize = TypeOfSignal[i] == VoltageSignal
+                    ? m_config.voltageMedianWindow
+                    : m_config.currentMedianWindow;
+            medianWindowSize = std::clamp(medianWindowSize, (size_t)1, HistorySize);
+            filterableMagnitudes[i].resize(medianWindowSize);
+            size_t oldest = m_newest + HistorySize - medianWindowSize + 1;
+            for (size_t j = 0; j < medianWindowSize; ++j) {
+                filterableMagnitudes[i][j] =
+                        std::abs(m_estimations[(oldest + j) % HistorySize].phasors[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < CountSignals; ++i) {
+        auto medianMagnitude = median(filterableMagnitudes[i]);
+        result.phasors[i] = std::polar(medianMagnitude, std::arg(result.phasors[i]));
+    }
+    return result;
+}
+
+bool pinCurrentThread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+} // namespace qpmu
@@ -0,0 +1,187 @@
+#include "qpmu/sample_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#ifdef __unix__
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace qpmu {
+
+namespace {
+
+constexpr uint32_t RingMagic = 0x51524e47; // "QRNG"
+
+} // namespace
+
+struct SampleRing::Header
+{
+    uint32_t magic = 0;
+    uint32_t sampleSize = 0;
+    uint64_t capacity = 0;
+
+    /// Each on its own cache line, since the producer and the consumer write them concurrently
+    alignas(64) std::atomic<uint64_t> written = { 0 };
+    alignas(64) std::atomic<uint64_t> read = { 0 };
+    /// Set by the producer when it closes the ring, after its last write
+    std::atomic<uint32_t> closed = { 0 };
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The ring's counts must be lock-free to be shared between processes");
+
+SampleRing::~SampleRing()
+{
+    close();
+}
+
+void SampleRing::close()
+{
+#ifdef __unix__
+    if (m_header) {
+        if (m_owner) {
+            m_header->closed.store(1, std::memory_order_release);
+        }
+        ::munmap((void *)m_header, m_mappedBytes);
+    }
+    if (m_owner) {
+        ::shm_unlink(m_name.c_str());
+    }
+#endif
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_mappedBytes = 0;
+    m_owner = false;
+}
+
+bool SampleRing::create(const std::string &name, size_t capacity, std::string &error)
+{
+    close();
+#ifdef __unix__
+    if (capacity == 0) {
+        error = "The capacity of a sample ring must be positive";
+        return false;
+    }
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        error = "Failed to create the shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    const auto bytes = sizeof(Header) + capacity * sizeof(Sample);
+    void *data = MAP_FAILED;
+    if (::ftruncate(fd, (off_t)bytes) == 0) {
+        data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int savedErrno = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        error = "Failed to map the shared memory " + name + ": " + std::strerror(savedErrno);
+        return false;
+    }
+
+    m_header = new (data) Header();
+    m_header->sampleSize = sizeof(Sample);
+    m_header->capacity = capacity;
+    m_slots = (Sample *)((uint8_t *)data + sizeof(Header));
+    m_capacity = capacity;
+    m_mappedBytes = bytes;
+    m_name = name;
+    m_owner = true;
+
+    /// The magic number last, so that a consumer never accepts a half-initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = RingMagic;
+    return true;
+#else
+    (void)name;
+    (void)capacity;
+    error = "Shared memory sample rings are only supported on POSIX systems";
+    return false;
+#endif
+}
+
+bool SampleRing::open(const std::string &name, std::string &error)
+{
+    close();
+#ifdef __unix__
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "Failed to open the shared memory " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat status;
+    void *data = MAP_FAILED;
+    size_t bytes = 0;
+    if (::fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(Header)) {
+        bytes = (size_t)status.st_size;
+        data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = "Failed to map the shared memory " + name;
+        return false;
+    }
+
+    auto header = (Header *)data;
+    if (header->magic != RingMagic || header->sampleSize != sizeof(Sample)
+        || bytes < sizeof(Header) + header->capacity * sizeof(Sample)) {
+        ::munmap(data, bytes);
+        error = "The shared memory " + name + " is not a sample ring of this build";
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    m_header = header;
+    m_slots = (Sample *)((uint8_t *)data + sizeof(Header));
+    m_capacity = header->capacity;
+    m_mappedBytes = bytes;
+    m_name = name;
+    return true;
+#else
+    (void)name;
+    error = "Shared memory sample rings are only supported on POSIX systems";
+    return false;
+#endif
+}
+
+bool SampleRing::isClosed() const
+{
+    return m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+size_t SampleRing::write(const Sample *samples, size_t count)
+{
+    const auto written = m_header->written.load(std::memory_order_relaxed);
+    const auto read = m_header->read.load(std::memory_order_acquire);
+    count = std::min<size_t>(count, m_capacity - (written - read));
+    const auto first = (size_t)(written % m_capacity);
+    const auto head = std::min(count, m_capacity - first);
+    std::memcpy((void *)(m_slots + first), samples, head * sizeof(Sample));
+    std::memcpy((void *)m_slots, samples + head, (count - head) * sizeof(Sample));
+    m_header->written.store(written + count, std::memory_order_release);
+    return count;
+}
+
+size_t SampleRing::read(Sample *samples, size_t count)
+{
+    const auto read = m_header->read.load(std::memory_order_relaxed);
+    const auto written = m_header->written.load(std::memory_order_acquire);
+    count = std::min<size_t>(count, written - read);
+    const auto first = (size_t)(read % m_capacity);
+    const auto head = std::min(count, m_capacity - first);
+    std::memcpy((void *)samples, m_slots + first, head * sizeof(Sample));
+    std::memcpy((void *)(samples + head), m_slots, (count - head) * sizeof(Sample));
+    m_header->read.store(read + count, std::memory_order_release);
+    return count;
+}
+
+} // namespace qpmu
@@ -0,0 +1,194 @@
+#include "qpmu/sample_source.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef __unix__
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#endif
+
+namespace qpmu {
+
+FileSampleSource::FileSampleSource(FILE *file) : m_file(file), m_owned(false) { }
+
+FileSampleSource::FileSampleSource(const std::string &path)
+    : m_file(std::fopen(path.c_str(), "rb")), m_owned(true)
+{
+    if (!m_file) {
+        m_openError = "Failed to open " + path + ": " + std::strerror(errno);
+    }
+}
+
+FileSampleSource::~FileSampleSource()
+{
+    if (m_owned && m_file) {
+        std::fclose(m_file);
+    }
+}
+
+size_t FileSampleSource::read(Sample *samples, size_t count, std::string &error)
+{
+    if (!m_file) {
+        error = "Input stream is not open";
+        return 0;
+    }
+    auto nread = std::fread((void *)samples, sizeof(Sample), count, m_file);
+    if (nread < count) {
+        if (std::feof(m_file)) {
+            error = "End of input stream reached";
+        } else if (std::ferror(m_file)) {
+            error = "Error reading from input stream";
+        }
+    }
+    return nread;
+}
+
+UdpSampleSource::UdpSampleSource(const std::string &address, uint16_t port)
+{
+#ifdef __unix__
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!address.empty() && ::inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1) {
+        m_openError = "Invalid IPv4 address: " + address;
+        return;
+    }
+    m_socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) {
+        m_openError = std::string("Failed to create a UDP socket: ") + std::strerror(errno);
+        return;
+    }
+
+    /// Room for bursts of datagrams while the pipeline is busy
+    int bufferBytes = 4 << 20;
+    ::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+    if (::bind(m_socket, (const sockaddr *)&local, sizeof(local)) != 0) {
+        m_openError = "Failed to bind to UDP port " + std::to_string(port) + ": "
+                + std::strerror(errno);
+        ::close(m_socket);
+        m_socket = -1;
+        return;
+    }
+    m_datagram.resize(65536);
+#else
+    (void)address;
+    (void)port;
+    m_openError = "UDP sample sources are only supported on POSIX systems";
+#endif
+}
+
+UdpSampleSource::~UdpSampleSource()
+{
+#ifdef __unix__
+    if (m_socket >= 0) {
+        ::close(m_socket);
+    }
+#endif
+}
+
+size_t UdpSampleSource::read(Sample *samples, size_t count, std::string &error)
+{
+    if (m_socket < 0) {
+        error = "Input socket is not open";
+        return 0;
+    }
+    size_t nread = 0;
+    while (nread < count) {
+        if (!m_pendingError.empty()) {
+            if (nread == 0) {
+                error.swap(m_pendingError);
+                m_pendingError.clear();
+            }
+            return nread;
+        }
+        if (m_nextPending < m_pending.size()) {
+            const auto n = std::min(count - nread, m_pending.size() - m_nextPending);
+            std::memcpy((void *)(samples + nread), m_pending.data() + m_nextPending,
+                        n * sizeof(Sample));
+            m_nextPending += n;
+            nread += n;
+            continue;
+        }
+        if (nread > 0) {
+            return nread;
+        }
+
+#ifdef __unix__
+        const auto size = ::recv(m_socket, m_datagram.data(), m_datagram.size(), 0);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = std::string("Error reading from the UDP socket: ") + std::strerror(errno);
+            return 0;
+        }
+        const auto countRecords = (size_t)size / sizeof(Sample);
+        m_pending.resize(countRecords);
+        std::memcpy((void *)m_pending.data(), m_datagram.data(), countRecords * sizeof(Sample));
+        m_nextPending = 0;
+        if ((size_t)size % sizeof(Sample) != 0) {
+            m_pendingError = "Truncated datagram of " + std::to_string(size) + " bytes";
+        }
+#endif
+    }
+    return nread;
+}
+
+SharedMemorySampleSource::SharedMemorySampleSource(const std::string &name)
+{
+    m_ring.open(name, m_openError);
+}
+
+size_t SharedMemorySampleSource::read(Sample *samples, size_t count, std::string &error)
+{
+    if (!m_ring.isOpen()) {
+        error = "Input ring is not open";
+        return 0;
+    }
+    size_t nread = 0;
+    while (nread == 0) {
+        /// Check for the end before reading, so that no sample written before it is missed
+        const bool closed = m_ring.isClosed();
+        nread = m_ring.read(samples, count);
+        if (nread == 0 && closed) {
+            error = "End of input stream reached";
+            break;
+        }
+        if (nread == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    return nread;
+}
+
+std::unique_ptr<SampleSource> openSampleSource(const std::string &input)
+{
+    const std::string udpScheme = "udp://";
+    const std::string shmScheme = "shm://";
+    if (input.compare(0, udpScheme.size(), udpScheme) == 0) {
+        const auto hostPort = input.substr(udpScheme.size());
+        const auto colon = hostPort.rfind(':');
+        const auto port = colon == std::string::npos
+                ? 0
+                : std::strtoul(hostPort.c_str() + colon + 1, nullptr, 10);
+        const auto address = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+        return std::unique_ptr<SampleSource>(new UdpSampleSource(address, (uint16_t)port));
+    }
+    if (input.compare(0, shmScheme.size(), shmScheme) == 0) {
+        auto name = input.substr(shmScheme.size());
+        if (name.empty() || name[0] != '/') {
+            name = "/" + name;
+        }
+        return std::unique_ptr<SampleSource>(new SharedMemorySampleSource(name));
+    }
+    return std::unique_ptr<SampleSource>(new FileSampleSource(input));
+}
+
+} // namespace qpmu
@@ -0,0 +1,111 @@
+#include "qpmu/defs.h"
+#include "qpmu/metrics.h"
+#include "qpmu/trace.h"
+#include "data_processor.h"
+#include "phasor_server.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#  include <QSocketNotifier>
+#  include <csignal>
+#  include <sys/socket.h>
+#  include <unistd.h>
+
+namespace {
+
+/// Written to by the signal handler (one byte, the signal number), and read from the event loop
+int signalFds[2] = { -1, -1 };
+
+void handleSignal(int signal)
+{
+    char c = (char)signal;
+    auto ignored = ::write(signalFds[0], &c, 1);
+    (void)ignored;
+}
+
+} // namespace
+#endif
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QPMU_TRACE_THREAD_NAME("main");
+    app.setOrganizationName(qpmu::OrgName);
+    app.setApplicationName(qpmu::AppName);
+
+    auto dataProcessor = new DataProcessor();
+    dataProcessor->start();
+    dataProcessor->setPriority(QThread::TimeCriticalPriority);
+
+    /// In place of the app's status bar, log the server state periodically
+    constexpr int StatusIntervalMs = 10000;
+    QTimer statusTimer;
+    QObject::connect(&statusTimer, &QTimer::timeout, [=] {
+        auto server = dataProcessor->phasorServer();
+        auto latency = server->dispatchLatency();
+        qInfo() << QDateTime::currentDateTime()
+                << qPrintable(PhasorServer::stateString(server->connState())) << "| clients:"
+                << server->countClients() << "| latency (min/mean/max):" << latency.minUsec
+                << latency.meanUsec() << latency.maxUsec << "us";
+    });
+    statusTimer.start(StatusIntervalMs);
+
+#ifdef Q_OS_UNIX
+    /// `kill -USR1` dumps the latency percentiles to the log, and `kill -USR2` the trace events
+    /// to a file in the temporary directory. `kill -HUP` reloads the station names and ID codes
+    /// into the phasor server. SIGTERM and SIGINT quit the event loop, so that the archive is
+    /// flushed.
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) == 0) {
+        auto notifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, &QSocketNotifier::activated, [=] {
+            char c;
+            if (::read(signalFds[1], &c, 1) != 1) {
+                return;
+            }
+            if (c == SIGTERM || c == SIGINT) {
+                QCoreApplication::quit();
+                return;
+            }
+            if (c == SIGHUP) {
+                QMetaObject::invokeMethod(dataProcessor->phasorServer(),
+                                          &PhasorServer::reloadStationSettings);
+                return;
+            }
+            const auto now = QDateTime::currentDateTime();
+            if (c == SIGUSR1) {
+                qInfo().noquote() << now.toString(Qt::ISODate) << "\n"
+                                  << QString::fromStdString(qpmu::MetricsRegistry::instance()
+                                                                    .renderLatencyReport());
+                return;
+            }
+            if (!qpmu::TraceRecorder::enabled()) {
+                qWarning() << "Tracing is not compiled in; rebuild with -DENABLE_TRACING=ON";
+                return;
+            }
+            const auto path = QDir::temp().filePath(QStringLiteral("qpmu-trace-%1-%2.json")
+                                                            .arg(QCoreApplication::applicationPid())
+                                                            .arg(now.toString("yyyyMMdd-hhmmss")));
+            if (qpmu::TraceRecorder::instance().writeChromeJson(path.toStdString())) {
+                qInfo() << "Trace written to" << path;
+            } else {
+                qWarning() << "Failed to write the trace to" << path;
+            }
+        });
+        std::signal(SIGHUP, handleSignal);
+        std::signal(SIGUSR1, handleSignal);
+        std::signal(SIGUSR2, handleSignal);
+        std::signal(SIGTERM, handleSignal);
+        std::signal(SIGINT, handleSignal);
+    } else {
+        qWarning() << "Failed to set up the signal handlers";
+    }
+#endif
+
+    return app.exec();
+}
@@ -0,0 +1,72 @@
+#ifndef QPMU_DECIMATOR_H
+#define QPMU_DECIMATOR_H
+
+#include "qpmu/defs.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace qpmu {
+
+/// Performance classes of IEEE C37.118.1 reporting filters
+enum FilterClass {
+    /// P class: short triangular filter over two nominal cycles, for low latency
+    ProtectionClass = 0,
+    /// M class: Hamming-windowed low-pass filter that removes content above the reporting
+    /// Nyquist frequency, for anti-aliased measurements
+    MeasurementClass = 1,
+};
+
+/// @brief Anti-alias decimation filter between the per-sample estimations and the reported ones.
+///
+/// The estimations are only stored as they arrive; the FIR sum is evaluated only when an output
+/// is requested at a reporting instant, i.e., only the one polyphase branch that lands on an
+/// output sample is ever computed. Phasors are weighted with complex taps that also rotate each
+/// past phasor to the window center, since the estimator's phasors advance by one sample's worth
+/// of nominal phase per sample.
+class DecimationFilter
+{
+public:
+    DecimationFilter(size_t fn, size_t fs, uint32_t reportingRate, FilterClass filterClass);
+
+    /// Stores an estimation; O(1)
+    void push(const Estimation &estimation);
+
+    /// Filter output for the window center, i.e., `groupDelayUsec()` before the last estimation
+    Estimation output() const;
+
+    uint32_t reportingRate() const { return m_reportingRate; }
+    FilterClass filterClass() const { return m_filterClass; }
+    size_t length() const { return m_taps.size(); }
+
+    /// Bytes of the taps and the stored estimations
+    size_t memoryBytes() const
+    {
+        return m_taps.size() * sizeof(Float) + m_phasorTaps.size() * sizeof(Complex)
+                + m_history.size() * sizeof(Estimation);
+    }
+
+    /// Delay between the last pushed estimation and the time the output refers to, at the
+    /// nominal sampling rate
+    int64_t groupDelayUsec() const { return m_groupDelayUsec; }
+
+    /// The same delay in samples, to scale by the actual sampling interval
+    Float groupDelaySamples() const { return (Float)(m_taps.size() - 1) / 2; }
+
+private:
+    uint32_t m_reportingRate = 0;
+    FilterClass m_filterClass = ProtectionClass;
+    int64_t m_groupDelayUsec = 0;
+
+    /// Real taps (for frequency and ROCOF) and complex taps (for phasors); index 0 is the newest
+    std::vector<Float> m_taps = {};
+    std::vector<Complex> m_phasorTaps = {};
+
+    std::vector<Estimation> m_history = {};
+    size_t m_newest = 0;
+    size_t m_count = 0;
+};
+
+} // namespace qpmu
+
+#endif // QPMU_DECIMATOR_H
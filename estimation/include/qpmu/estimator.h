@@ -44,11 +44,23 @@ public:
     ~PhasorEstimator();
     PhasorEstimator(size_t fn, size_t fs);
 
+    /// Estimates the phasors over `windowCycles` nominal cycles, and the frequencies and the
+    /// sampling rate over `frequencyWindowUsec`; the two-argument form uses 1 cycle and 1 second
+    PhasorEstimator(size_t fn, size_t fs, size_t windowCycles, int64_t frequencyWindowUsec);
+
     void updateEstimation(const qpmu::Sample &sample);
 
+    /// Updates the estimation from each sample in turn, and stores each resulting estimation
+    void updateEstimations(const qpmu::Sample *samples, size_t count,
+                           qpmu::Estimation *estimations);
+
+    /// The estimation of the last sample, and the sample itself
     const qpmu::Estimation &currentEstimation() const;
     const qpmu::Sample &currentSample() const;
 
+    /// Bytes of the sample, estimation and FFT buffers
+    size_t memoryBytes() const;
+
 private:
     struct
     {
@@ -57,10 +69,16 @@ private:
         FFTW<Float>::Plan plans[CountSignals];
     } m_fftw = {};
 
+    /// Samples per phasor window, and the DFT bin of the fundamental in it
+    size_t m_windowSize = 0;
+    size_t m_windowCycles = 1;
+    int64_t m_frequencyWindowUsec = TimeDenom;
+
     std::vector<qpmu::Estimation> m_estimationBuffer = {};
     std::vector<qpmu::Sample> m_sampleBuffer = {};
     size_t m_estimationBufIdx = 0;
     size_t m_sampleBufIdx = 0;
+    size_t m_lastSampleIdx = 0;
 
     int64_t m_windowStartTime = 0;
     int64_t m_windowEndTime = 0;
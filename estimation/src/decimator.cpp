@@ -0,0 +1,111 @@
+#include "qpmu/decimator.h"
+#include "qpmu/defs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace qpmu;
+
+namespace {
+
+Float sinc(Float x)
+{
+    return std::abs(x) < 1e-9 ? (Float)1.0 : std::sin(x) / x;
+}
+
+} // namespace
+
+DecimationFilter::DecimationFilter(size_t fn, size_t fs, uint32_t reportingRate,
+                                   FilterClass filterClass)
+    : m_reportingRate(reportingRate), m_filterClass(filterClass)
+{
+    assert(fn > 0);
+    assert(fs > 0);
+    assert(reportingRate > 0);
+
+    const size_t samplesPerCycle = fs / fn;
+
+    if (filterClass == ProtectionClass) {
+        /// Triangular window over two nominal cycles
+        const size_t n = 2 * samplesPerCycle - 1;
+        const Float half = (Float)(n + 1) / 2;
+        m_taps.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            m_taps[k] = 1 - std::abs((Float)k - (Float)(n - 1) / 2) / half;
+        }
+    } else {
+        /// Windowed sinc with its cutoff at a quarter of the reporting rate, inside the reporting
+        /// Nyquist frequency. With N = 8 fs / Fr taps, the Hamming transition band (about
+        /// 3.3 fs / N) stays below Fr / 2 while the delay stays within 4 reporting periods.
+        const Float cutoff = (Float)reportingRate / 4;
+        size_t n = (size_t)std::ceil(2 * fs / cutoff);
+        n = std::max(n | 1, 2 * samplesPerCycle + 1);
+        m_taps.resize(n);
+        const Float center = (Float)(n - 1) / 2;
+        for (size_t k = 0; k < n; ++k) {
+            const Float x = (Float)k - center;
+            const Float hamming = 0.54 - 0.46 * std::cos(2 * M_PI * k / (n - 1));
+            m_taps[k] = sinc(2 * M_PI * cutoff * x / fs) * hamming;
+        }
+    }
+
+    Float sum = 0;
+    for (auto w : m_taps) {
+        sum += w;
+    }
+    for (auto &w : m_taps) {
+        w /= sum;
+    }
+
+    /// Rotate the phasor `k` samples before the newest one to the window center
+    const Float center = (Float)(m_taps.size() - 1) / 2;
+    const Float omega = 2 * M_PI * fn / fs;
+    m_phasorTaps.resize(m_taps.size());
+    for (size_t k = 0; k < m_taps.size(); ++k) {
+        m_phasorTaps[k] = std::polar(m_taps[k], (Float)(omega * ((Float)k - center)));
+    }
+
+    m_groupDelayUsec = (int64_t)std::llround(center * TimeDenom / fs);
+    m_history.resize(m_taps.size());
+}
+
+void DecimationFilter::push(const Estimation &estimation)
+{
+    m_newest = (m_newest + 1) % m_history.size();
+    m_history[m_newest] = estimation;
+    m_count = std::min(m_count + 1, m_history.size());
+}
+
+Estimation DecimationFilter::output() const
+{
+    Estimation result = m_count ? m_history[m_newest] : Estimation();
+    std::fill(result.phasors, result.phasors + CountSignals, Complex(0, 0));
+    std::fill(result.frequencies, result.frequencies + CountSignals, (Float)0);
+    std::fill(result.rocofs, result.rocofs + CountSignals, (Float)0);
+
+    /// Until the window is full, renormalize over the taps that have data
+    Float weight = 0;
+    size_t i = m_newest;
+    for (size_t k = 0; k < m_count; ++k) {
+        const auto &e = m_history[i];
+        const auto &w = m_taps[k];
+        const auto &pw = m_phasorTaps[k];
+        for (size_t ch = 0; ch < CountSignals; ++ch) {
+            result.phasors[ch] += pw * e.phasors[ch];
+            result.frequencies[ch] += w * e.frequencies[ch];
+            result.rocofs[ch] += w * e.rocofs[ch];
+        }
+        weight += w;
+        i = (i == 0 ? m_history.size() : i) - 1;
+    }
+
+    if (m_count > 0 && m_count < m_history.size() && weight != 0) {
+        for (size_t ch = 0; ch < CountSignals; ++ch) {
+            result.phasors[ch] /= weight;
+            result.frequencies[ch] /= weight;
+            result.rocofs[ch] /= weight;
+        }
+    }
+    return result;
+}
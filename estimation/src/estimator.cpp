@@ -1,5 +1,6 @@
 #include "qpmu/estimator.h"
 #include "qpmu/defs.h"
+#include "qpmu/trace.h"
 
 #include <algorithm>
 #include <cmath>
@@ -8,10 +9,19 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <numeric>
 
 using namespace qpmu;
 
+/// The FFTW planner is not thread-safe, so estimators on different threads (e.g., the batch
+/// processor's workers) create and destroy their plans one at a time; executing them is safe
+static std::mutex &fftwPlannerMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
 template <class Numeric>
 constexpr bool isPositive(Numeric x)
 {
@@ -30,6 +40,7 @@ constexpr IntTime zeroCrossingTime(IntTime t0, IntValue x0, IntTime t1, IntValue
 
 PhasorEstimator::~PhasorEstimator()
 {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
     for (size_t i = 0; i < CountSignals; ++i) {
         FFTW<Float>::destroy_plan(m_fftw.plans[i]);
         FFTW<Float>::free(m_fftw.inputs[i]);
@@ -37,21 +48,35 @@ PhasorEstimator::~PhasorEstimator()
     }
 }
 
-PhasorEstimator::PhasorEstimator(size_t fn, size_t fs)
+PhasorEstimator::PhasorEstimator(size_t fn, size_t fs) : PhasorEstimator(fn, fs, 1, TimeDenom)
+{
+}
+
+PhasorEstimator::PhasorEstimator(size_t fn, size_t fs, size_t windowCycles,
+                                 int64_t frequencyWindowUsec)
+    : m_windowSize(windowCycles * fs / fn),
+      m_windowCycles(windowCycles),
+      m_frequencyWindowUsec(frequencyWindowUsec)
 {
     assert(fn > 0);
     assert(fs % fn == 0);
+    assert(windowCycles > 0);
+    assert(frequencyWindowUsec > 0);
 
     m_estimationBuffer.resize(fs
                               / fn); // hold one full cycle (fs / fn = number of samples per cycle)
-    m_sampleBuffer.resize(5 * fs); // hold at least 1 second of samples
 
+    /// Hold at least 5 times the frequency window of samples
+    const auto windowSeconds = ((uint64_t)frequencyWindowUsec + TimeDenom - 1) / TimeDenom;
+    m_sampleBuffer.resize(5 * fs * windowSeconds);
+
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
     for (size_t i = 0; i < CountSignals; ++i) {
-        m_fftw.inputs[i] = FFTW<Float>::alloc_complex(m_estimationBuffer.size());
-        m_fftw.outputs[i] = FFTW<Float>::alloc_complex(m_estimationBuffer.size());
-        m_fftw.plans[i] = FFTW<Float>::plan_dft_1d(m_estimationBuffer.size(), m_fftw.inputs[i],
+        m_fftw.inputs[i] = FFTW<Float>::alloc_complex(m_windowSize);
+        m_fftw.outputs[i] = FFTW<Float>::alloc_complex(m_windowSize);
+        m_fftw.plans[i] = FFTW<Float>::plan_dft_1d(m_windowSize, m_fftw.inputs[i],
                                                    m_fftw.outputs[i], FFTW_FORWARD, FFTW_ESTIMATE);
-        for (size_t j = 0; j < m_estimationBuffer.size(); ++j) {
+        for (size_t j = 0; j < m_windowSize; ++j) {
             m_fftw.inputs[i][j][0] = 0;
             m_fftw.inputs[i][j][1] = 0;
         }
@@ -69,17 +94,25 @@ PhasorEstimator::PhasorEstimator(size_t fn, size_t fs)
 
 const Estimation &PhasorEstimator::currentEstimation() const
 {
-    return m_estimationBuffer[m_estimationBufIdx];
+    return m_estimationBuffer[ESTIMATION_PREV(m_estimationBufIdx)];
 }
 
 const Sample &PhasorEstimator::currentSample() const
 {
-    return m_sampleBuffer[m_sampleBufIdx];
+    return m_sampleBuffer[m_lastSampleIdx];
+}
+
+size_t PhasorEstimator::memoryBytes() const
+{
+    return m_sampleBuffer.size() * sizeof(Sample) + m_estimationBuffer.size() * sizeof(Estimation)
+            + 2 * CountSignals * m_windowSize * sizeof(FFTW<Float>::Complex);
 }
 
 void PhasorEstimator::updateEstimation(const Sample &sample)
 {
+    /// The sample index is reset when a frequency window ends, so the sample's own is kept
     m_sampleBuffer[m_sampleBufIdx] = sample;
+    m_lastSampleIdx = m_sampleBufIdx;
 
     const Estimation &prevEstimation = m_estimationBuffer[ESTIMATION_PREV(m_estimationBufIdx)];
     Estimation &currEstimation = m_estimationBuffer[m_estimationBufIdx];
@@ -88,24 +121,26 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
     const Sample &currSample = m_sampleBuffer[m_sampleBufIdx];
 
     { /// Estimate phasors
+        QPMU_TRACE_SCOPE("phasor fft");
         for (size_t ch = 0; ch < CountSignals; ++ch) {
 
             /// Shift the previous inputs
-            for (size_t j = 1; j < m_estimationBuffer.size(); ++j) {
+            for (size_t j = 1; j < m_windowSize; ++j) {
                 m_fftw.inputs[ch][j - 1][0] = m_fftw.inputs[ch][j][0];
                 m_fftw.inputs[ch][j - 1][1] = m_fftw.inputs[ch][j][1];
             }
 
             /// Add the new sample's data
-            m_fftw.inputs[ch][m_estimationBuffer.size() - 1][0] = sample.channels[ch];
-            m_fftw.inputs[ch][m_estimationBuffer.size() - 1][1] = 0;
+            m_fftw.inputs[ch][m_windowSize - 1][0] = sample.channels[ch];
+            m_fftw.inputs[ch][m_windowSize - 1][1] = 0;
 
             /// Execute the FFT plan
             FFTW<Float>::execute(m_fftw.plans[ch]);
 
             /// Phasor = output corresponding to the fundamental frequency
-            Complex phasor = { m_fftw.outputs[ch][1][0], m_fftw.outputs[ch][1][1] };
-            phasor /= Float(m_estimationBuffer.size());
+            const auto &bin = m_fftw.outputs[ch][m_windowCycles];
+            Complex phasor = { bin[0], bin[1] };
+            phasor /= Float(m_windowSize);
             currEstimation.phasors[ch] = phasor;
         }
     }
@@ -113,7 +148,7 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
 
         if (m_windowStartTime == 0) {
             m_windowStartTime = sample.timestampUsec;
-            m_windowEndTime = m_windowStartTime + TimeDenom;
+            m_windowEndTime = m_windowStartTime + m_frequencyWindowUsec;
         }
 
         std::copy(prevEstimation.frequencies, prevEstimation.frequencies + CountSignals,
@@ -125,12 +160,14 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
         currEstimation.samplingRate = prevEstimation.samplingRate;
 
         if (m_windowEndTime <= sample.timestampUsec) {
-            /// The 1-second window has ended, hence
+            /// The frequency window has ended, hence
             /// - estimate
             ///   * channel frequencies,
             ///   * channel ROCOFs, and
             ///   * sampling rate
             /// - reset the window variables
+            QPMU_TRACE_SCOPE("frequency scan");
+            const auto windowSec = (Float)m_frequencyWindowUsec / TimeDenom;
 
             for (size_t ch = 0; ch < CountSignals; ++ch) {
                 { /// Frequency estimation
@@ -168,13 +205,15 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
                     } else {
                         auto crossingWindowSec =
                                 (Float)(lastCrossingTime - firstCrossingTime) / TimeDenom;
-                        auto residueSec = (Float)1.0 - crossingWindowSec;
+                        auto residue = (windowSec - crossingWindowSec) / windowSec;
 
                         /// 2 zero crossings per cycle + 1 crossing starts the count
-                        Float freq = (std::max(countZeroCrossings, (uint64_t)1) - 1) / (Float)2.0;
+                        Float freq = (std::max(countZeroCrossings, (uint64_t)1) - 1) / (Float)2.0
+                                / windowSec;
 
-                        /// Adjust the frequency to account for the window being less than 1 second
-                        freq *= (1.0 + residueSec);
+                        /// Adjust the frequency to account for the crossings not spanning the
+                        /// whole window
+                        freq *= (1.0 + residue);
 
                         currEstimation.frequencies[ch] = freq;
                     }
@@ -190,17 +229,17 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
             { /// Sampling rate estimation
                 auto samplesWindowSec =
                         (Float)(sample.timestampUsec - m_windowStartTime) / TimeDenom;
-                auto residueSec = (Float)1.0 - samplesWindowSec;
+                auto residue = (windowSec - samplesWindowSec) / windowSec;
                 size_t countSamples = m_sampleBufIdx + 1;
 
-                /// Adjust the sampling rate to the window, because it is not exactly 1 second
-                currEstimation.samplingRate = countSamples * (1.0 + residueSec);
+                /// Adjust the sampling rate to the window, because it is not exactly its length
+                currEstimation.samplingRate = countSamples / windowSec * (1.0 + residue);
             }
 
             { /// Reset window variables
                 m_sampleBufIdx = m_sampleBuffer.size() - 1;
                 m_windowStartTime = sample.timestampUsec;
-                m_windowEndTime = m_windowStartTime + TimeDenom;
+                m_windowEndTime = m_windowStartTime + m_frequencyWindowUsec;
             }
         }
     }
@@ -210,6 +249,15 @@ void PhasorEstimator::updateEstimation(const Sample &sample)
     m_estimationBufIdx = (m_estimationBufIdx + 1) % m_estimationBuffer.size();
 }
 
+void PhasorEstimator::updateEstimations(const Sample *samples, size_t count,
+                                        Estimation *estimations)
+{
+    for (size_t i = 0; i < count; ++i) {
+        updateEstimation(samples[i]);
+        estimations[i] = currentEstimation();
+    }
+}
+
 #undef NEXT
 #undef PREV
 
@@ -0,0 +1,128 @@
+#include "qpmu/aggregation.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+ReportingInstant instantAt(int64_t index)
+{
+    ReportingInstant instant;
+    instant.timeUsec = index * 20000;
+    instant.reportingRate = 50;
+    return instant;
+}
+
+/// Indexes of the released instants, and whether each was complete
+struct Released
+{
+    std::vector<int64_t> indexes = {};
+    std::vector<bool> complete = {};
+};
+
+Released add(StationAggregator &aggregator, size_t station, int64_t index)
+{
+    Released result;
+    for (auto aggregate : aggregator.add(station, instantAt(index), Estimation())) {
+        result.indexes.push_back(aggregate->instant.timeUsec / 20000);
+        result.complete.push_back(aggregate->complete());
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(StationAggregator, ReleasesAnInstantOnceEveryStationReportsIt)
+{
+    StationAggregator aggregator(3);
+    EXPECT_TRUE(add(aggregator, 0, 1).indexes.empty());
+    EXPECT_TRUE(add(aggregator, 2, 1).indexes.empty());
+    const auto released = add(aggregator, 1, 1);
+    EXPECT_EQ(released.indexes, (std::vector<int64_t>{ 1 }));
+    EXPECT_EQ(released.complete, (std::vector<bool>{ true }));
+    EXPECT_EQ(aggregator.stats().completeInstants, 1u);
+}
+
+TEST(StationAggregator, SingleStationReleasesEveryInstantAtOnce)
+{
+    StationAggregator aggregator(1);
+    for (int64_t i = 1; i <= 10; ++i) {
+        EXPECT_EQ(add(aggregator, 0, i).indexes, (std::vector<int64_t>{ i }));
+    }
+}
+
+TEST(StationAggregator, ReleasesOlderOpenInstantsBeforeACompletedOne)
+{
+    StationAggregator aggregator(2);
+    add(aggregator, 0, 1);
+    add(aggregator, 0, 2);
+    const auto released = add(aggregator, 1, 2);
+    EXPECT_EQ(released.indexes, (std::vector<int64_t>{ 1, 2 }));
+    EXPECT_EQ(released.complete, (std::vector<bool>{ false, true }));
+
+    /// The missing station's estimation for the flushed instant comes too late
+    EXPECT_TRUE(add(aggregator, 1, 1).indexes.empty());
+    EXPECT_EQ(aggregator.stats().lateEstimations, 1u);
+}
+
+TEST(StationAggregator, EvictsTheOldestInstantForANewerOne)
+{
+    StationAggregator aggregator(2);
+    for (int64_t i = 1; i <= (int64_t)StationAggregator::Depth; ++i) {
+        EXPECT_TRUE(add(aggregator, 0, i).indexes.empty());
+    }
+    const auto released = add(aggregator, 0, StationAggregator::Depth + 1);
+    EXPECT_EQ(released.indexes, (std::vector<int64_t>{ 1 }));
+    EXPECT_EQ(released.complete, (std::vector<bool>{ false }));
+    EXPECT_EQ(aggregator.stats().incompleteInstants, 1u);
+}
+
+TEST(StationAggregator, ReleasesAnInstantOlderThanEveryOpenOneAtOnce)
+{
+    StationAggregator aggregator(2);
+    for (int64_t i = 2; i < 2 + (int64_t)StationAggregator::Depth; ++i) {
+        add(aggregator, 0, i);
+    }
+    /// Evicting instant 2 for it would send 2 before 1
+    EXPECT_EQ(add(aggregator, 1, 1).indexes, (std::vector<int64_t>{ 1 }));
+    EXPECT_EQ(add(aggregator, 1, 2).indexes, (std::vector<int64_t>{ 2 }));
+}
+
+TEST(StationAggregator, ReleasesInTimeOrderWhateverTheArrivalOrder)
+{
+    constexpr size_t Stations = 3;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int64_t> lag(0, 6);
+
+    /// Each station reports instants in order, but lags behind the others at random
+    std::vector<std::pair<int64_t, size_t>> arrivals;
+    for (size_t station = 0; station < Stations; ++station) {
+        for (int64_t i = 1; i <= 2000; ++i) {
+            arrivals.push_back({ 8 * i + lag(random), station });
+        }
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+    std::vector<int64_t> next(Stations, 1);
+
+    StationAggregator aggregator(Stations);
+    int64_t last = 0;
+    size_t countReleased = 0;
+    for (const auto &[time, station] : arrivals) {
+        (void)time;
+        for (auto index : add(aggregator, station, next[station]++).indexes) {
+            EXPECT_GT(index, last);
+            last = index;
+            ++countReleased;
+        }
+    }
+    const auto &stats = aggregator.stats();
+    EXPECT_EQ(countReleased, stats.completeInstants + stats.incompleteInstants);
+    EXPECT_GT(stats.completeInstants, 0u);
+}
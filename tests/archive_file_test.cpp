@@ -0,0 +1,243 @@
+#include "qpmu/archive_reader.h"
+#include "qpmu/archive_writer.h"
+#include "qpmu/clock.h"
+#include "qpmu/frames.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+constexpr int64_t StartUsec = 1700000000000000;
+
+/// A chunk of a station's records, 20 ms apart from `firstUsec`
+std::vector<uint8_t> chunk(uint16_t station, int64_t firstUsec, size_t count)
+{
+    ArchiveChunkEncoder encoder(station);
+    Estimation estimation;
+    for (size_t i = 0; i < count; ++i) {
+        estimation.frequencies[0] = 50 + 0.001 * (Float)i;
+        encoder.append(firstUsec + 20000 * (int64_t)i, estimation);
+    }
+    std::vector<uint8_t> bytes;
+    encoder.finish(bytes);
+    return bytes;
+}
+
+void append(std::vector<uint8_t> &bytes, const std::vector<uint8_t> &more)
+{
+    bytes.insert(bytes.end(), more.begin(), more.end());
+}
+
+class ArchiveFileTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const auto name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        m_directory = std::filesystem::temp_directory_path() / ("qpmu-archive-test-"
+                                                                + std::string(name));
+        std::filesystem::remove_all(m_directory);
+        std::filesystem::create_directories(m_directory);
+        m_path = (m_directory / "file.qpa").string();
+    }
+
+    void TearDown() override { std::filesystem::remove_all(m_directory); }
+
+    void write(const std::vector<uint8_t> &bytes, const char *mode = "wb")
+    {
+        auto file = std::fopen(m_path.c_str(), mode);
+        ASSERT_NE(file, nullptr);
+        ASSERT_EQ(std::fwrite(bytes.data(), 1, bytes.size(), file), bytes.size());
+        std::fclose(file);
+    }
+
+    std::filesystem::path m_directory = {};
+    std::string m_path = {};
+};
+
+} // namespace
+
+TEST_F(ArchiveFileTest, SkipsACorruptChunk)
+{
+    const auto first = chunk(1, StartUsec, 100);
+    auto corrupt = chunk(1, StartUsec + 2000000, 100);
+    const auto last = chunk(1, StartUsec + 4000000, 100);
+    corrupt[0] ^= 0xFF;
+    std::vector<uint8_t> bytes = first;
+    append(bytes, corrupt);
+    append(bytes, last);
+    write(bytes);
+
+    ArchiveFile file;
+    std::string error;
+    ASSERT_TRUE(file.open(m_path, error)) << error;
+    ASSERT_EQ(file.chunks(1).size(), 2u);
+    EXPECT_EQ(file.chunks(1)[1].offset, first.size() + corrupt.size());
+    EXPECT_EQ(file.skippedBytes(), corrupt.size());
+    EXPECT_EQ(file.indexedSize(), file.size());
+    EXPECT_FALSE(file.indexError().empty());
+}
+
+TEST_F(ArchiveFileTest, SkipsAChunkWhoseSizeIsCorrupt)
+{
+    auto corrupt = chunk(1, StartUsec, 100);
+    const auto last = chunk(2, StartUsec, 100);
+    /// The size of the time column, so that the next chunk seems to start elsewhere
+    corrupt[28] ^= 0x10;
+    std::vector<uint8_t> bytes = corrupt;
+    append(bytes, last);
+    write(bytes);
+
+    ArchiveFile file;
+    std::string error;
+    ASSERT_TRUE(file.open(m_path, error)) << error;
+    ASSERT_EQ(file.chunks(2).size(), 1u);
+    EXPECT_EQ(file.chunks(2)[0].offset, corrupt.size());
+}
+
+TEST_F(ArchiveFileTest, IndexesAnIncompleteChunkOnceItIsComplete)
+{
+    const auto first = chunk(1, StartUsec, 100);
+    const auto second = chunk(1, StartUsec + 2000000, 100);
+    std::vector<uint8_t> bytes = first;
+    append(bytes, { second.begin(), second.begin() + second.size() / 2 });
+    write(bytes);
+
+    ArchiveFile file;
+    std::string error;
+    ASSERT_TRUE(file.open(m_path, error)) << error;
+    EXPECT_EQ(file.chunks(1).size(), 1u);
+    EXPECT_EQ(file.indexedSize(), first.size());
+    EXPECT_EQ(file.skippedBytes(), 0u);
+
+    std::vector<uint8_t> rest(second.begin() + second.size() / 2, second.end());
+    append(rest, chunk(2, StartUsec, 50));
+    write(rest, "ab");
+    ASSERT_TRUE(file.refresh(error)) << error;
+    EXPECT_EQ(file.chunks(1).size(), 2u);
+    EXPECT_EQ(file.chunks(2).size(), 1u);
+    EXPECT_EQ(file.indexedSize(), file.size());
+    EXPECT_TRUE(file.indexError().empty());
+}
+
+TEST_F(ArchiveFileTest, ReaderFindsChunksAppendedAfterTheFirstQuery)
+{
+    ArchiveConfig config;
+    config.directory = m_directory.string();
+    config.retentionDays = 0;
+    const auto startUsec = currentTimeUsec() / 86400000000 * 86400000000;
+
+    ArchiveQuery query;
+    query.station = 1;
+    query.columns = { ArchiveColumns::frequency(0) };
+    query.fromUsec = startUsec;
+    query.toUsec = startUsec + 86400000000;
+
+    ArchiveReader reader(config.directory);
+    ArchiveWriter writer(config);
+    for (int64_t i = 0; i < 10; ++i) {
+        writer.push(1, startUsec + 20000 * i, Estimation());
+    }
+    writer.flush();
+    EXPECT_EQ(reader.query(query).times.size(), 10u);
+
+    for (int64_t i = 10; i < 25; ++i) {
+        writer.push(1, startUsec + 20000 * i, Estimation());
+    }
+    writer.flush();
+    EXPECT_EQ(reader.query(query).times.size(), 25u);
+}
+
+TEST_F(ArchiveFileTest, WriterDropsAnIncompleteChunkBeforeAppending)
+{
+    ArchiveConfig config;
+    config.directory = m_directory.string();
+    config.retentionDays = 0;
+    const auto startUsec = currentTimeUsec() / 86400000000 * 86400000000;
+    m_path = ArchiveWriter::filePath(config.directory, startUsec);
+
+    /// A complete chunk, then the first half of one cut short by a power cut
+    const auto first = chunk(1, startUsec, 100);
+    const auto torn = chunk(1, startUsec + 2000000, 3000);
+    std::vector<uint8_t> bytes = first;
+    append(bytes, { torn.begin(), torn.begin() + torn.size() / 2 });
+    write(bytes);
+
+    std::vector<std::string> errors;
+    {
+        ArchiveWriter writer(config, [&](const std::string &error) { errors.push_back(error); });
+        for (int64_t i = 0; i < 10; ++i) {
+            writer.push(2, startUsec + 20000 * i, Estimation());
+        }
+        writer.flush();
+    }
+    EXPECT_EQ(errors.size(), 1u);
+
+    ArchiveFile file;
+    std::string error;
+    ASSERT_TRUE(file.open(m_path, error)) << error;
+    EXPECT_EQ(file.chunks(1).size(), 1u);
+    ASSERT_EQ(file.chunks(2).size(), 1u);
+    EXPECT_EQ(file.chunks(2)[0].offset, first.size());
+    EXPECT_EQ(file.indexedSize(), file.size());
+}
+
+TEST_F(ArchiveFileTest, SkipsAChunkWhoseRecordCountIsCorrupt)
+{
+    auto corrupt = chunk(1, StartUsec, 100);
+    const auto last = chunk(2, StartUsec, 100);
+    /// The top byte of the record count, which would have the decoder loop billions of times
+    corrupt[11] ^= 0x80;
+    std::string error;
+    std::vector<ArchiveRecord> decoded;
+    EXPECT_FALSE(decodeArchiveChunk(corrupt.data(), corrupt.size(), decoded, error));
+    EXPECT_TRUE(decoded.empty());
+
+    std::vector<uint8_t> bytes = corrupt;
+    append(bytes, last);
+    write(bytes);
+    ArchiveFile file;
+    ASSERT_TRUE(file.open(m_path, error)) << error;
+    EXPECT_TRUE(file.chunks(1).empty());
+    ASSERT_EQ(file.chunks(2).size(), 1u);
+    EXPECT_EQ(file.chunks(2)[0].offset, corrupt.size());
+}
+
+TEST(ArchiveChunk, ChecksumCoversTheHeader)
+{
+    auto bytes = chunk(1, StartUsec, 100);
+    std::vector<ArchiveRecord> records;
+    std::string error;
+    ASSERT_TRUE(decodeArchiveChunk(bytes.data(), bytes.size(), records, error)) << error;
+    /// A bit of the first time, which would misplace the chunk in the index
+    bytes[12] ^= 0x01;
+    records.clear();
+    EXPECT_FALSE(decodeArchiveChunk(bytes.data(), bytes.size(), records, error));
+    EXPECT_EQ(error, "Chunk checksum mismatch");
+}
+
+TEST(ArchiveChunk, ReadsAChunkOfTheFirstVersion)
+{
+    /// A "QPA1" chunk: its checksum covers the columns only
+    auto bytes = chunk(1, StartUsec, 100);
+    ArchiveChunkHeader header;
+    std::string error;
+    ASSERT_TRUE(readArchiveChunkHeader(bytes.data(), bytes.size(), header, error)) << error;
+    bytes[3] = '1';
+    const auto checksum = crcCcitt(bytes.data() + header.headerSize(),
+                                   header.chunkSize() - header.headerSize());
+    bytes[header.headerSize() - 2] = (uint8_t)checksum;
+    bytes[header.headerSize() - 1] = (uint8_t)(checksum >> 8);
+
+    std::vector<ArchiveRecord> records;
+    ASSERT_TRUE(decodeArchiveChunk(bytes.data(), bytes.size(), records, error)) << error;
+    ASSERT_EQ(records.size(), 100u);
+    EXPECT_EQ(records.back().timeUsec, StartUsec + 20000 * 99);
+}
@@ -0,0 +1,72 @@
+#include "qpmu/estimator.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+constexpr size_t Nominal = 50;
+constexpr size_t Rate = 1200;
+constexpr size_t WindowSamples = Rate / Nominal;
+constexpr double Amplitude = 1000;
+
+/// Phase of the test signal at sample `index`, 15 degrees per sample
+double phaseAt(int64_t index)
+{
+    return 2 * M_PI * (double)index / WindowSamples + 0.3;
+}
+
+/// A sample of a nominal-frequency cosine on every channel, `Amplitude` about mid-scale
+Sample sampleAt(size_t index)
+{
+    Sample sample;
+    sample.seq = index;
+    sample.timestampUsec = 1700000000000000 + (int64_t)index * 1000000 / (int64_t)Rate;
+    sample.timeDeltaUsec = 1000000 / (int64_t)Rate;
+    for (size_t ch = 0; ch < CountSignals; ++ch) {
+        sample.channels[ch] = (uint16_t)std::lround(2048 + Amplitude * std::cos(phaseAt(index)));
+    }
+    return sample;
+}
+
+} // namespace
+
+TEST(PhasorEstimator, ReturnsTheEstimationOfTheLastSample)
+{
+    PhasorEstimator estimator(Nominal, Rate);
+    /// Past two ends of the 1 s frequency window, which reset the sample index
+    for (size_t i = 0; i < 3 * Rate; ++i) {
+        estimator.updateEstimation(sampleAt(i));
+        ASSERT_EQ(estimator.currentSample().seq, i);
+        if (i + 1 < WindowSamples) {
+            continue;
+        }
+        /// Half the amplitude, with the phase of the oldest sample of the window
+        const auto expected = std::polar(Amplitude / 2, phaseAt((int64_t)(i + 1 - WindowSamples)));
+        const auto &phasor = estimator.currentEstimation().phasors[0];
+        ASSERT_LT(std::abs(std::complex<double>(phasor) - expected), 1) << "sample " << i;
+    }
+}
+
+TEST(PhasorEstimator, StoresTheSameEstimationsInBatches)
+{
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < 2 * Rate; ++i) {
+        samples.push_back(sampleAt(i));
+    }
+    PhasorEstimator single(Nominal, Rate);
+    PhasorEstimator batched(Nominal, Rate);
+    std::vector<Estimation> estimations(samples.size());
+    batched.updateEstimations(samples.data(), samples.size(), estimations.data());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        single.updateEstimation(samples[i]);
+        for (size_t ch = 0; ch < CountSignals; ++ch) {
+            ASSERT_EQ(estimations[i].phasors[ch], single.currentEstimation().phasors[ch]) << i;
+            ASSERT_EQ(estimations[i].frequencies[ch], single.currentEstimation().frequencies[ch]);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include "qpmu/flight_recorder.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+constexpr Float Rate = 1200;
+constexpr size_t WindowSamples = 24;
+
+/// Names of the COMTRADE configuration files in the directory, one per capture
+std::vector<std::string> captures(const std::filesystem::path &directory)
+{
+    std::vector<std::string> names;
+    for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".cfg") {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    return names;
+}
+
+/// Estimations as the estimator makes them from the start: magnitudes growing while the phasor
+/// window fills, and frequencies of 0 for the first second
+Estimation startingEstimation(size_t index, Float magnitude)
+{
+    Estimation estimation;
+    const auto fill = std::min<Float>(1, (Float)(index + 1) / WindowSamples);
+    for (size_t i = 0; i < CountSignals; ++i) {
+        estimation.phasors[i] = Complex(fill * magnitude, 0);
+        estimation.frequencies[i] = index < Rate ? 0 : 50;
+    }
+    return estimation;
+}
+
+class FlightRecorderTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const auto name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        m_directory = std::filesystem::temp_directory_path() / ("qpmu-recorder-test-"
+                                                                + std::string(name));
+        std::filesystem::remove_all(m_directory);
+        m_config.directory = m_directory.string();
+        m_config.samplingRate = Rate;
+        m_config.bufferSeconds = 10;
+        m_config.writeOnRecordingThread = true;
+    }
+
+    void TearDown() override { std::filesystem::remove_all(m_directory); }
+
+    /// Records `seconds` of samples with the estimations of `estimate(index)`
+    void record(Float seconds, const std::function<Estimation(size_t)> &estimate)
+    {
+        FlightRecorder recorder(m_config);
+        Sample sample;
+        for (size_t i = 0; i < (size_t)(seconds * Rate); ++i) {
+            sample.seq = i;
+            sample.timestampUsec = 1700000000000000 + (int64_t)i * 1000000 / (int64_t)Rate;
+            recorder.record(sample, estimate(i));
+        }
+    }
+
+    std::filesystem::path m_directory = {};
+    FlightRecorderConfig m_config = {};
+};
+
+} // namespace
+
+TEST_F(FlightRecorderTest, DoesNotTriggerWhileTheEstimatorStarts)
+{
+    record(10, [](size_t i) { return startingEstimation(i, 100); });
+    EXPECT_TRUE(captures(m_directory).empty());
+}
+
+TEST_F(FlightRecorderTest, TriggersOnAMagnitudeStepOnceSettled)
+{
+    record(10, [](size_t i) { return startingEstimation(i, i < 7 * Rate ? 100 : 150); });
+    const auto names = captures(m_directory);
+    ASSERT_EQ(names.size(), 1u);
+    EXPECT_NE(names[0].find("magnitude_step"), std::string::npos) << names[0];
+}
+
+TEST_F(FlightRecorderTest, TriggersOnAFrequencyDeviation)
+{
+    record(10, [](size_t i) {
+        auto estimation = startingEstimation(i, 100);
+        if (i >= 7 * Rate) {
+            estimation.frequencies[0] = 51;
+        }
+        return estimation;
+    });
+    const auto names = captures(m_directory);
+    ASSERT_EQ(names.size(), 1u);
+    EXPECT_NE(names[0].find("frequency"), std::string::npos) << names[0];
+}
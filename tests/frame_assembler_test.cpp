@@ -0,0 +1,132 @@
+#include "qpmu/frame_assembler.h"
+#include "qpmu/frames.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+/// A C37.118-2005 command frame (without EXTFRAME) with a valid CHK word
+std::vector<uint8_t> commandFrame(uint16_t command, uint16_t idCode = 1)
+{
+    std::vector<uint8_t> frame = { FrameSyncByte, 0x41, 0, 18, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    frame[4] = (uint8_t)(idCode >> 8);
+    frame[5] = (uint8_t)idCode;
+    frame.push_back((uint8_t)(command >> 8));
+    frame.push_back((uint8_t)command);
+    const auto chk = crcCcitt(frame.data(), frame.size());
+    frame.push_back((uint8_t)(chk >> 8));
+    frame.push_back((uint8_t)chk);
+    return frame;
+}
+
+void append(std::vector<uint8_t> &bytes, const std::vector<uint8_t> &more)
+{
+    bytes.insert(bytes.end(), more.begin(), more.end());
+}
+
+/// The CMD words of every frame the assembler extracts from the bytes
+std::vector<uint16_t> commands(FrameAssembler &assembler, const std::vector<uint8_t> &bytes)
+{
+    assembler.push(bytes.data(), bytes.size());
+    std::vector<uint16_t> result;
+    const uint8_t *frame;
+    size_t size;
+    while (assembler.next(frame, size)) {
+        result.push_back(frameCommand(frame));
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(FrameAssembler, ExtractsCoalescedFrames)
+{
+    std::vector<uint8_t> bytes;
+    append(bytes, commandFrame(2));
+    append(bytes, commandFrame(5));
+    FrameAssembler assembler;
+    EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2, 5 }));
+    EXPECT_EQ(assembler.stats().skippedBytes, 0u);
+}
+
+TEST(FrameAssembler, ExtractsAFrameSplitAcrossReads)
+{
+    const auto bytes = commandFrame(2);
+    FrameAssembler assembler;
+    EXPECT_TRUE(commands(assembler, { bytes.begin(), bytes.begin() + 3 }).empty());
+    EXPECT_TRUE(commands(assembler, { bytes.begin() + 3, bytes.begin() + 10 }).empty());
+    EXPECT_EQ(commands(assembler, { bytes.begin() + 10, bytes.end() }),
+              (std::vector<uint16_t>{ 2 }));
+}
+
+TEST(FrameAssembler, SkipsGarbageBeforeAFrame)
+{
+    std::vector<uint8_t> bytes = { 0x00, 0x13, 0x37 };
+    append(bytes, commandFrame(2));
+    FrameAssembler assembler;
+    EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2 }));
+    EXPECT_EQ(assembler.stats().skippedBytes, 3u);
+}
+
+TEST(FrameAssembler, RejectsAnInvalidSecondSyncByte)
+{
+    /// Frame type 7 does not exist, and version 0 neither
+    for (uint8_t sync1 : { 0x71, 0x40, 0xC1 }) {
+        auto bogus = commandFrame(3);
+        bogus[1] = sync1;
+        std::vector<uint8_t> bytes = bogus;
+        append(bytes, commandFrame(2));
+        FrameAssembler assembler;
+        EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2 })) << (int)sync1;
+        EXPECT_EQ(assembler.stats().crcErrors, 0u);
+    }
+}
+
+TEST(FrameAssembler, BogusFrameSizeDoesNotStallTheStream)
+{
+    /// A SYNC word whose FRAMESIZE claims far more bytes than will ever arrive
+    std::vector<uint8_t> bytes = { FrameSyncByte, 0x41, 0x07, 0xFF, 0x12, 0x34 };
+    append(bytes, commandFrame(2));
+    FrameAssembler assembler;
+    EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2 }));
+    EXPECT_EQ(commands(assembler, commandFrame(5)), (std::vector<uint16_t>{ 5 }));
+}
+
+TEST(FrameAssembler, WaitsForATruncatedFrameWithNothingAfterIt)
+{
+    const auto bytes = commandFrame(2);
+    FrameAssembler assembler;
+    EXPECT_TRUE(commands(assembler, { bytes.begin(), bytes.end() - 1 }).empty());
+    EXPECT_EQ(assembler.stats().skippedBytes, 0u);
+    EXPECT_EQ(commands(assembler, { bytes.end() - 1, bytes.end() }),
+              (std::vector<uint16_t>{ 2 }));
+}
+
+TEST(FrameAssembler, ResynchronizesAfterACrcError)
+{
+    auto corrupt = commandFrame(3);
+    corrupt[15] ^= 0x01;
+    std::vector<uint8_t> bytes = corrupt;
+    append(bytes, commandFrame(2));
+    FrameAssembler assembler;
+    EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2 }));
+    EXPECT_EQ(assembler.stats().crcErrors, 1u);
+    EXPECT_EQ(assembler.stats().skippedBytes, corrupt.size());
+}
+
+TEST(FrameAssembler, FindsAFrameThatStartsInsideACorruptOne)
+{
+    /// The tail of a torn frame swallows the SYNC of the next one: after the CRC error the
+    /// assembler must look inside the rejected bytes rather than past them
+    auto torn = commandFrame(3);
+    torn.resize(8);
+    std::vector<uint8_t> bytes = torn;
+    append(bytes, commandFrame(2));
+    append(bytes, commandFrame(5));
+    FrameAssembler assembler;
+    EXPECT_EQ(commands(assembler, bytes), (std::vector<uint16_t>{ 2, 5 }));
+}
@@ -0,0 +1,207 @@
+#include "qpmu/gorilla.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+/// Writes one bit at a time, as the format is defined: the reference for `BitWriter`
+std::vector<uint8_t> referenceBits(const std::vector<std::pair<uint64_t, int>> &writes)
+{
+    std::vector<uint8_t> bytes;
+    size_t bitCount = 0;
+    for (const auto &[value, count] : writes) {
+        for (int i = count - 1; i >= 0; --i) {
+            if (bitCount % 8 == 0) {
+                bytes.push_back(0);
+            }
+            if ((value >> i) & 1) {
+                bytes.back() |= (uint8_t)(0x80 >> (bitCount % 8));
+            }
+            ++bitCount;
+        }
+    }
+    return bytes;
+}
+
+uint64_t lowBits(uint64_t value, int count)
+{
+    return count == 64 ? value : value & ((uint64_t(1) << count) - 1);
+}
+
+std::vector<std::pair<uint64_t, int>> randomWrites(size_t count, uint32_t seed)
+{
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<int> width(0, 64);
+    std::vector<std::pair<uint64_t, int>> writes;
+    for (size_t i = 0; i < count; ++i) {
+        writes.push_back({ random(), width(random) });
+    }
+    return writes;
+}
+
+uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+std::vector<int64_t> roundTripTimes(const std::vector<int64_t> &times)
+{
+    BitWriter out;
+    TimestampEncoder encoder(out);
+    for (auto time : times) {
+        encoder.append(time);
+    }
+    BitReader in(out.bytes().data(), out.bytes().size());
+    TimestampDecoder decoder(in);
+    std::vector<int64_t> decoded;
+    for (size_t i = 0; i < times.size(); ++i) {
+        decoded.push_back(decoder.next());
+    }
+    EXPECT_FALSE(in.overrun());
+    return decoded;
+}
+
+/// Round-trips the values, comparing bit patterns so that NaNs and signed zeros count
+void expectFloatsRoundTrip(const std::vector<double> &values)
+{
+    BitWriter out;
+    FloatEncoder encoder(out);
+    for (auto value : values) {
+        encoder.append(value);
+    }
+    BitReader in(out.bytes().data(), out.bytes().size());
+    FloatDecoder decoder(in);
+    for (size_t i = 0; i < values.size(); ++i) {
+        EXPECT_EQ(bitsOf(decoder.next()), bitsOf(values[i])) << "value " << i;
+    }
+    EXPECT_FALSE(in.overrun());
+}
+
+} // namespace
+
+TEST(BitWriter, MatchesTheBitByBitLayout)
+{
+    const auto writes = randomWrites(5000, 1);
+    BitWriter out;
+    size_t bitCount = 0;
+    for (const auto &[value, count] : writes) {
+        out.write(value, count);
+        bitCount += count;
+    }
+    EXPECT_EQ(out.bitCount(), bitCount);
+    std::vector<std::pair<uint64_t, int>> masked;
+    for (const auto &[value, count] : writes) {
+        masked.push_back({ lowBits(value, count), count });
+    }
+    EXPECT_EQ(out.bytes(), referenceBits(masked));
+}
+
+TEST(BitWriter, KeepsWritingAfterBytesIsRead)
+{
+    BitWriter out;
+    out.write(0b101, 3);
+    EXPECT_EQ(out.bytes(), (std::vector<uint8_t>{ 0xA0 }));
+    out.write(~uint64_t(0), 64);
+    out.write(0, 0);
+    out.writeBit(false);
+    EXPECT_EQ(out.bytes(), referenceBits({ { 0b101, 3 }, { ~uint64_t(0), 64 }, { 0, 1 } }));
+    out.clear();
+    EXPECT_TRUE(out.bytes().empty());
+    EXPECT_EQ(out.bitCount(), 0u);
+}
+
+TEST(BitReader, ReadsBackRandomWidths)
+{
+    const auto writes = randomWrites(5000, 2);
+    BitWriter out;
+    for (const auto &[value, count] : writes) {
+        out.write(value, count);
+    }
+    BitReader in(out.bytes().data(), out.bytes().size());
+    for (const auto &[value, count] : writes) {
+        ASSERT_EQ(in.read(count), lowBits(value, count)) << count;
+    }
+    EXPECT_FALSE(in.overrun());
+}
+
+TEST(BitReader, ReadsZerosPastTheEnd)
+{
+    const std::vector<uint8_t> bytes = { 0xFF, 0x80 };
+    BitReader in(bytes.data(), bytes.size());
+    EXPECT_EQ(in.read(5), 0x1Fu);
+    EXPECT_FALSE(in.overrun());
+    /// 11 bits are left, 111 1000 0000, then zeros
+    EXPECT_EQ(in.read(16), 0xF000u);
+    EXPECT_TRUE(in.overrun());
+    EXPECT_EQ(in.read(64), 0u);
+}
+
+TEST(TimestampEncoder, RoundTripsEveryDeltaOfDeltaRange)
+{
+    std::vector<int64_t> times = { 1700000000000000 };
+    for (int64_t dod : { 0, 1, -1, 63, -64, 64, -65, 255, -256, 256, -257, 2047, -2048, 2048,
+                         -2049, 1000000000, -1000000000 }) {
+        const auto delta = times.size() > 1 ? times.back() - times[times.size() - 2] : 20000;
+        times.push_back(times.back() + delta + dod);
+    }
+    EXPECT_EQ(roundTripTimes(times), times);
+}
+
+TEST(TimestampEncoder, EvenlySpacedTimesTakeOneBitEach)
+{
+    std::vector<int64_t> times;
+    for (int64_t i = 0; i < 1000; ++i) {
+        times.push_back(1700000000000000 + 20000 * i);
+    }
+    BitWriter out;
+    TimestampEncoder encoder(out);
+    for (auto time : times) {
+        encoder.append(time);
+    }
+    /// The first time in full, the second's delta of 20000 in the 64-bit escape
+    EXPECT_EQ(out.bitCount(), 64u + 68u + 998u);
+    EXPECT_EQ(roundTripTimes(times), times);
+}
+
+TEST(FloatEncoder, RoundTripsSpecialValues)
+{
+    const auto inf = std::numeric_limits<double>::infinity();
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    expectFloatsRoundTrip({ 0.0, -0.0, 0.0, 1.0, 1.0, 1.0, -1.0, inf, -inf, nan, nan, 50.0,
+                            std::numeric_limits<double>::denorm_min(),
+                            std::numeric_limits<double>::max(),
+                            std::numeric_limits<double>::lowest() });
+}
+
+TEST(FloatEncoder, RoundTripsXorsWithManyLeadingZeros)
+{
+    /// XORs with more than 31 leading zeros, whose count is capped to fit in 5 bits
+    expectFloatsRoundTrip({ 50.0, std::nextafter(50.0, 51.0), 50.0, std::nextafter(50.0, 49.0),
+                            std::nextafter(std::nextafter(50.0, 49.0), 49.0) });
+}
+
+TEST(FloatEncoder, RoundTripsANoisySignal)
+{
+    std::mt19937 random(3);
+    std::normal_distribution<double> noise(0.0, 0.01);
+    std::vector<double> values;
+    for (int i = 0; i < 86400; ++i) {
+        /// A slowly drifting frequency, stored as float32 like the estimations
+        values.push_back((float)(50.0 + 0.05 * std::sin(i / 600.0) + noise(random)));
+        if (i % 1000 == 0) {
+            values.push_back(std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+    expectFloatsRoundTrip(values);
+}
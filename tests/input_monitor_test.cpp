@@ -0,0 +1,45 @@
+#include "qpmu/input_monitor.h"
+
+#include <gtest/gtest.h>
+
+using namespace qpmu;
+
+namespace {
+
+/// Feeds `count` samples at a fixed interval; returns the number that raised the drift flag
+size_t feed(InputMonitor &monitor, Sample &sample, int64_t intervalUsec, size_t count)
+{
+    size_t drifted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ++sample.seq;
+        sample.timestampUsec += intervalUsec;
+        drifted += (monitor.update(sample).flags & RateDriftFlag) != 0;
+    }
+    return drifted;
+}
+
+} // namespace
+
+TEST(InputMonitor, AcceptsASteadyClockOffTheNominalRate)
+{
+    /// The captures of the reference ADC come every 841 us, not 833.3 us: about 9200 ppm slow
+    InputMonitor monitor(1200);
+    Sample sample = {};
+    EXPECT_EQ(feed(monitor, sample, 841, 12000), 0u);
+    EXPECT_NEAR(monitor.driftPpm(), 9200, 100);
+}
+
+TEST(InputMonitor, FlagsAClockThatDriftsAfterTheWarmUp)
+{
+    InputMonitor monitor(1200);
+    Sample sample = {};
+    feed(monitor, sample, 841, 2400);
+    EXPECT_GT(feed(monitor, sample, 850, 2400), 0u);
+}
+
+TEST(InputMonitor, FlagsAClockFarOffTheNominalRate)
+{
+    InputMonitor monitor(1200);
+    Sample sample = {};
+    EXPECT_GT(feed(monitor, sample, 900, 2400), 0u);
+}
@@ -0,0 +1,74 @@
+#include "qpmu/send_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace qpmu;
+
+namespace {
+
+void push(SendQueue &queue, const std::string &frame, bool reply = false)
+{
+    const auto data = (const uint8_t *)frame.data();
+    reply ? queue.pushReply(data, frame.size(), 0) : queue.push(data, frame.size(), 0);
+}
+
+/// Pops every frame, in the order the socket would get them
+std::vector<std::string> drain(SendQueue &queue)
+{
+    std::vector<std::string> frames;
+    while (!queue.empty()) {
+        frames.emplace_back((const char *)queue.frontData(), queue.frontSize());
+        queue.pop(0);
+    }
+    return frames;
+}
+
+} // namespace
+
+TEST(SendQueue, DropOldestKeepsAQueuedReply)
+{
+    SendQueue queue(3, 16, SendQueue::DropOldest);
+    push(queue, "d1");
+    push(queue, "d2");
+    push(queue, "cfg2", true);
+    for (auto frame : { "d3", "d4", "d5" }) {
+        push(queue, frame);
+    }
+    EXPECT_EQ(drain(queue), (std::vector<std::string>{ "cfg2", "d4", "d5" }));
+    EXPECT_EQ(queue.stats().droppedFrames, 3u);
+    EXPECT_EQ(queue.stats().queuedBytes, 0u);
+}
+
+TEST(SendQueue, RepliesGoAheadOfDataFramesInOrder)
+{
+    SendQueue queue(4, 16, SendQueue::DropOldest);
+    push(queue, "d1");
+    push(queue, "hdr", true);
+    push(queue, "d2");
+    push(queue, "cfg2", true);
+    EXPECT_EQ(drain(queue), (std::vector<std::string>{ "hdr", "cfg2", "d1", "d2" }));
+}
+
+TEST(SendQueue, ReplyToAFullQueueDropsADataFrame)
+{
+    SendQueue oldest(2, 16, SendQueue::DropOldest);
+    push(oldest, "d1");
+    push(oldest, "d2");
+    push(oldest, "cfg2", true);
+    EXPECT_EQ(drain(oldest), (std::vector<std::string>{ "cfg2", "d2" }));
+
+    SendQueue newest(2, 16, SendQueue::DropNewest);
+    push(newest, "d1");
+    push(newest, "d2");
+    push(newest, "cfg2", true);
+    EXPECT_EQ(drain(newest), (std::vector<std::string>{ "cfg2", "d1" }));
+    EXPECT_EQ(newest.stats().droppedFrames, 1u);
+
+    SendQueue disconnect(2, 16, SendQueue::Disconnect);
+    push(disconnect, "d1");
+    push(disconnect, "d2");
+    EXPECT_EQ(disconnect.pushReply((const uint8_t *)"cfg2", 4, 0), SendQueue::Refused);
+}
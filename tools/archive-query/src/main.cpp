@@ -0,0 +1,222 @@
+/// Prints a time range of archived columns as CSV, e.g., the IA magnitude of the last 24 hours at
+/// 1 second resolution:
+///
+///     qpmu-archive-query /var/lib/qpmu/archive --last 24h --step 1s IA.magnitude
+
+#include "qpmu/archive_reader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-archive-query DIRECTORY [OPTION]... COLUMN...
+
+Prints the archived values of the given columns (e.g., IA.magnitude, VA.angle, VA.frequency,
+IA.rocof, sampling_rate) as CSV, with the time in microseconds since epoch.
+
+Options:
+  --station ID      station (ID code) to read; default 0
+  --from TIME       start of the range, as seconds since epoch or YYYY-MM-DDTHH:MM:SS (UTC)
+  --to TIME         end of the range (exclusive); default now
+  --last DURATION   range ending now, instead of --from; e.g., 90s, 15m, 24h, 7d
+  --step DURATION   print the min, max and mean of each step instead of every value
+  --verify          check the chunk checksums (slower)
+  --columns         list the column names and exit
+)";
+
+int64_t nowUsec()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+}
+
+/// Parses a duration with a unit suffix (us, ms, s, m, h, d) into microseconds; -1 if invalid
+int64_t parseDuration(const std::string &text)
+{
+    char *end = nullptr;
+    const double value = std::strtod(text.c_str(), &end);
+    const std::string unit = end;
+    double scale = 0;
+    if (unit == "us") {
+        scale = 1;
+    } else if (unit == "ms") {
+        scale = 1e3;
+    } else if (unit == "s" || unit.empty()) {
+        scale = 1e6;
+    } else if (unit == "m") {
+        scale = 60e6;
+    } else if (unit == "h") {
+        scale = 3600e6;
+    } else if (unit == "d") {
+        scale = 86400e6;
+    }
+    if (end == text.c_str() || scale == 0 || value <= 0) {
+        return -1;
+    }
+    return (int64_t)(value * scale);
+}
+
+/// Parses seconds since epoch, or a UTC date and time, into microseconds; -1 if invalid
+int64_t parseTime(const std::string &text)
+{
+    std::tm tm = {};
+    int length = 0;
+    if (std::sscanf(text.c_str(), "%d-%d-%dT%d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &length)
+        == 6) {
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+#ifdef _WIN32
+        const int64_t seconds = _mkgmtime(&tm);
+#else
+        const int64_t seconds = timegm(&tm);
+#endif
+        /// Optional fraction of a second
+        double fraction = 0;
+        if (text[length] == '.') {
+            char *end = nullptr;
+            fraction = std::strtod(text.c_str() + length, &end);
+            length = (int)(end - text.c_str());
+        }
+        if ((size_t)length != text.size() || seconds < 0) {
+            return -1;
+        }
+        return seconds * 1000000 + (int64_t)(fraction * 1e6);
+    }
+    char *end = nullptr;
+    const double seconds = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0' || seconds < 0) {
+        return -1;
+    }
+    return (int64_t)(seconds * 1e6);
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-archive-query: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    using namespace qpmu;
+
+    std::string directory;
+    ArchiveQuery query;
+    query.toUsec = nowUsec();
+    int64_t lastUsec = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        } else if (arg == "--columns") {
+            for (size_t c = 0; c < ArchiveColumns::Count; ++c) {
+                std::cout << ArchiveColumns::name(c) << "\n";
+            }
+            return 0;
+        } else if (arg == "--station" && hasValue) {
+            query.station = (uint16_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--from" && hasValue) {
+            query.fromUsec = parseTime(argv[++i]);
+            if (query.fromUsec < 0) {
+                return fail("invalid time: " + std::string(argv[i]));
+            }
+        } else if (arg == "--to" && hasValue) {
+            query.toUsec = parseTime(argv[++i]);
+            if (query.toUsec < 0) {
+                return fail("invalid time: " + std::string(argv[i]));
+            }
+        } else if (arg == "--last" && hasValue) {
+            lastUsec = parseDuration(argv[++i]);
+            if (lastUsec < 0) {
+                return fail("invalid duration: " + std::string(argv[i]));
+            }
+        } else if (arg == "--step" && hasValue) {
+            query.bucketUsec = parseDuration(argv[++i]);
+            if (query.bucketUsec < 0) {
+                return fail("invalid duration: " + std::string(argv[i]));
+            }
+        } else if (arg == "--verify") {
+            query.verifyChecksums = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        } else if (directory.empty()) {
+            directory = arg;
+        } else {
+            const auto column = ArchiveColumns::find(arg);
+            if (column == ArchiveColumns::Count) {
+                return fail("unknown column: " + arg + " (see --columns)");
+            }
+            query.columns.push_back(column);
+        }
+    }
+    if (directory.empty() || query.columns.empty()) {
+        return fail(std::string("missing the directory or the columns\n\n") + Usage);
+    }
+    if (lastUsec > 0) {
+        query.fromUsec = query.toUsec - lastUsec;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ArchiveReader reader(directory);
+    const auto result = reader.query(query);
+    const auto elapsedMs = std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+    std::string line = "time_us";
+    for (auto column : query.columns) {
+        const auto name = ArchiveColumns::name(column);
+        line += query.bucketUsec > 0
+                ? "," + name + ".min," + name + ".max," + name + ".mean," + name + ".count"
+                : "," + name;
+    }
+    std::cout << line << "\n";
+
+    /// The columns are decoded from the same records, so their buckets line up
+    size_t countRows = 0;
+    char buffer[64];
+    if (query.bucketUsec > 0) {
+        countRows = result.buckets[0].size();
+        for (size_t r = 0; r < countRows; ++r) {
+            line = std::to_string(result.buckets[0][r].timeUsec);
+            for (const auto &buckets : result.buckets) {
+                const auto &bucket = buckets[r];
+                std::snprintf(buffer, sizeof(buffer), ",%.9g,%.9g,%.9g,%llu", bucket.min,
+                              bucket.max, bucket.mean, (unsigned long long)bucket.count);
+                line += buffer;
+            }
+            std::cout << line << "\n";
+        }
+    } else {
+        countRows = result.times.size();
+        for (size_t r = 0; r < countRows; ++r) {
+            line = std::to_string(result.times[r]);
+            for (const auto &values : result.values) {
+                std::snprintf(buffer, sizeof(buffer), ",%.9g", values[r]);
+                line += buffer;
+            }
+            std::cout << line << "\n";
+        }
+    }
+
+    std::cerr << countRows << " rows from " << result.chunksRead << " chunks in " << elapsedMs
+              << " ms";
+    if (result.chunksFailed > 0) {
+        std::cerr << " (" << result.chunksFailed << " corrupt chunks skipped)";
+    }
+    std::cerr << "\n";
+    return 0;
+}
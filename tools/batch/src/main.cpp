@@ -0,0 +1,440 @@
+/// Re-estimates the phasors of every capture in a directory, in parallel, and writes them with the
+/// columns of `data/*/processed`:
+///
+///     qpmu-batch data/2025-03-23/sampled --output /tmp/processed
+///
+/// The committed `processed` CSVs are the references of qpmu-sweep, so existing files are only
+/// overwritten with `--force`.
+
+#include "qpmu/defs.h"
+#include "qpmu/archive_chunk.h"
+#include "qpmu/archive_writer.h"
+#include "qpmu/estimator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-batch INPUT_DIRECTORY [OPTION]...
+
+Re-estimates the phasors of every capture (*.txt, as printed by the ADC simulator) in the
+directory, one capture per worker thread at a time, and writes each as CSV with the columns of
+data/*/processed.
+
+Options:
+  --output DIR      directory of the CSV files; required unless --no-csv
+  --force           overwrite CSV files that already exist in the output directory
+  --archive DIR     also archive the estimation of every sample, in the daemon's archive format
+                    (see qpmu-archive-query)
+  --station ID      station (ID code) of the archived estimations; default 0
+  --no-csv          do not write the CSV files
+  --jobs N          worker threads; default: one per core
+)";
+
+/// Nominal frequency and sampling rate of the captures (in Hz), as in the app
+constexpr size_t NominalFrequency = 50;
+constexpr size_t SamplingRate = 1200;
+
+/// Samples estimated at a time
+constexpr size_t BatchSize = 4096;
+
+struct Options
+{
+    fs::path input = {};
+    fs::path output = {};
+    fs::path archive = {};
+    uint16_t station = 0;
+    bool csv = true;
+    bool force = false;
+    unsigned jobs = 0;
+};
+
+/// Parses a line of `key=value` fields (`seq`, `ch0` to `ch5`, `time` and `delta`, separated by
+/// commas and whitespace) into a sample; returns false if a field is missing
+bool parseSampleLine(const char *begin, const char *end, qpmu::Sample &sample)
+{
+    using namespace qpmu;
+    uint32_t found = 0;
+    const char *p = begin;
+    while (p < end) {
+        const auto equals = (const char *)std::memchr(p, '=', end - p);
+        if (!equals) {
+            break;
+        }
+        auto keyBegin = p;
+        while (keyBegin < equals && (*keyBegin == ',' || std::isspace((unsigned char)*keyBegin))) {
+            ++keyBegin;
+        }
+        const std::string_view key(keyBegin, equals - keyBegin);
+
+        auto valueBegin = equals + 1;
+        while (valueBegin < end && *valueBegin == ' ') {
+            ++valueBegin;
+        }
+        /// Negative deltas are printed as unsigned, wrapped around
+        uint64_t value = 0;
+        auto result = std::from_chars(valueBegin, end, value);
+        if (result.ec != std::errc()) {
+            int64_t signedValue = 0;
+            result = std::from_chars(valueBegin, end, signedValue);
+            value = (uint64_t)signedValue;
+        }
+        if (result.ec != std::errc()) {
+            return false;
+        }
+        p = result.ptr;
+
+        if (key == "seq") {
+            sample.seq = value;
+            found |= 1u << 0;
+        } else if (key == "time") {
+            sample.timestampUsec = (int64_t)value;
+            found |= 1u << 1;
+        } else if (key == "delta") {
+            sample.timeDeltaUsec = (int64_t)value;
+            found |= 1u << 2;
+        } else if (key.size() == 3 && key[0] == 'c' && key[1] == 'h' && key[2] >= '0'
+                   && (size_t)(key[2] - '0') < CountSignals) {
+            sample.channels[key[2] - '0'] = (uint16_t)value;
+            found |= 1u << (3 + (key[2] - '0'));
+        }
+    }
+    return found == (1u << (3 + CountSignals)) - 1;
+}
+
+/// Appends a double as Python's `repr()` would, i.e., the shortest string that reads back the same
+void appendFloat(std::string &out, double value)
+{
+    char buffer[32];
+    if (std::isnan(value)) {
+        out += "nan";
+        return;
+    }
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+/// Appends a phasor as Python's `repr()` of a complex number, as in the processed files
+void appendComplex(std::string &out, const qpmu::Complex &phasor)
+{
+    const double real = phasor.real();
+    const double imag = phasor.imag();
+    const bool hasReal = !(real == 0 && !std::signbit(real));
+    if (hasReal) {
+        out += '(';
+        appendFloat(out, real);
+    }
+    if (std::isnan(imag) || !std::signbit(imag)) {
+        if (hasReal) {
+            out += '+';
+        }
+    }
+    appendFloat(out, imag);
+    out += 'j';
+    if (hasReal) {
+        out += ')';
+    }
+}
+
+void appendInteger(std::string &out, int64_t value)
+{
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+/// Processes captures handed out by index; one per worker thread
+class Worker
+{
+public:
+    Worker(const Options &options, std::mutex &archiveMutex)
+        : m_options(options), m_archiveMutex(archiveMutex), m_encoder(options.station)
+    {
+        m_estimations.resize(BatchSize);
+    }
+
+    /// Processes a capture; returns the number of samples, or -1 with the reason in `error`
+    int64_t process(const fs::path &path, std::string &error)
+    {
+        using namespace qpmu;
+        std::ifstream file(path, std::ios::binary);
+        const std::string text((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+        if (!file && !file.eof()) {
+            error = "Failed to read " + path.string();
+            return -1;
+        }
+
+        m_samples.clear();
+        size_t lineNumber = 0;
+        for (size_t begin = 0; begin < text.size();) {
+            auto end = text.find('\n', begin);
+            if (end == std::string::npos) {
+                end = text.size();
+            }
+            ++lineNumber;
+            if (end > begin + 1) {
+                Sample sample;
+                if (!parseSampleLine(text.data() + begin, text.data() + end, sample)) {
+                    error = path.string() + ":" + std::to_string(lineNumber)
+                            + ": Not a sample line";
+                    return -1;
+                }
+                m_samples.push_back(sample);
+            }
+            begin = end + 1;
+        }
+
+        /// A fresh estimator for every capture, since the captures are independent
+        PhasorEstimator estimator(NominalFrequency, SamplingRate);
+        m_csv.clear();
+        if (m_options.csv) {
+            m_csv = "seq,time,time_delta";
+            for (size_t i = 0; i < CountSignals; ++i) {
+                m_csv += ",ch" + std::to_string(i);
+            }
+            for (size_t i = 0; i < CountSignals; ++i) {
+                m_csv += ",phasor" + std::to_string(i);
+            }
+            m_csv += '\n';
+        }
+
+        for (size_t first = 0; first < m_samples.size(); first += BatchSize) {
+            const auto count = std::min(BatchSize, m_samples.size() - first);
+            const auto samples = m_samples.data() + first;
+            estimator.updateEstimations(samples, count, m_estimations.data());
+            for (size_t i = 0; i < count; ++i) {
+                if (m_options.csv) {
+                    appendRow(samples[i], m_estimations[i]);
+                }
+                if (!m_options.archive.empty()) {
+                    archive(samples[i].timestampUsec, m_estimations[i]);
+                }
+            }
+        }
+        if (!m_options.archive.empty()) {
+            writeChunk();
+            if (!m_archiveError.empty()) {
+                error = m_archiveError;
+                m_archiveError.clear();
+                return -1;
+            }
+        }
+
+        if (m_options.csv) {
+            const auto outputPath = m_options.output / path.filename().replace_extension(".csv");
+            std::ofstream output(outputPath, std::ios::binary);
+            output.write(m_csv.data(), (std::streamsize)m_csv.size());
+            output.close();
+            if (!output) {
+                error = "Failed to write " + outputPath.string();
+                return -1;
+            }
+        }
+        return (int64_t)m_samples.size();
+    }
+
+private:
+    void appendRow(const qpmu::Sample &sample, const qpmu::Estimation &estimation)
+    {
+        appendInteger(m_csv, (int64_t)sample.seq);
+        m_csv += ',';
+        appendInteger(m_csv, sample.timestampUsec);
+        m_csv += ',';
+        appendInteger(m_csv, sample.timeDeltaUsec);
+        for (auto channel : sample.channels) {
+            m_csv += ',';
+            appendInteger(m_csv, channel);
+        }
+        for (const auto &phasor : estimation.phasors) {
+            m_csv += ',';
+            appendComplex(m_csv, phasor);
+        }
+        m_csv += '\n';
+    }
+
+    /// Adds an estimation to the open chunk, which is written when full or at the end of a day,
+    /// as the archive writer does
+    void archive(int64_t timeUsec, const qpmu::Estimation &estimation)
+    {
+        constexpr int64_t UsecPerDay = 86400LL * 1000000;
+        if (m_encoder.count() > 0
+            && timeUsec / UsecPerDay != m_encoder.firstTimeUsec() / UsecPerDay) {
+            writeChunk();
+        }
+        m_encoder.append(timeUsec, estimation);
+        if (m_encoder.count() >= qpmu::ArchiveConfig().chunkRecords) {
+            writeChunk();
+        }
+    }
+
+    /// Appends the open chunk to its day file; a failure is kept in `m_archiveError`
+    void writeChunk()
+    {
+        if (m_encoder.count() == 0) {
+            return;
+        }
+        const auto directory = m_options.archive.string();
+        const auto path = qpmu::ArchiveWriter::filePath(directory, m_encoder.firstTimeUsec());
+        m_chunk.clear();
+        m_encoder.finish(m_chunk);
+
+        /// The workers append whole chunks to the same day files, one at a time
+        std::lock_guard<std::mutex> lock(m_archiveMutex);
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write((const char *)m_chunk.data(), (std::streamsize)m_chunk.size());
+        file.close();
+        if (!file) {
+            m_archiveError = "Failed to write " + path;
+        }
+    }
+
+    const Options &m_options;
+    std::mutex &m_archiveMutex;
+
+    std::vector<qpmu::Sample> m_samples = {};
+    std::vector<qpmu::Estimation> m_estimations = {};
+    std::string m_csv = {};
+
+    qpmu::ArchiveChunkEncoder m_encoder;
+    std::vector<uint8_t> m_chunk = {};
+    std::string m_archiveError = {};
+};
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-batch: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        } else if (arg == "--output" && hasValue) {
+            options.output = argv[++i];
+        } else if (arg == "--archive" && hasValue) {
+            options.archive = argv[++i];
+        } else if (arg == "--station" && hasValue) {
+            options.station = (uint16_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--no-csv") {
+            options.csv = false;
+        } else if (arg == "--force") {
+            options.force = true;
+        } else if (arg == "--jobs" && hasValue) {
+            options.jobs = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg.rfind("--", 0) == 0) {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        } else if (options.input.empty()) {
+            options.input = arg;
+        } else {
+            return fail("unexpected argument: " + arg + "\n\n" + Usage);
+        }
+    }
+    if (options.input.empty()) {
+        return fail(std::string("missing the input directory\n\n") + Usage);
+    }
+    if (options.csv && options.output.empty()) {
+        return fail(std::string("missing --output\n\n") + Usage);
+    }
+    if (options.jobs == 0) {
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::error_code errorCode;
+    std::vector<fs::path> captures;
+    for (const auto &entry : fs::directory_iterator(options.input, errorCode)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".txt") {
+            captures.push_back(entry.path());
+        }
+    }
+    if (errorCode) {
+        return fail("cannot read " + options.input.string() + ": " + errorCode.message());
+    }
+    std::sort(captures.begin(), captures.end());
+    if (options.csv && !options.force) {
+        for (const auto &capture : captures) {
+            const auto outputPath = options.output / capture.filename().replace_extension(".csv");
+            if (fs::exists(outputPath, errorCode)) {
+                return fail(outputPath.string() + " exists; use --force to overwrite it");
+            }
+        }
+    }
+    for (const auto &directory : { options.csv ? options.output : fs::path(), options.archive }) {
+        if (!directory.empty() && !fs::create_directories(directory, errorCode) && errorCode) {
+            return fail("cannot create " + directory.string() + ": " + errorCode.message());
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsedSeconds = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    /// Each worker takes the next capture until none are left
+    std::atomic<size_t> next = { 0 };
+    std::atomic<size_t> done = { 0 };
+    std::atomic<int64_t> countSamples = { 0 };
+    std::atomic<size_t> countFailed = { 0 };
+    std::mutex logMutex;
+    std::mutex archiveMutex;
+
+    std::vector<std::thread> workers;
+    const auto countWorkers = std::min<size_t>(options.jobs, captures.size());
+    for (size_t w = 0; w < countWorkers; ++w) {
+        workers.emplace_back([&] {
+            Worker worker(options, archiveMutex);
+            std::string error;
+            for (size_t i; (i = next.fetch_add(1)) < captures.size();) {
+                error.clear();
+                const auto samples = worker.process(captures[i], error);
+                std::lock_guard<std::mutex> lock(logMutex);
+                const auto index = ++done;
+                if (samples < 0) {
+                    ++countFailed;
+                    std::cerr << "[" << index << "/" << captures.size() << "] " << error << "\n";
+                } else {
+                    countSamples += samples;
+                    std::cerr << "[" << index << "/" << captures.size() << "] "
+                              << captures[i].filename().string() << ": " << samples
+                              << " samples\n";
+                }
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    const auto seconds = elapsedSeconds();
+    std::cerr << captures.size() - countFailed << " captures, " << countSamples << " samples in "
+              << seconds << " s (" << (int64_t)(countSamples / std::max(seconds, 1e-9))
+              << " samples/s, " << countWorkers << " workers)\n";
+    return countFailed > 0 ? 1 : 0;
+}
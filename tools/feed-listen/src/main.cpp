@@ -0,0 +1,196 @@
+/// Receives the internal estimation feed and reports each station's packet rate and losses, e.g.
+/// on loopback multicast:
+///
+///     qpmu-feed-listen 239.192.0.1:4720 --csv > feed.csv
+
+#include "qpmu/estimation_packet.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-feed-listen ADDRESS:PORT [OPTION]...
+
+Receives the estimation packets sent to the address -- a multicast group, which is joined, or a
+local address -- and prints each station's packet rate, losses and reordered packets to stderr
+every second, until the duration has passed or it is interrupted.
+
+Options:
+  --interface ADDRESS    local address of the interface to join the group on; default: any
+  --csv                  print every packet to stdout as CSV
+  --duration SECONDS     stop after this long
+)";
+
+struct Options
+{
+    std::string host = {};
+    uint16_t port = 0;
+    std::string interface = "0.0.0.0";
+    bool csv = false;
+    double duration = 0;
+};
+
+std::atomic<bool> stopRequested = { false };
+
+void handleSignal(int)
+{
+    stopRequested.store(true);
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-feed-listen: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    using namespace qpmu;
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        } else if (arg == "--csv") {
+            options.csv = true;
+        } else if (arg == "--interface" && i + 1 < argc) {
+            options.interface = argv[++i];
+        } else if (arg == "--duration" && i + 1 < argc) {
+            options.duration = std::strtod(argv[++i], nullptr);
+        } else if (arg[0] != '-' && options.host.empty()) {
+            const auto colon = arg.rfind(':');
+            if (colon == std::string::npos) {
+                return fail("not ADDRESS:PORT: " + arg);
+            }
+            options.host = arg.substr(0, colon);
+            options.port = (uint16_t)std::strtoul(arg.c_str() + colon + 1, nullptr, 10);
+        } else {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        }
+    }
+    if (options.host.empty() || options.port == 0) {
+        return fail(std::string("no address\n\n") + Usage);
+    }
+
+    in_addr group = {};
+    in_addr interface = {};
+    if (::inet_pton(AF_INET, options.host.c_str(), &group) != 1
+        || ::inet_pton(AF_INET, options.interface.c_str(), &interface) != 1) {
+        return fail("invalid IPv4 address");
+    }
+    const bool multicast = IN_MULTICAST(ntohl(group.s_addr));
+
+    const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    const int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int bufferBytes = 4 << 20;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+    timeval timeout = { 0, 200000 };
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    address.sin_addr.s_addr = multicast ? htonl(INADDR_ANY) : group.s_addr;
+    if (::bind(fd, (const sockaddr *)&address, sizeof(address)) != 0) {
+        return fail(std::string("bind: ") + std::strerror(errno));
+    }
+    if (multicast) {
+        ip_mreq membership = {};
+        membership.imr_multiaddr = group;
+        membership.imr_interface = interface;
+        if (::setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership))
+            != 0) {
+            return fail(std::string("cannot join the group: ") + std::strerror(errno));
+        }
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    if (options.csv) {
+        std::printf("id_code,seq,timestamp_us");
+        for (const char *name : { "VA", "VB", "VC", "IA", "IB", "IC" }) {
+            std::printf(",%s_re,%s_im,%s_freq,%s_rocof", name, name, name, name);
+        }
+        std::printf(",sampling_rate\n");
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    auto lastReport = start;
+    std::map<uint16_t, EstimationPacketTracker> stations;
+    std::map<uint16_t, uint64_t> reported;
+    uint64_t malformed = 0;
+    uint8_t data[2048];
+    EstimationPacket packet;
+
+    auto report = [&](double seconds) {
+        for (const auto &[idCode, tracker] : stations) {
+            std::fprintf(stderr,
+                         "station %u: %.1f packets/s, received %llu, lost %llu, reordered %llu, "
+                         "restarts %llu\n",
+                         idCode, (tracker.received - reported[idCode]) / seconds,
+                         (unsigned long long)tracker.received, (unsigned long long)tracker.lost,
+                         (unsigned long long)tracker.reordered,
+                         (unsigned long long)tracker.restarts);
+            reported[idCode] = tracker.received;
+        }
+        if (malformed) {
+            std::fprintf(stderr, "malformed datagrams: %llu\n", (unsigned long long)malformed);
+        }
+    };
+
+    while (!stopRequested) {
+        const auto n = ::recv(fd, data, sizeof(data), 0);
+        if (n >= 0) {
+            if (!packet.decode(data, (size_t)n)) {
+                ++malformed;
+            } else {
+                stations[packet.idCode].update(packet.sequence);
+                if (options.csv) {
+                    std::printf("%u,%llu,%lld", packet.idCode, (unsigned long long)packet.sequence,
+                                (long long)packet.timestampUsec);
+                    for (size_t i = 0; i < EstimationPacket::Signals; ++i) {
+                        std::printf(",%g,%g,%g,%g", packet.phasors[i][0], packet.phasors[i][1],
+                                    packet.frequencies[i], packet.rocofs[i]);
+                    }
+                    std::printf(",%g\n", packet.samplingRate);
+                }
+            }
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return fail(std::string("recv: ") + std::strerror(errno));
+        }
+
+        const auto now = Clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            report(std::chrono::duration<double>(now - lastReport).count());
+            lastReport = now;
+        }
+        const auto elapsed = std::chrono::duration<double>(now - start).count();
+        if (options.duration > 0 && elapsed >= options.duration) {
+            break;
+        }
+    }
+    report(std::max(1e-9, std::chrono::duration<double>(Clock::now() - lastReport).count()));
+    ::close(fd);
+    return 0;
+}
@@ -0,0 +1,557 @@
+/// Generates synthetic ADC samples at a given rate, with optional faults, into a pipe, a UDP
+/// socket or a shared-memory sample ring, to load a station's pipeline:
+///
+///     qpmu-loadgen --fifo /tmp/adc --rate 200000 --gap 0.001 &
+///     ADC_STREAM=/tmp/adc qpmu-daemon -b
+
+#include "qpmu/defs.h"
+#include "qpmu/sample_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-loadgen [OPTION]...
+
+Writes binary samples (qpmu::Sample records, as read by `-b`) of three voltages and three
+currents, paced to the sampling rate, until the count or the duration is reached or it is
+interrupted. Statistics are printed to stderr every second.
+
+Output (default: stdout):
+  --output PATH          a file, or an existing named pipe or device
+  --fifo PATH            a named pipe, created (or replaced) at the path
+  --udp HOST:PORT        datagrams of whole records (see --batch)
+  --shm NAME             a shared-memory sample ring, e.g. /qpmu-adc (input shm://qpmu-adc)
+  --batch N              samples per write or datagram; default 64
+
+Signal:
+  --rate HZ              sampling rate; default 1200
+  --unpaced              write as fast as the output takes the samples; the timestamps still
+                         advance at the sampling rate
+  --count N              stop after N samples
+  --duration SECONDS     stop after this much sampled time
+  --bits N               ADC resolution; default 12
+  --waveform sine|square default sine
+  --frequency HZ         default 50
+  --ramp HZ_PER_S        change the frequency at this rate...
+  --ramp-seconds S       ...for this long, then hold it; default: for ever
+  --voltage FRACTION     voltage amplitude, of the half scale; default 0.8
+  --current FRACTION     current amplitude, of the half scale; default 0.4
+  --phase-shift DEGREES  of the currents behind the voltages; default 15
+  --harmonic N:FRACTION  add the Nth harmonic, with this fraction of the amplitude; repeatable
+  --noise FRACTION       uniform noise, of the half scale; default 0.01
+  --seed N               of the noise and the faults; default 1
+
+Faults (each with probability P per sample):
+  --gap P[:MAX]          skip 1 to MAX (default 1) samples: their sequence numbers and time
+  --duplicate P          write the sample twice
+  --time-jump P:USEC     shift all later timestamps by USEC (may be negative)
+  --truncate P           write only part of the record; a stream output loses its framing, and a
+                         datagram ends early (not with --shm)
+)";
+
+constexpr double Pi = 3.14159265358979323846;
+
+struct Options
+{
+    enum Output { StdoutOutput, FileOutput, FifoOutput, UdpOutput, ShmOutput };
+    Output output = StdoutOutput;
+    std::string target = {};
+    size_t batch = 64;
+
+    double rate = 1200;
+    bool paced = true;
+    uint64_t count = 0;
+    double duration = 0;
+    int bits = 12;
+    bool square = false;
+    double frequency = 50;
+    double ramp = 0;
+    double rampSeconds = -1;
+    double voltage = 0.8;
+    double current = 0.4;
+    double phaseShiftDegrees = 15;
+    std::vector<std::pair<int, double>> harmonics = {};
+    double noise = 0.01;
+    uint64_t seed = 1;
+
+    double gapProbability = 0;
+    int maxGap = 1;
+    double duplicateProbability = 0;
+    double jumpProbability = 0;
+    int64_t jumpUsec = 0;
+    double truncateProbability = 0;
+};
+
+struct Stats
+{
+    uint64_t samples = 0;
+    uint64_t gaps = 0;
+    uint64_t duplicates = 0;
+    uint64_t jumps = 0;
+    uint64_t truncated = 0;
+    /// Times the output could not take a batch at once
+    uint64_t stalls = 0;
+};
+
+std::atomic<bool> stopRequested = { false };
+
+void handleSignal(int)
+{
+    stopRequested.store(true);
+}
+
+/// Destination of the generated bytes
+class Sink
+{
+public:
+    virtual ~Sink() = default;
+
+    /// Writes the bytes (whole or truncated records); returns false on a fatal error
+    virtual bool write(const uint8_t *data, size_t size, Stats &stats, std::string &error) = 0;
+};
+
+class StreamSink : public Sink
+{
+public:
+    explicit StreamSink(int fd) : m_fd(fd) { }
+    ~StreamSink() override
+    {
+        if (m_fd > STDERR_FILENO) {
+            ::close(m_fd);
+        }
+    }
+
+    bool write(const uint8_t *data, size_t size, Stats &stats, std::string &error) override
+    {
+        bool stalled = false;
+        while (size > 0) {
+            const auto n = ::write(m_fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR && !stopRequested) {
+                    continue;
+                }
+                error = std::string("write: ") + std::strerror(errno);
+                return false;
+            }
+            stalled |= (size_t)n < size;
+            data += n;
+            size -= (size_t)n;
+        }
+        stats.stalls += stalled;
+        return true;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+class UdpSink : public Sink
+{
+public:
+    UdpSink(int socket, const sockaddr_storage &address, socklen_t length)
+        : m_socket(socket), m_address(address), m_length(length)
+    {
+    }
+    ~UdpSink() override { ::close(m_socket); }
+
+    bool write(const uint8_t *data, size_t size, Stats &stats, std::string &error) override
+    {
+        while (::sendto(m_socket, data, size, 0, (const sockaddr *)&m_address, m_length) < 0) {
+            if (errno == ENOBUFS || errno == EAGAIN) {
+                ++stats.stalls;
+                std::this_thread::yield();
+                continue;
+            }
+            if (errno == ECONNREFUSED || errno == EINTR) {
+                return true;
+            }
+            error = std::string("sendto: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int m_socket = -1;
+    sockaddr_storage m_address = {};
+    socklen_t m_length = 0;
+};
+
+class ShmSink : public Sink
+{
+public:
+    bool create(const std::string &name, std::string &error)
+    {
+        return m_ring.create(name, qpmu::SampleRing::DefaultCapacity, error);
+    }
+
+    bool write(const uint8_t *data, size_t size, Stats &stats, std::string &) override
+    {
+        auto samples = (const qpmu::Sample *)data;
+        auto count = size / sizeof(qpmu::Sample);
+        bool stalled = false;
+        while (count > 0 && !stopRequested) {
+            const auto n = m_ring.write(samples, count);
+            if (n == 0) {
+                stalled = true;
+                std::this_thread::yield();
+            }
+            samples += n;
+            count -= n;
+        }
+        stats.stalls += stalled;
+        return true;
+    }
+
+private:
+    qpmu::SampleRing m_ring;
+};
+
+std::unique_ptr<Sink> openSink(const Options &options, std::string &error)
+{
+    switch (options.output) {
+    case Options::StdoutOutput:
+        return std::unique_ptr<Sink>(new StreamSink(STDOUT_FILENO));
+    case Options::FifoOutput:
+        ::unlink(options.target.c_str());
+        if (::mkfifo(options.target.c_str(), 0600) != 0) {
+            error = "Failed to create the pipe " + options.target + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        std::cerr << "Waiting for a reader of " << options.target << "\n";
+        [[fallthrough]];
+    case Options::FileOutput: {
+        const int fd = ::open(options.target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            error = "Failed to open " + options.target + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        return std::unique_ptr<Sink>(new StreamSink(fd));
+    }
+    case Options::UdpOutput: {
+        const auto colon = options.target.rfind(':');
+        if (colon == std::string::npos) {
+            error = "Not HOST:PORT: " + options.target;
+            return nullptr;
+        }
+        const auto host = options.target.substr(0, colon);
+        const auto port = options.target.substr(colon + 1);
+        addrinfo hints = {};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo *result = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+            error = "Failed to resolve " + options.target;
+            return nullptr;
+        }
+        sockaddr_storage address = {};
+        std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+        const auto length = (socklen_t)result->ai_addrlen;
+        ::freeaddrinfo(result);
+        const int socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket < 0) {
+            error = std::string("Failed to create a UDP socket: ") + std::strerror(errno);
+            return nullptr;
+        }
+        int bufferBytes = 4 << 20;
+        ::setsockopt(socket, SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+        return std::unique_ptr<Sink>(new UdpSink(socket, address, length));
+    }
+    case Options::ShmOutput: {
+        std::unique_ptr<ShmSink> sink(new ShmSink());
+        if (!sink->create(options.target, error)) {
+            return nullptr;
+        }
+        return sink;
+    }
+    }
+    return nullptr;
+}
+
+/// Waveforms of the six channels, advanced sample by sample
+class SignalGenerator
+{
+public:
+    explicit SignalGenerator(const Options &options)
+        : m_options(options), m_random(options.seed), m_uniform(-1, 1)
+    {
+        m_halfScale = ((1 << options.bits) - 1) / 2.0;
+        m_maxValue = (1 << options.bits) - 1;
+    }
+
+    /// Channel values at the time of the sample, `elapsedSec` after the start
+    void sample(double elapsedSec, uint16_t *channels)
+    {
+        using namespace qpmu;
+        /// Phase of the fundamental: the integral of the (ramped) frequency
+        const auto rampSec = m_options.rampSeconds < 0
+                ? elapsedSec
+                : std::min(elapsedSec, m_options.rampSeconds);
+        const auto phase = 2 * Pi
+                * (m_options.frequency * elapsedSec + m_options.ramp * rampSec * rampSec / 2
+                   + m_options.ramp * rampSec * (elapsedSec - rampSec));
+
+        for (size_t ch = 0; ch < CountSignals; ++ch) {
+            const bool voltage = TypeOfSignal[ch] == VoltageSignal;
+            const auto amplitude = (voltage ? m_options.voltage : m_options.current) * m_halfScale;
+            const auto offset = -2 * Pi / 3 * PhaseOfSignal[ch]
+                    - (voltage ? 0 : m_options.phaseShiftDegrees * Pi / 180);
+            const auto angle = phase + offset;
+
+            double value = m_options.square ? (std::sin(angle) >= 0 ? 1.0 : -1.0)
+                                            : std::sin(angle);
+            for (const auto &[order, fraction] : m_options.harmonics) {
+                value += fraction * std::sin(order * angle);
+            }
+            value = m_halfScale + amplitude * value
+                    + m_options.noise * m_halfScale * m_uniform(m_random);
+            channels[ch] = (uint16_t)std::clamp(std::lround(value), 0L, m_maxValue);
+        }
+    }
+
+private:
+    const Options &m_options;
+    std::mt19937_64 m_random;
+    std::uniform_real_distribution<double> m_uniform;
+    double m_halfScale = 0;
+    long m_maxValue = 0;
+};
+
+bool parseProbability(const char *text, double &probability)
+{
+    char *end = nullptr;
+    probability = std::strtod(text, &end);
+    return end != text && probability >= 0 && probability <= 1;
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-loadgen: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        const char *value = hasValue ? argv[i + 1] : "";
+        bool ok = true;
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        } else if (arg == "--unpaced") {
+            options.paced = false;
+            continue;
+        } else if (!hasValue) {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        }
+
+        ++i;
+        char *end = nullptr;
+        if (arg == "--output" || arg == "--fifo" || arg == "--udp" || arg == "--shm") {
+            options.output = arg == "--output" ? Options::FileOutput
+                    : arg == "--fifo"          ? Options::FifoOutput
+                    : arg == "--udp"           ? Options::UdpOutput
+                                               : Options::ShmOutput;
+            options.target = value;
+            if (options.output == Options::FileOutput && options.target == "-") {
+                options.output = Options::StdoutOutput;
+            }
+        } else if (arg == "--batch") {
+            options.batch = std::strtoul(value, &end, 10);
+            ok = options.batch > 0 && options.batch <= 1024;
+        } else if (arg == "--rate") {
+            options.rate = std::strtod(value, &end);
+            ok = options.rate > 0;
+        } else if (arg == "--count") {
+            options.count = std::strtoull(value, &end, 10);
+        } else if (arg == "--duration") {
+            options.duration = std::strtod(value, &end);
+        } else if (arg == "--bits") {
+            options.bits = (int)std::strtol(value, &end, 10);
+            ok = options.bits > 0 && options.bits <= 16;
+        } else if (arg == "--waveform") {
+            ok = std::strcmp(value, "sine") == 0 || std::strcmp(value, "square") == 0;
+            options.square = std::strcmp(value, "square") == 0;
+        } else if (arg == "--frequency") {
+            options.frequency = std::strtod(value, &end);
+        } else if (arg == "--ramp") {
+            options.ramp = std::strtod(value, &end);
+        } else if (arg == "--ramp-seconds") {
+            options.rampSeconds = std::strtod(value, &end);
+        } else if (arg == "--voltage") {
+            options.voltage = std::strtod(value, &end);
+        } else if (arg == "--current") {
+            options.current = std::strtod(value, &end);
+        } else if (arg == "--phase-shift") {
+            options.phaseShiftDegrees = std::strtod(value, &end);
+        } else if (arg == "--harmonic") {
+            const int order = (int)std::strtol(value, &end, 10);
+            ok = order > 1 && *end == ':';
+            const double fraction = ok ? std::strtod(end + 1, &end) : 0;
+            options.harmonics.push_back({ order, fraction });
+        } else if (arg == "--noise") {
+            options.noise = std::strtod(value, &end);
+        } else if (arg == "--seed") {
+            options.seed = std::strtoull(value, &end, 10);
+        } else if (arg == "--gap") {
+            ok = parseProbability(value, options.gapProbability);
+            if (const auto colon = std::strchr(value, ':')) {
+                options.maxGap = (int)std::strtol(colon + 1, nullptr, 10);
+                ok = ok && options.maxGap > 0;
+            }
+        } else if (arg == "--duplicate") {
+            ok = parseProbability(value, options.duplicateProbability);
+        } else if (arg == "--time-jump") {
+            ok = parseProbability(value, options.jumpProbability);
+            const auto colon = std::strchr(value, ':');
+            ok = ok && colon;
+            options.jumpUsec = ok ? std::strtoll(colon + 1, nullptr, 10) : 0;
+        } else if (arg == "--truncate") {
+            ok = parseProbability(value, options.truncateProbability);
+        } else {
+            return fail("unknown option: " + arg + "\n\n" + Usage);
+        }
+        if (!ok || (end && end == value)) {
+            return fail("invalid value of " + arg + ": " + value);
+        }
+    }
+    if (options.output == Options::ShmOutput && options.truncateProbability > 0) {
+        return fail("--truncate does not apply to a shared-memory ring");
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::string error;
+    auto sink = openSink(options, error);
+    if (!sink) {
+        return fail(error);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    using namespace qpmu;
+    SignalGenerator generator(options);
+    std::mt19937_64 faults(options.seed ^ 0x9e3779b97f4a7c15ULL);
+    std::uniform_real_distribution<double> chance(0, 1);
+    auto happens = [&](double probability) {
+        return probability > 0 && chance(faults) < probability;
+    };
+
+    const auto periodUsec = 1e6 / options.rate;
+    const int64_t startUsec = std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::system_clock::now().time_since_epoch())
+                                      .count();
+    const auto start = Clock::now();
+    auto lastReport = start;
+    Stats stats;
+    Stats reported;
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve((options.batch * 2 + 1) * sizeof(Sample));
+    uint64_t index = 0;
+    int64_t jumpUsec = 0;
+    int64_t previousUsec = startUsec;
+    bool ok = true;
+
+    while (ok && !stopRequested) {
+        buffer.clear();
+        bool truncatedDatagram = false;
+        for (size_t n = 0; n < options.batch && !truncatedDatagram; ++n) {
+            if (happens(options.gapProbability)) {
+                index += 1 + (uint64_t)(chance(faults) * options.maxGap) % options.maxGap;
+                ++stats.gaps;
+            }
+            if (happens(options.jumpProbability)) {
+                jumpUsec += options.jumpUsec;
+                ++stats.jumps;
+            }
+            const auto elapsedSec = index / options.rate;
+            if ((options.count && index >= options.count)
+                || (options.duration > 0 && elapsedSec >= options.duration)) {
+                stopRequested = true;
+                break;
+            }
+
+            Sample sample;
+            sample.seq = index;
+            sample.timestampUsec = startUsec + std::llround(index * periodUsec) + jumpUsec;
+            sample.timeDeltaUsec = sample.timestampUsec - previousUsec;
+            previousUsec = sample.timestampUsec;
+            generator.sample(elapsedSec, sample.channels);
+            ++index;
+
+            const auto bytes = (const uint8_t *)&sample;
+            auto size = sizeof(Sample);
+            if (happens(options.truncateProbability)) {
+                size = 1 + (size_t)(chance(faults) * (sizeof(Sample) - 1)) % (sizeof(Sample) - 1);
+                ++stats.truncated;
+                truncatedDatagram = options.output == Options::UdpOutput;
+            }
+            buffer.insert(buffer.end(), bytes, bytes + size);
+            ++stats.samples;
+            if (size == sizeof(Sample) && happens(options.duplicateProbability)) {
+                buffer.insert(buffer.end(), bytes, bytes + size);
+                ++stats.duplicates;
+                ++stats.samples;
+            }
+        }
+        if (!buffer.empty()) {
+            ok = sink->write(buffer.data(), buffer.size(), stats, error);
+        }
+
+        const auto now = Clock::now();
+        if (options.paced) {
+            const auto due = start
+                    + std::chrono::duration_cast<Clock::duration>(
+                                     std::chrono::duration<double>(index / options.rate));
+            if (due > now) {
+                std::this_thread::sleep_until(due);
+            }
+        }
+        if (now - lastReport >= std::chrono::seconds(1) || !ok || stopRequested) {
+            const auto seconds = std::chrono::duration<double>(now - lastReport).count();
+            std::fprintf(stderr,
+                         "%.0f samples/s (%llu in all), gaps %llu, duplicates %llu, jumps %llu, "
+                         "truncated %llu, output stalls %llu\n",
+                         (stats.samples - reported.samples) / std::max(seconds, 1e-9),
+                         (unsigned long long)stats.samples, (unsigned long long)stats.gaps,
+                         (unsigned long long)stats.duplicates, (unsigned long long)stats.jumps,
+                         (unsigned long long)stats.truncated, (unsigned long long)stats.stalls);
+            reported = stats;
+            lastReport = now;
+        }
+    }
+    if (!ok) {
+        return fail(error);
+    }
+    return 0;
+}
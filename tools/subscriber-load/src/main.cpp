@@ -0,0 +1,499 @@
+/// Opens many C37.118 client connections to a phasor server, some of which may read slowly, and
+/// reports each client's frame rate, losses, latency and jitter:
+///
+///     qpmu-loadgen --fifo /tmp/adc --rate 12000 &
+///     ADC_STREAM=/tmp/adc qpmu-daemon -b &
+///     qpmu-subscriber-load --clients 16 --slow 2 --duration 30 > clients.csv
+
+#include "qpmu/frame_assembler.h"
+#include "qpmu/frames.h"
+#include "qpmu/latency_histogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-subscriber-load [OPTION]...
+
+Connects the clients, requests each one's configuration (CFG-2) and enables its data output,
+then decodes the data frames until the duration has passed or it is interrupted. The totals of
+all clients are printed to stderr every second, and one CSV row per client to stdout at the end.
+
+Options:
+  --host HOST            of the phasor server; default 127.0.0.1
+  --port PORT            default 4712
+  --clients N            connections; default 8 (the server accepts up to 32)
+  --duration SECONDS     of the whole run, including the connection; default 10
+  --rate FPS             request this reporting rate (one of the server's configured rates)
+  --slow N               the last N clients read slowly, with a small receive buffer
+  --slow-bytes-per-second B
+                         reading rate of the slow clients; default 2000
+  --connect-timeout S    keep retrying to connect this long, e.g. while the server starts;
+                         default 5
+
+Latency is the age of a frame's timestamp when the frame is received, by the system clock, so the
+server should run on the same host (or on a synchronized one). Jitter is the deviation of the
+interval between consecutive frames from the reporting period. Frames are lost when their
+timestamps skip reporting instants.
+)";
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    std::string port = "4712";
+    int clients = 8;
+    double duration = 10;
+    uint16_t rate = 0;
+    int slow = 0;
+    double slowBytesPerSecond = 2000;
+    double connectTimeout = 5;
+};
+
+/// Receive buffer of the slow clients, so that the server's socket buffer fills soon
+constexpr int SlowReceiveBufferBytes = 4096;
+
+/// Timeout of a receive, to notice the end of the run
+constexpr int ReceiveTimeoutMsec = 200;
+
+std::atomic<bool> stopRequested = { false };
+
+void handleSignal(int)
+{
+    stopRequested.store(true);
+}
+
+int64_t nowUsec()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+}
+
+/// What a data frame's decoding needs from a CFG-2 frame
+struct Configuration
+{
+    uint32_t timeBase = 1000000;
+    std::vector<qpmu::StationLayout> stations = {};
+    /// Positive: frames per second; negative: seconds per frame
+    int16_t dataRate = 0;
+
+    int64_t periodUsec() const
+    {
+        return dataRate > 0 ? 1000000 / dataRate : -(int64_t)dataRate * 1000000;
+    }
+
+    size_t dataFrameSize() const
+    {
+        size_t size = qpmu::FrameHeaderSize + qpmu::FrameChecksumSize;
+        for (const auto &station : stations) {
+            size += station.size();
+        }
+        return size;
+    }
+};
+
+/// Parses a CFG-2 frame (IEEE C37.118.2-2011, 6.4); returns false if it is malformed
+bool parseConfiguration(const uint8_t *frame, size_t size, Configuration &config)
+{
+    using namespace qpmu;
+    const uint8_t *p = frame + FrameHeaderSize;
+    const uint8_t *end = frame + size - FrameChecksumSize;
+    if (p + 6 > end) {
+        return false;
+    }
+    config.timeBase = readU32(p) & 0x00FFFFFF;
+    const auto countStations = readU16(p + 4);
+    p += 6;
+    config.stations.clear();
+    for (uint16_t i = 0; i < countStations; ++i) {
+        /// STN, IDCODE, FORMAT, PHNMR, ANNMR, DGNMR
+        if (p + 26 > end) {
+            return false;
+        }
+        const auto format = readU16(p + 18);
+        StationLayout station;
+        station.countPhasors = readU16(p + 20);
+        station.countAnalogs = readU16(p + 22);
+        station.countDigitals = readU16(p + 24);
+        station.polarPhasors = format & 0x1;
+        station.floatPhasors = format & 0x2;
+        station.floatAnalogs = format & 0x4;
+        station.floatFrequency = format & 0x8;
+        p += 26;
+
+        /// Channel names, units, FNOM and CFGCNT
+        p += 16 * (station.countPhasors + station.countAnalogs + 16 * station.countDigitals);
+        p += 4 * (station.countPhasors + station.countAnalogs + station.countDigitals);
+        if (p + 4 > end) {
+            return false;
+        }
+        station.nominalFrequency = (readU16(p) & 0x1) ? 50 : 60;
+        p += 4;
+        config.stations.push_back(station);
+    }
+    if (p + 2 > end || config.timeBase == 0) {
+        return false;
+    }
+    config.dataRate = (int16_t)readU16(p);
+    return config.dataRate != 0;
+}
+
+/// Command frame (IEEE C37.118.2-2011, 6.5), with an optional EXTFRAME word
+std::vector<uint8_t> commandFrame(uint16_t command, int extendedWord = -1)
+{
+    using namespace qpmu;
+    std::vector<uint8_t> frame(FrameHeaderSize + 2 + (extendedWord >= 0 ? 2 : 0)
+                               + FrameChecksumSize);
+    auto put16 = [&](size_t offset, uint16_t value) {
+        frame[offset] = (uint8_t)(value >> 8);
+        frame[offset + 1] = (uint8_t)value;
+    };
+    const auto t = nowUsec();
+    frame[0] = FrameSyncByte;
+    frame[1] = (uint8_t)((CommandFrameType << 4) | 1);
+    put16(2, (uint16_t)frame.size());
+    put16(4, 1);
+    put16(6, (uint16_t)((t / 1000000) >> 16));
+    put16(8, (uint16_t)(t / 1000000));
+    put16(10, 0);
+    put16(12, 0);
+    put16(FrameHeaderSize, command);
+    if (extendedWord >= 0) {
+        put16(FrameHeaderSize + 2, (uint16_t)extendedWord);
+    }
+    put16(frame.size() - 2, crcCcitt(frame.data(), frame.size() - 2));
+    return frame;
+}
+
+/// One connection and its measurements. The counts are read by the main thread while the
+/// client's thread updates them.
+struct Client
+{
+    int index = 0;
+    bool slow = false;
+
+    std::atomic<uint64_t> frames = { 0 };
+    std::atomic<uint64_t> lostFrames = { 0 };
+    /// Frames of an unexpected size, or with stations whose data is flagged invalid
+    std::atomic<uint64_t> badFrames = { 0 };
+    qpmu::LatencyHistogram latencyUsec;
+    qpmu::LatencyHistogram jitterUsec;
+    qpmu::FrameAssembler::Stats assemblerStats = {};
+    int64_t firstFrameUsec = 0;
+    int64_t lastFrameUsec = 0;
+    std::string status = "ok";
+};
+
+int connectTo(const Options &options, std::string &error)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    if (::getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &result) != 0
+        || !result) {
+        error = "cannot resolve " + options.host;
+        return -1;
+    }
+    const auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::milliseconds((int64_t)(options.connectTimeout * 1000));
+    int fd = -1;
+    while (fd < 0 && !stopRequested) {
+        fd = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+            error = std::string("connect: ") + std::strerror(errno);
+            ::close(fd);
+            fd = -1;
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    ::freeaddrinfo(result);
+    return fd;
+}
+
+bool sendAll(int fd, const std::vector<uint8_t> &data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const auto n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno != EINTR) {
+            return false;
+        }
+        sent += n > 0 ? (size_t)n : 0;
+    }
+    return true;
+}
+
+void runClient(const Options &options, Client &client,
+               std::chrono::steady_clock::time_point deadline)
+{
+    using namespace qpmu;
+    std::string error;
+    const int fd = connectTo(options, error);
+    if (fd < 0) {
+        client.status = error;
+        return;
+    }
+    if (client.slow) {
+        int bytes = SlowReceiveBufferBytes;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    }
+    timeval timeout = { 0, ReceiveTimeoutMsec * 1000 };
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    if ((options.rate && !sendAll(fd, commandFrame(0x08, options.rate)))
+        || !sendAll(fd, commandFrame(0x05))) {
+        client.status = "failed to send the commands";
+        ::close(fd);
+        return;
+    }
+
+    FrameAssembler assembler;
+    Configuration config;
+    bool configured = false;
+    size_t expectedSize = 0;
+    int64_t previousFrameTime = 0;
+    int64_t previousArrival = 0;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t bytesRead = 0;
+
+    while (!stopRequested && std::chrono::steady_clock::now() < deadline) {
+        size_t space = 0;
+        auto buffer = assembler.prepare(space);
+        if (client.slow) {
+            /// Read no faster than the configured rate
+            const auto elapsed =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const auto allowed = (uint64_t)(elapsed * options.slowBytesPerSecond);
+            if (allowed <= bytesRead) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            space = std::min<size_t>(space, allowed - bytesRead);
+        }
+        const auto n = ::recv(fd, buffer, space, 0);
+        if (n == 0) {
+            client.status = "disconnected by the server";
+            break;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            client.status = std::string("recv: ") + std::strerror(errno);
+            break;
+        }
+        assembler.commit((size_t)n);
+        bytesRead += (uint64_t)n;
+        const auto arrival = nowUsec();
+
+        const uint8_t *frame = nullptr;
+        size_t size = 0;
+        while (assembler.next(frame, size)) {
+            const auto type = frameType(frame);
+            if (type == Config2FrameType && !configured) {
+                if (!parseConfiguration(frame, size, config)) {
+                    client.status = "malformed CFG-2 frame";
+                    break;
+                }
+                configured = true;
+                expectedSize = config.dataFrameSize();
+                if (!sendAll(fd, commandFrame(0x02))) {
+                    client.status = "failed to enable the data output";
+                    break;
+                }
+                continue;
+            }
+            if (type != DataFrameType || !configured) {
+                continue;
+            }
+
+            const auto soc = readU32(frame + 6);
+            const auto fraction = readU32(frame + 10) & 0x00FFFFFF;
+            const auto frameTime =
+                    (int64_t)soc * 1000000 + (int64_t)fraction * 1000000 / config.timeBase;
+
+            bool bad = size != expectedSize;
+            for (size_t i = 0, offset = FrameHeaderSize; !bad && i < config.stations.size();
+                 offset += config.stations[i].size(), ++i) {
+                bad = readU16(frame + offset) & 0xC000;
+            }
+            client.badFrames += bad;
+
+            client.latencyUsec.record(arrival - frameTime);
+            if (previousFrameTime) {
+                const auto period = config.periodUsec();
+                const auto skipped = (frameTime - previousFrameTime + period / 2) / period - 1;
+                if (skipped > 0) {
+                    client.lostFrames += (uint64_t)skipped;
+                } else {
+                    client.jitterUsec.record(std::abs(arrival - previousArrival - period));
+                }
+            } else {
+                client.firstFrameUsec = arrival;
+            }
+            previousFrameTime = frameTime;
+            previousArrival = arrival;
+            client.lastFrameUsec = arrival;
+            ++client.frames;
+        }
+        if (client.status != "ok") {
+            break;
+        }
+    }
+    if (client.status == "ok" && !configured) {
+        client.status = "no CFG-2 frame received";
+    }
+    client.assemblerStats = assembler.stats();
+    sendAll(fd, commandFrame(0x01));
+    ::close(fd);
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-subscriber-load: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        }
+        const char *value = argv[++i];
+        char *end = nullptr;
+        bool ok = true;
+        if (arg == "--host") {
+            options.host = value;
+        } else if (arg == "--port") {
+            options.port = value;
+        } else if (arg == "--clients") {
+            options.clients = (int)std::strtol(value, &end, 10);
+            ok = options.clients > 0;
+        } else if (arg == "--duration") {
+            options.duration = std::strtod(value, &end);
+            ok = options.duration > 0;
+        } else if (arg == "--rate") {
+            options.rate = (uint16_t)std::strtoul(value, &end, 10);
+            ok = options.rate > 0;
+        } else if (arg == "--slow") {
+            options.slow = (int)std::strtol(value, &end, 10);
+            ok = options.slow >= 0;
+        } else if (arg == "--slow-bytes-per-second") {
+            options.slowBytesPerSecond = std::strtod(value, &end);
+            ok = options.slowBytesPerSecond > 0;
+        } else if (arg == "--connect-timeout") {
+            options.connectTimeout = std::strtod(value, &end);
+        } else {
+            return fail("unknown option: " + arg + "\n\n" + Usage);
+        }
+        if (!ok || (end && end == value)) {
+            return fail("invalid value of " + arg + ": " + value);
+        }
+    }
+    options.slow = std::min(options.slow, options.clients);
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    std::vector<std::unique_ptr<Client>> clients;
+    for (int i = 0; i < options.clients; ++i) {
+        clients.emplace_back(new Client());
+        clients.back()->index = i;
+        clients.back()->slow = i >= options.clients - options.slow;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline =
+            start + std::chrono::milliseconds((int64_t)(options.duration * 1000));
+    std::vector<std::thread> threads;
+    for (auto &client : clients) {
+        threads.emplace_back(runClient, std::cref(options), std::ref(*client), deadline);
+    }
+
+    uint64_t reportedFrames = 0;
+    auto lastReport = start;
+    while (!stopRequested && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastReport < std::chrono::seconds(1)) {
+            continue;
+        }
+        uint64_t frames = 0, lost = 0, bad = 0;
+        int64_t worstLatency = 0;
+        for (const auto &client : clients) {
+            frames += client->frames;
+            lost += client->lostFrames;
+            bad += client->badFrames;
+            worstLatency = std::max(worstLatency, client->latencyUsec.percentile(0.99));
+        }
+        const auto seconds = std::chrono::duration<double>(now - lastReport).count();
+        std::fprintf(stderr,
+                     "%.0f frames/s over %d clients, lost %llu, bad %llu, worst latency p99 "
+                     "%lld us\n",
+                     (frames - reportedFrames) / seconds, options.clients,
+                     (unsigned long long)lost, (unsigned long long)bad, (long long)worstLatency);
+        reportedFrames = frames;
+        lastReport = now;
+    }
+    stopRequested = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::cout << "client,mode,frames,frames_per_s,lost,bad,latency_p50_us,latency_p99_us,"
+                 "latency_max_us,jitter_p50_us,jitter_p99_us,jitter_max_us,crc_errors,"
+                 "skipped_bytes,status\n";
+    for (const auto &client : clients) {
+        const auto seconds = (client->lastFrameUsec - client->firstFrameUsec) / 1e6;
+        const auto rate = seconds > 0 ? (client->frames - 1) / seconds : 0.0;
+        std::printf("%d,%s,%llu,%.2f,%llu,%llu,%lld,%lld,%lld,%lld,%lld,%lld,%llu,%llu,\"%s\"\n",
+                    client->index, client->slow ? "slow" : "normal",
+                    (unsigned long long)client->frames, rate,
+                    (unsigned long long)client->lostFrames, (unsigned long long)client->badFrames,
+                    (long long)client->latencyUsec.percentile(0.5),
+                    (long long)client->latencyUsec.percentile(0.99),
+                    (long long)client->latencyUsec.max(),
+                    (long long)client->jitterUsec.percentile(0.5),
+                    (long long)client->jitterUsec.percentile(0.99),
+                    (long long)client->jitterUsec.max(),
+                    (unsigned long long)client->assemblerStats.crcErrors,
+                    (unsigned long long)client->assemblerStats.skippedBytes,
+                    client->status.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,515 @@
+/// Runs a grid of estimator and filter configurations over the processed captures, in parallel,
+/// and prints the accuracy against their reference phasors and the cost of each configuration:
+///
+///     qpmu-sweep data/2025-03-23/processed --min-magnitude 50 --max-tve 10 > sweep.csv
+///
+/// The estimator refers a phasor's phase to the oldest sample of its window, and the reference
+/// phasors theirs to the newest, so each estimate is advanced by its window's span at the nominal
+/// frequency before it is compared; otherwise the TVE would mostly measure that offset, which
+/// grows with the window.
+
+#include "qpmu/defs.h"
+#include "qpmu/pipeline.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char Usage[] = R"(Usage: qpmu-sweep PROCESSED_DIRECTORY [OPTION]...
+
+Runs every combination of the configurations below over the captures (*.csv, with the columns
+seq,time,time_delta,ch0..ch5,phasor0..phasor5 as written by qpmu-batch) in the directory, and
+prints one CSV row per configuration: the total vector error (TVE) of the per-sample and of the
+reported phasors, and the error of the median-filtered magnitudes, against the captures' phasors;
+the processing time per sample; and the memory of the pipeline. The estimates are advanced from
+the oldest to the newest sample of their window at the nominal frequency, the phase reference of
+the captures' phasors. An error is nan if no reference phasor was large enough to compare to.
+
+Options (LIST is comma-separated):
+  --cycles LIST            phasor windows, in nominal cycles; default 1,2,4
+  --frequency-window LIST  frequency windows, in seconds; default 0.5,1
+  --voltage-median LIST    median windows of the voltage magnitudes; default 32,100
+  --current-median LIST    median windows of the current magnitudes; default 8,32
+  --filter-class LIST      reporting filter classes, P and/or M; default P,M
+  --rate N                 reporting rate, in frames per second; default 50
+  --min-magnitude X        ignore reference phasors smaller than this (ADC units); default 10
+  --max-tve PERCENT        also name the cheapest configuration whose 99th percentile TVE of the
+                           reported phasors is within this; configurations with nothing to
+                           compare are never chosen
+  --jobs N                 worker threads; default: one per core
+)";
+
+/// Nominal frequency and sampling rate of the captures (in Hz), as in the app
+constexpr size_t NominalFrequency = 50;
+constexpr size_t SamplingRate = 1200;
+
+struct Options
+{
+    fs::path input = {};
+    std::vector<size_t> cycles = { 1, 2, 4 };
+    std::vector<double> frequencyWindows = { 0.5, 1 };
+    std::vector<size_t> voltageMedians = { 32, 100 };
+    std::vector<size_t> currentMedians = { 8, 32 };
+    std::vector<qpmu::FilterClass> filterClasses = { qpmu::ProtectionClass,
+                                                     qpmu::MeasurementClass };
+    uint32_t rate = 50;
+    double minMagnitude = 10;
+    double maxTve = -1;
+    unsigned jobs = 0;
+};
+
+/// A capture: its samples and the reference phasor of each
+struct Capture
+{
+    std::string name = {};
+    std::vector<qpmu::Sample> samples = {};
+    std::vector<std::array<qpmu::Complex, qpmu::CountSignals>> phasors = {};
+};
+
+struct Result
+{
+    qpmu::PipelineConfig config = {};
+    /// The errors are NaN if there was nothing to compare, i.e., their count is 0
+    size_t countTves = 0;
+    size_t countReportedTves = 0;
+    size_t countMedianErrors = 0;
+    double tveMean = 0;
+    double tveP99 = 0;
+    double reportedTveMean = 0;
+    double reportedTveP99 = 0;
+    double medianErrorMean = 0;
+    double nsPerSample = 0;
+    double medianNsPerCall = 0;
+    size_t memoryBytes = 0;
+};
+
+/// Parses Python's `repr()` of a complex number, e.g. `(1.5-2j)` or `3j`
+bool parseComplex(const char *&p, qpmu::Complex &value)
+{
+    const bool parenthesized = *p == '(';
+    char *end = nullptr;
+    const double first = std::strtod(p + parenthesized, &end);
+    if (end == p + parenthesized) {
+        return false;
+    }
+    double real = 0;
+    double imag = first;
+    if (*end != 'j') {
+        real = first;
+        const char *imagBegin = end;
+        imag = std::strtod(imagBegin, &end);
+        if (end == imagBegin || *end != 'j') {
+            return false;
+        }
+    }
+    p = end + 1;
+    if (parenthesized && *p++ != ')') {
+        return false;
+    }
+    value = { (qpmu::Float)real, (qpmu::Float)imag };
+    return true;
+}
+
+/// Reads a processed capture; returns false with the reason in `error`
+bool readCapture(const fs::path &path, Capture &capture, std::string &error)
+{
+    using namespace qpmu;
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line.rfind("seq,", 0) != 0) {
+        error = path.string() + ": not a processed capture";
+        return false;
+    }
+    capture.name = path.filename().string();
+    for (size_t lineNumber = 2; std::getline(file, line); ++lineNumber) {
+        if (line.empty()) {
+            continue;
+        }
+        Sample sample;
+        std::array<Complex, CountSignals> phasors;
+        const char *p = line.c_str();
+        char *end = nullptr;
+        bool ok = true;
+        auto nextInteger = [&]() -> int64_t {
+            const auto value = std::strtoll(p, &end, 10);
+            ok = ok && end != p && *end == ',';
+            p = end + (*end == ',');
+            return value;
+        };
+        sample.seq = (uint64_t)nextInteger();
+        sample.timestampUsec = nextInteger();
+        sample.timeDeltaUsec = nextInteger();
+        for (size_t ch = 0; ch < CountSignals; ++ch) {
+            sample.channels[ch] = (uint16_t)nextInteger();
+        }
+        for (size_t ch = 0; ok && ch < CountSignals; ++ch) {
+            ok = parseComplex(p, phasors[ch]) && *p == (ch + 1 < CountSignals ? ',' : '\0');
+            p += *p == ',';
+        }
+        if (!ok) {
+            error = path.string() + ":" + std::to_string(lineNumber) + ": not a processed row";
+            return false;
+        }
+        capture.samples.push_back(sample);
+        capture.phasors.push_back(phasors);
+    }
+    return true;
+}
+
+template <class T>
+bool parseList(const std::string &text, std::vector<T> &values)
+{
+    values.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char *end = nullptr;
+        const double value = std::strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0' || !(value > 0)) {
+            return false;
+        }
+        values.push_back((T)value);
+    }
+    return !values.empty();
+}
+
+double mean(const std::vector<double> &values)
+{
+    double sum = 0;
+    for (auto value : values) {
+        sum += value;
+    }
+    return values.empty() ? std::nan("") : sum / values.size();
+}
+
+/// 99th percentile; reorders the values
+double p99(std::vector<double> &values)
+{
+    if (values.empty()) {
+        return std::nan("");
+    }
+    const auto nth = values.begin() + (values.size() - 1) * 99 / 100;
+    std::nth_element(values.begin(), nth, values.end());
+    return *nth;
+}
+
+/// Runs one configuration over all the captures
+Result evaluate(const qpmu::PipelineConfig &config, const std::vector<Capture> &captures,
+                double minMagnitude)
+{
+    using namespace qpmu;
+    using Clock = std::chrono::steady_clock;
+    Result result;
+    result.config = config;
+
+    std::vector<double> tves;
+    std::vector<double> reportedTves;
+    std::vector<double> medianErrors;
+    int64_t processNsec = 0;
+    int64_t medianNsec = 0;
+    size_t countSamples = 0;
+    size_t countMedians = 0;
+
+    /// TVE of a phasor against a reference; negative if the reference is too small to compare to
+    auto tve = [minMagnitude](const Complex &phasor, const Complex &reference) {
+        const auto magnitude = std::abs(reference);
+        return magnitude < minMagnitude ? -1.0 : 100.0 * std::abs(phasor - reference) / magnitude;
+    };
+
+    for (const auto &capture : captures) {
+        Pipeline pipeline(config);
+        result.memoryBytes = pipeline.memoryBytes();
+
+        /// The estimations before the phasor window is full are not compared
+        const size_t warmup = config.windowCycles * config.samplingRate / config.nominalFrequency;
+        size_t current = 0;
+        size_t reference = 0;
+
+        /// Advances an estimate of the current sample from the oldest sample of its window to the
+        /// newest, the phase reference of the captures' phasors
+        auto toNewest = [&](const Complex &phasor) {
+            const auto &samples = capture.samples;
+            const auto spanSec = (Float)(samples[current].timestampUsec
+                                         - samples[current + 1 - warmup].timestampUsec)
+                    / TimeDenom;
+            return phasor
+                    * std::polar((Float)1, (Float)(2 * M_PI * config.nominalFrequency * spanSec));
+        };
+        pipeline.setReportCallback([&](const ReportingInstant &instant,
+                                       const Estimation &estimation) {
+            if (current < warmup) {
+                return;
+            }
+            /// Compare to the reference of the sample nearest the instant, advanced to it by the
+            /// nominal frequency
+            const auto &samples = capture.samples;
+            while (reference + 1 <= current
+                   && std::llabs(samples[reference + 1].timestampUsec - instant.timeUsec)
+                           <= std::llabs(samples[reference].timestampUsec - instant.timeUsec)) {
+                ++reference;
+            }
+            const auto offsetSec =
+                    (Float)(instant.timeUsec - samples[reference].timestampUsec) / TimeDenom;
+            const auto rotation = std::polar((Float)1, (Float)(2 * M_PI * config.nominalFrequency
+                                                               * offsetSec));
+            for (size_t ch = 0; ch < CountSignals; ++ch) {
+                const auto error = tve(toNewest(estimation.phasors[ch]),
+                                       capture.phasors[reference][ch] * rotation);
+                if (error >= 0) {
+                    reportedTves.push_back(error);
+                }
+            }
+        });
+
+        const size_t medianInterval = config.samplingRate / config.reportingRates.front();
+        for (current = 0; current < capture.samples.size(); ++current) {
+            const auto start = Clock::now();
+            pipeline.process(capture.samples[current]);
+            const auto elapsed = Clock::now() - start;
+            processNsec += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            ++countSamples;
+            if (current < warmup) {
+                continue;
+            }
+
+            const auto estimation = pipeline.lastEstimation();
+            const auto &phasors = capture.phasors[current];
+            for (size_t ch = 0; ch < CountSignals; ++ch) {
+                const auto error = tve(toNewest(estimation.phasors[ch]), phasors[ch]);
+                if (error >= 0) {
+                    tves.push_back(error);
+                }
+            }
+
+            /// The median filter serves the display, i.e., about once per reporting interval
+            if (current % medianInterval == 0) {
+                const auto medianStart = Clock::now();
+                const auto filtered = pipeline.lastEstimationFiltered();
+                medianNsec += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      Clock::now() - medianStart)
+                                      .count();
+                ++countMedians;
+                for (size_t ch = 0; ch < CountSignals; ++ch) {
+                    const auto magnitude = std::abs(phasors[ch]);
+                    if (magnitude >= minMagnitude) {
+                        medianErrors.push_back(100.0 * std::abs(std::abs(filtered.phasors[ch])
+                                                                - magnitude)
+                                               / magnitude);
+                    }
+                }
+            }
+        }
+    }
+
+    result.countTves = tves.size();
+    result.countReportedTves = reportedTves.size();
+    result.countMedianErrors = medianErrors.size();
+    result.tveMean = mean(tves);
+    result.tveP99 = p99(tves);
+    result.reportedTveMean = mean(reportedTves);
+    result.reportedTveP99 = p99(reportedTves);
+    result.medianErrorMean = mean(medianErrors);
+    result.nsPerSample = countSamples ? (double)processNsec / countSamples : 0;
+    result.medianNsPerCall = countMedians ? (double)medianNsec / countMedians : 0;
+    return result;
+}
+
+void printResult(const Result &result)
+{
+    const auto &config = result.config;
+    std::printf("%zu,%g,%zu,%zu,%s,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%zu\n",
+                config.windowCycles, (double)config.frequencyWindowUsec / qpmu::TimeDenom,
+                config.voltageMedianWindow, config.currentMedianWindow,
+                config.filterClass == qpmu::MeasurementClass ? "M" : "P", result.tveMean,
+                result.tveP99, result.reportedTveMean, result.reportedTveP99,
+                result.medianErrorMean, result.nsPerSample, result.medianNsPerCall,
+                result.memoryBytes);
+}
+
+int fail(const std::string &message)
+{
+    std::cerr << "qpmu-sweep: " << message << "\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--help" || arg == "-h") {
+            std::cout << Usage;
+            return 0;
+        } else if (arg == "--cycles" && hasValue) {
+            ok = parseList(argv[++i], options.cycles);
+        } else if (arg == "--frequency-window" && hasValue) {
+            ok = parseList(argv[++i], options.frequencyWindows);
+        } else if (arg == "--voltage-median" && hasValue) {
+            ok = parseList(argv[++i], options.voltageMedians);
+        } else if (arg == "--current-median" && hasValue) {
+            ok = parseList(argv[++i], options.currentMedians);
+        } else if (arg == "--filter-class" && hasValue) {
+            options.filterClasses.clear();
+            std::stringstream stream(argv[++i]);
+            std::string item;
+            while (ok && std::getline(stream, item, ',')) {
+                ok = item == "P" || item == "M";
+                options.filterClasses.push_back(item == "M" ? qpmu::MeasurementClass
+                                                            : qpmu::ProtectionClass);
+            }
+            ok = ok && !options.filterClasses.empty();
+        } else if (arg == "--rate" && hasValue) {
+            options.rate = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+            ok = options.rate > 0 && SamplingRate % options.rate == 0;
+        } else if (arg == "--min-magnitude" && hasValue) {
+            options.minMagnitude = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--max-tve" && hasValue) {
+            options.maxTve = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--jobs" && hasValue) {
+            options.jobs = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg.rfind("--", 0) == 0) {
+            return fail("unknown option, or missing value: " + arg + "\n\n" + Usage);
+        } else if (options.input.empty()) {
+            options.input = arg;
+        } else {
+            return fail("unexpected argument: " + arg + "\n\n" + Usage);
+        }
+        if (!ok) {
+            return fail("invalid value of " + arg + ": " + argv[i]);
+        }
+    }
+    if (options.input.empty()) {
+        return fail(std::string("missing the input directory\n\n") + Usage);
+    }
+    if (options.jobs == 0) {
+        options.jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::error_code errorCode;
+    std::vector<fs::path> paths;
+    for (const auto &entry : fs::directory_iterator(options.input, errorCode)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".csv") {
+            paths.push_back(entry.path());
+        }
+    }
+    if (errorCode) {
+        return fail("cannot read " + options.input.string() + ": " + errorCode.message());
+    }
+    std::sort(paths.begin(), paths.end());
+    std::vector<Capture> captures(paths.size());
+    size_t countSamples = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::string error;
+        if (!readCapture(paths[i], captures[i], error)) {
+            return fail(error);
+        }
+        countSamples += captures[i].samples.size();
+    }
+    if (countSamples == 0) {
+        return fail("no samples in " + options.input.string());
+    }
+
+    std::vector<qpmu::PipelineConfig> configs;
+    for (auto cycles : options.cycles) {
+        for (auto frequencyWindow : options.frequencyWindows) {
+            for (auto voltageMedian : options.voltageMedians) {
+                for (auto currentMedian : options.currentMedians) {
+                    for (auto filterClass : options.filterClasses) {
+                        qpmu::PipelineConfig config;
+                        config.nominalFrequency = NominalFrequency;
+                        config.samplingRate = SamplingRate;
+                        config.windowCycles = cycles;
+                        config.frequencyWindowUsec =
+                                (int64_t)std::llround(frequencyWindow * qpmu::TimeDenom);
+                        config.voltageMedianWindow = voltageMedian;
+                        config.currentMedianWindow = currentMedian;
+                        config.reportingRates = { options.rate };
+                        config.filterClass = filterClass;
+                        configs.push_back(config);
+                    }
+                }
+            }
+        }
+    }
+    std::cerr << configs.size() << " configurations over " << captures.size() << " captures ("
+              << countSamples << " samples)\n";
+
+    /// Each worker takes the next configuration until none are left; a worker's pipelines share
+    /// their metrics, so that the workers do not contend on them
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next = { 0 };
+    std::atomic<size_t> done = { 0 };
+    std::mutex logMutex;
+    std::vector<Result> results(configs.size());
+    std::vector<std::thread> workers;
+    const auto countWorkers = std::min<size_t>(options.jobs, configs.size());
+    for (size_t w = 0; w < countWorkers; ++w) {
+        workers.emplace_back([&, w] {
+            for (size_t i; (i = next.fetch_add(1)) < configs.size();) {
+                auto config = configs[i];
+                config.station = "sweep-" + std::to_string(w);
+                results[i] = evaluate(config, captures, options.minMagnitude);
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "[" << ++done << "/" << configs.size() << "]\r" << std::flush;
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    const auto seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << configs.size() << " configurations in " << seconds << " s (" << countWorkers
+              << " workers)\n";
+
+    std::printf("cycles,frequency_window_s,voltage_median,current_median,filter_class,"
+                "tve_mean_pct,tve_p99_pct,reported_tve_mean_pct,reported_tve_p99_pct,"
+                "median_magnitude_error_pct,ns_per_sample,median_ns_per_call,memory_bytes\n");
+    for (const auto &result : results) {
+        printResult(result);
+    }
+
+    if (options.maxTve >= 0) {
+        const Result *cheapest = nullptr;
+        for (const auto &result : results) {
+            if (result.countReportedTves > 0 && result.reportedTveP99 <= options.maxTve
+                && (!cheapest || result.nsPerSample < cheapest->nsPerSample)) {
+                cheapest = &result;
+            }
+        }
+        if (!cheapest) {
+            std::cerr << "No configuration has a 99th percentile TVE within " << options.maxTve
+                      << "%\n";
+            return 1;
+        }
+        std::cerr << "Cheapest configuration within " << options.maxTve << "% TVE: "
+                  << cheapest->config.windowCycles << " cycles, "
+                  << (double)cheapest->config.frequencyWindowUsec / qpmu::TimeDenom
+                  << " s frequency window, median " << cheapest->config.voltageMedianWindow
+                  << "/" << cheapest->config.currentMedianWindow << ", "
+                  << (cheapest->config.filterClass == qpmu::MeasurementClass ? "M" : "P")
+                  << " class: " << cheapest->nsPerSample << " ns/sample, "
+                  << cheapest->memoryBytes << " bytes\n";
+    }
+    return 0;
+}